@@ -6,7 +6,7 @@ param (
 )
 
 $EXECUTABLE = "chip-8"
-$SOURCE_FILES = @("chip8.c", "input.c", "display.c", "beeper.c", "args.c", "device.c", "main.c")
+$SOURCE_FILES = @("chip8.c", "threaded.c", "block.c", "jit.c", "lockstep.c", "snapshot.c", "rewind.c", "movie.c", "profiler.c", "aot.c", "input.c", "frames.c", "scale.c", "display.c", "beeper.c", "args.c", "device.c", "main.c")
 $SOURCE_FILES_PATH = $SOURCE_FILES -replace "^", "src\"
 $OUTPUT_DIR = "bin\windows"
 
@@ -0,0 +1,19 @@
+#include <stdlib.h>
+
+#include "include/chip8.h"
+#include "include/aot.h"
+
+// stand-in for the code generated by tools/recompile.c, runs on chip8_cycle
+const char *aot_rom = NULL;
+
+exec_res_t aot_run(chip8_t *c8, uint32_t count, uint32_t *executed)
+{
+    exec_res_t result = EXEC_SUCCESS;
+    uint32_t n = 0;
+    while (n < count && result == EXEC_SUCCESS) {
+        result = chip8_cycle(c8);
+        n++;
+    }
+    if (executed) *executed = n;
+    return result;
+}
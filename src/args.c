@@ -1,6 +1,8 @@
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "include/args.h"
+#include "include/chip8.h"
 
 args_t parse_args(int argc, char *argv[])
 {
@@ -8,12 +10,23 @@ args_t parse_args(int argc, char *argv[])
         .ipf = IPF,
         .tone = TONE,
         .bg_color = BG_COLOR,
-        .fg_color = FG_COLOR
+        .fg_color = FG_COLOR,
+        .plane2_color = PLANE2_COLOR,
+        .both_color = BOTH_COLOR,
+        .engine = ENGINE,
+        .seed = time(NULL)
     };
     if (argc > 1) {
         args.rom_path = argv[1];
     }
-    for (int i = 2; i + 1 < argc; i += 2) {
+    for (int i = 2; i < argc; i++) {
+        if (strcmp("--headless", argv[i]) == 0) {
+            args.headless = 1;
+            continue;
+        }
+        if (i + 1 == argc) {
+            break;
+        }
         if (strcmp("--ipf", argv[i]) == 0) {
             args.ipf = strtol(argv[i + 1], NULL, 10);
         } else if (strcmp("--tone", argv[i]) == 0) {
@@ -22,7 +35,42 @@ args_t parse_args(int argc, char *argv[])
             args.bg_color = strtol(argv[i + 1], NULL, 16);
         } else if (strcmp("--fg-color", argv[i]) == 0) {
             args.fg_color = strtol(argv[i + 1], NULL, 16);
+        } else if (strcmp("--plane2-color", argv[i]) == 0) {
+            args.plane2_color = strtol(argv[i + 1], NULL, 16);
+        } else if (strcmp("--both-color", argv[i]) == 0) {
+            args.both_color = strtol(argv[i + 1], NULL, 16);
+        } else if (strcmp("--phosphor", argv[i]) == 0) {
+            args.phosphor = strtol(argv[i + 1], NULL, 10);
+        } else if (strcmp("--engine", argv[i]) == 0) {
+            if (strcmp("switch", argv[i + 1]) == 0) {
+                args.engine = ENGINE_SWITCH;
+            } else if (strcmp("threaded", argv[i + 1]) == 0) {
+                args.engine = ENGINE_THREADED;
+            } else if (strcmp("block", argv[i + 1]) == 0) {
+                args.engine = ENGINE_BLOCK;
+            } else if (strcmp("jit", argv[i + 1]) == 0) {
+                args.engine = ENGINE_JIT;
+            } else if (strcmp("aot", argv[i + 1]) == 0) {
+                args.engine = ENGINE_AOT;
+            }
+        } else if (strcmp("--frames", argv[i]) == 0) {
+            args.frames = strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp("--instructions", argv[i]) == 0) {
+            args.instructions = strtoull(argv[i + 1], NULL, 10);
+        } else if (strcmp("--seed", argv[i]) == 0) {
+            args.seed = strtoull(argv[i + 1], NULL, 10);
+        } else if (strcmp("--profile", argv[i]) == 0) {
+            for (int p = 0; p < PROFILE_COUNT; p++) {
+                if (strcmp(profile_names[p], argv[i + 1]) == 0) args.profile = p;
+            }
+        } else if (strcmp("--record", argv[i]) == 0) {
+            args.record_path = argv[i + 1];
+        } else if (strcmp("--play", argv[i]) == 0) {
+            args.play_path = argv[i + 1];
+        } else if (strcmp("--profiler", argv[i]) == 0) {
+            args.profiler_path = argv[i + 1];
         }
+        i++;
     }
     return args;
 }
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include <string.h>
 #include "include/beeper.h"
 
 void beeper_callback(void *userdata, uint8_t * stream, int len);
@@ -13,6 +14,8 @@ beeper_t *beeper_create(uint16_t tone)
     beeper->period = SAMPLE_FREQ / tone;
     beeper->half_period = beeper->period / 2;
     beeper->nth_chunk = 0;
+    beeper->custom = 0;
+    beeper->phase = 0;
 
     SDL_AudioSpec spec = {
         .freq = SAMPLE_FREQ,
@@ -52,10 +55,47 @@ void beeper_mute(beeper_t *beeper)
     beeper->state = MUTED;
 }
 
+// play an XO-CHIP audio pattern at a pitch instead of the tone, or the tone again without a pattern
+void beeper_pattern(beeper_t *beeper, const uint8_t *pattern, uint8_t pitch)
+{
+    if (pattern == NULL) {
+        beeper->custom = 0;
+        return;
+    }
+    if (beeper->custom && beeper->pitch == pitch && memcmp(beeper->pattern, pattern, sizeof(beeper->pattern)) == 0) {
+        return;
+    }
+
+    // 4000 bits per second at pitch 64, an octave every 48 steps
+    double rate = 4000.0;
+    int steps = pitch - 64;
+    for (; steps < 0; steps += 48) rate /= 2;
+    for (; steps >= 48; steps -= 48) rate *= 2;
+    for (; steps > 0; steps--) rate *= 1.0145453349375237; // 2^(1/48)
+
+    // the callback reads the samples on the audio thread; they are expanded only when the pattern changes
+    SDL_LockAudioDevice(beeper->id);
+    memcpy(beeper->pattern, pattern, sizeof(beeper->pattern));
+    beeper->pitch = pitch;
+    for (int i = 0; i < PATTERN_BITS; i++) {
+        beeper->samples[i] = (pattern[i / 8] >> (7 - i % 8) & 1) ? INT16_MAX : INT16_MIN;
+    }
+    beeper->step = rate * 65536 / SAMPLE_FREQ;
+    beeper->custom = 1;
+    SDL_UnlockAudioDevice(beeper->id);
+}
+
 void beeper_callback(void *userdata, uint8_t *stream, int len)
 {
     beeper_t *beeper = (beeper_t *)userdata;
     int16_t *out = (int16_t *)stream;
+    if (beeper->custom) {
+        for (int i = 0; i < len / 2; i++) {
+            out[i] = beeper->samples[(beeper->phase >> 16) % PATTERN_BITS];
+            beeper->phase += beeper->step;
+        }
+        return;
+    }
     for (int i = 0; i < len / 2; i++) {
         out[i] = (beeper->nth_chunk++ % beeper->period < beeper->half_period) ? INT16_MIN : INT16_MAX;
         if (beeper->nth_chunk == beeper->period) {
@@ -0,0 +1,443 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/chip8.h"
+#include "include/block.h"
+
+// GCC and Clang support labels as values, anything else falls back to a switch
+#if defined(__GNUC__) || defined(__clang__)
+#define BLOCK_DISPATCH
+#endif
+
+#ifdef BLOCK_DISPATCH
+#define OP(oc) op_##oc:
+#define DISPATCH_OP() goto *targets[op->OC]
+#else
+#define OP(oc) case oc:
+#define DISPATCH_OP() goto dispatch
+#endif
+
+#define NEXT_OP() do { op++; DISPATCH_OP(); } while (0)
+
+block_cache_t *block_cache_create()
+{
+    block_cache_t *bc = malloc(sizeof(block_cache_t));
+    if (bc == NULL) {
+        return NULL;
+    }
+    block_cache_flush(bc);
+    // the empty cache has nothing to invalidate, whatever generation the first instance is at
+    bc->gen = 0;
+    return bc;
+}
+
+void block_cache_destroy(block_cache_t **bc)
+{
+    free(*bc);
+    *bc = NULL;
+}
+
+void block_cache_flush(block_cache_t *bc)
+{
+    memset(bc->map, 0, sizeof(block_t *) * RAM_SIZE);
+    bc->block_count = 0;
+    bc->op_count = 0;
+}
+
+static int block_terminates(uint8_t oc)
+{
+    switch (oc) {
+        case OC_RET: case OC_JP: case OC_CALL: case OC_JP_V0: case OC_JP_VX:
+        case OC_SE_VX_NN: case OC_SNE_VX_NN: case OC_SE_VX_VY: case OC_SNE_VX_VY: case OC_SKP: case OC_SKNP:
+        case OC_LD_VX_K: case OC_UNKNOWN: case OC_LD_I_LONG: case OC_SKIP_LONG:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+block_t *block_translate(block_cache_t *bc, chip8_t *c8, uint16_t address)
+{
+    if (address >= RAM_SIZE - 1) {
+        return NULL;
+    }
+    if (bc->block_count == BLOCK_COUNT || bc->op_count + BLOCK_LENGTH + 1 > BLOCK_OPS) {
+        block_cache_flush(bc);
+    }
+
+    block_t *b = &bc->blocks[bc->block_count++];
+    instruction_t *inst = NULL;
+    uint16_t pc = address;
+    b->start = address;
+    b->op = bc->op_count;
+    b->length = 0;
+    while (b->length < BLOCK_LENGTH && pc < RAM_SIZE - 1) {
+        inst = &bc->ops[bc->op_count++];
+        chip8_decode(c8->RAM[pc] << 8 | c8->RAM[pc + 1], inst);
+        chip8_specialize(inst, c8->PROFILE);
+        b->length++;
+        pc += 2;
+        if (block_terminates(inst->OC)) break;
+    }
+    b->end = pc;
+    bc->ops[bc->op_count++].OC = OC_BLOCK_END;
+
+    switch (inst->OC) {
+        case OC_JP:
+        case OC_CALL: {
+            b->exit[0] = b->exit[1] = inst->NNN;
+            break;
+        }
+        case OC_SE_VX_NN: case OC_SNE_VX_NN: case OC_SE_VX_VY: case OC_SNE_VX_VY: case OC_SKP: case OC_SKNP: {
+            b->exit[0] = b->end;
+            b->exit[1] = b->end + 2;
+            break;
+        }
+        default: { // fall-through, or a target only known at run time
+            b->exit[0] = b->exit[1] = b->end;
+        }
+    }
+    b->next[0] = b->next[1] = NULL;
+    b->valid = 1;
+    b->hits = 0;
+    b->native = NULL;
+    bc->map[address] = b;
+    memset(&c8->CODE[b->start], 1, sizeof(uint8_t) * (b->end - b->start));
+    return b;
+}
+
+void block_sync(block_cache_t *bc, chip8_t *c8)
+{
+    if (c8->CODE_LO == 0 && c8->CODE_HI == RAM_SIZE - 1) {
+        block_cache_flush(bc);
+    } else if (c8->CODE_LO <= c8->CODE_HI) {
+        for (int i = 0; i < bc->block_count; i++) {
+            block_t *b = &bc->blocks[i];
+            if (b->valid && b->start <= c8->CODE_HI && b->end > c8->CODE_LO) {
+                b->valid = 0;
+                if (bc->map[b->start] == b) bc->map[b->start] = NULL;
+            }
+        }
+    }
+    c8->CODE_LO = RAM_SIZE;
+    c8->CODE_HI = 0;
+    bc->gen = c8->CODE_GEN;
+}
+
+exec_res_t block_run(block_cache_t *bc, chip8_t *c8, uint32_t count, uint32_t *executed)
+{
+#ifdef BLOCK_DISPATCH
+    static const void *targets[OC_BLOCK_END + 1] = {
+        [OC_UNKNOWN] = &&op_OC_UNKNOWN, [OC_NOP] = &&op_OC_NOP, [OC_CLS] = &&op_OC_CLS, [OC_RET] = &&op_OC_RET,
+        [OC_JP] = &&op_OC_JP, [OC_CALL] = &&op_OC_CALL, [OC_SE_VX_NN] = &&op_OC_SE_VX_NN,
+        [OC_SNE_VX_NN] = &&op_OC_SNE_VX_NN, [OC_SE_VX_VY] = &&op_OC_SE_VX_VY, [OC_LD_VX_NN] = &&op_OC_LD_VX_NN,
+        [OC_ADD_VX_NN] = &&op_OC_ADD_VX_NN, [OC_LD_VX_VY] = &&op_OC_LD_VX_VY, [OC_OR] = &&op_OC_OR,
+        [OC_AND] = &&op_OC_AND, [OC_XOR] = &&op_OC_XOR, [OC_ADD_VX_VY] = &&op_OC_ADD_VX_VY, [OC_SUB] = &&op_OC_SUB,
+        [OC_SHR] = &&op_OC_SHR, [OC_SUBN] = &&op_OC_SUBN, [OC_SHL] = &&op_OC_SHL,
+        [OC_SNE_VX_VY] = &&op_OC_SNE_VX_VY, [OC_LD_I] = &&op_OC_LD_I, [OC_JP_V0] = &&op_OC_JP_V0,
+        [OC_RND] = &&op_OC_RND, [OC_DRW] = &&op_OC_DRW, [OC_SKP] = &&op_OC_SKP, [OC_SKNP] = &&op_OC_SKNP,
+        [OC_LD_VX_DT] = &&op_OC_LD_VX_DT, [OC_LD_VX_K] = &&op_OC_LD_VX_K, [OC_LD_DT_VX] = &&op_OC_LD_DT_VX,
+        [OC_LD_ST_VX] = &&op_OC_LD_ST_VX, [OC_ADD_I_VX] = &&op_OC_ADD_I_VX, [OC_LD_F_VX] = &&op_OC_LD_F_VX,
+        [OC_LD_B_VX] = &&op_OC_LD_B_VX, [OC_LD_I_VX] = &&op_OC_LD_I_VX, [OC_LD_VX_I] = &&op_OC_LD_VX_I,
+        [OC_OR_KEEP] = &&op_OC_OR_KEEP, [OC_AND_KEEP] = &&op_OC_AND_KEEP, [OC_XOR_KEEP] = &&op_OC_XOR_KEEP,
+        [OC_SHR_VX] = &&op_OC_SHR_VX, [OC_SHL_VX] = &&op_OC_SHL_VX, [OC_LD_VX_I_X] = &&op_OC_LD_VX_I_X,
+        [OC_LD_VX_I_KEEP] = &&op_OC_LD_VX_I_KEEP, [OC_JP_VX] = &&op_OC_JP_VX, [OC_SCD] = &&op_OC_SCD,
+        [OC_SCR] = &&op_OC_SCR, [OC_SCL] = &&op_OC_SCL, [OC_LOW] = &&op_OC_LOW, [OC_HIGH] = &&op_OC_HIGH,
+        [OC_LD_HF_VX] = &&op_OC_LD_HF_VX, [OC_LD_R_VX] = &&op_OC_LD_R_VX, [OC_LD_VX_R] = &&op_OC_LD_VX_R,
+        [OC_SAVE] = &&op_OC_SAVE, [OC_LOAD] = &&op_OC_LOAD, [OC_LD_I_LONG] = &&op_OC_LD_I_LONG,
+        [OC_PLANE] = &&op_OC_PLANE, [OC_AUDIO] = &&op_OC_AUDIO, [OC_PITCH] = &&op_OC_PITCH,
+        [OC_SKIP_LONG] = &&op_OC_SKIP_LONG,
+        [OC_BLOCK_END] = &&op_OC_BLOCK_END,
+    };
+#endif
+    exec_res_t result = EXEC_SUCCESS;
+    uint8_t *V = c8->V;
+    uint16_t pc = c8->PC;
+    uint32_t n = 0;
+    block_t *b = NULL, *from = NULL;
+    instruction_t *first = NULL, *op = NULL;
+    int taken = 0;
+
+    while (n < count) {
+        if (c8->CODE_GEN != bc->gen) {
+            block_sync(bc, c8);
+            b = from = NULL;
+        }
+        if (b == NULL || !b->valid || b->start != pc) { // not chained yet
+            b = (pc < RAM_SIZE) ? bc->map[pc] : NULL;
+            if (b == NULL || !b->valid) {
+                b = block_translate(bc, c8, pc);
+                from = NULL; // a flush may have recycled the predecessor
+            }
+            if (from != NULL) {
+                from->next[taken] = b;
+            }
+        }
+        if (b == NULL || b->length > count - n) { // step the reference interpreter instead
+            c8->PC = pc;
+            result = chip8_cycle(c8);
+            pc = c8->PC;
+            n++;
+            b = from = NULL;
+            if (result != EXEC_SUCCESS) break;
+            continue;
+        }
+
+        first = op = &bc->ops[b->op];
+        pc = b->end;
+        DISPATCH_OP();
+#ifndef BLOCK_DISPATCH
+dispatch:
+        switch (op->OC) {
+#endif
+        OP(OC_NOP) {
+            NEXT_OP();
+        }
+        OP(OC_RET) {
+            if (c8->SP == 0) {
+                result = STACK_UNDERFLOW;
+                goto done;
+            }
+            c8->SP--;
+            pc = c8->STACK[c8->SP];
+            NEXT_OP();
+        }
+        OP(OC_JP) {
+            pc = op->NNN;
+            NEXT_OP();
+        }
+        OP(OC_CALL) {
+            if (c8->SP == STACK_SIZE) {
+                result = STACK_OVERFLOW;
+                goto done;
+            }
+            c8->STACK[c8->SP] = pc;
+            c8->SP++;
+            pc = op->NNN;
+            NEXT_OP();
+        }
+        OP(OC_SE_VX_NN) {
+            if (V[op->X] == op->NN) pc += 2;
+            NEXT_OP();
+        }
+        OP(OC_SNE_VX_NN) {
+            if (V[op->X] != op->NN) pc += 2;
+            NEXT_OP();
+        }
+        OP(OC_SE_VX_VY) {
+            if (V[op->X] == V[op->Y]) pc += 2;
+            NEXT_OP();
+        }
+        OP(OC_SNE_VX_VY) {
+            if (V[op->X] != V[op->Y]) pc += 2;
+            NEXT_OP();
+        }
+        OP(OC_LD_VX_NN) {
+            V[op->X] = op->NN;
+            NEXT_OP();
+        }
+        OP(OC_ADD_VX_NN) {
+            V[op->X] += op->NN;
+            NEXT_OP();
+        }
+        OP(OC_LD_VX_VY) {
+            V[op->X] = V[op->Y];
+            NEXT_OP();
+        }
+        OP(OC_OR) {
+            V[op->X] |= V[op->Y];
+            V[0xF] = 0;
+            NEXT_OP();
+        }
+        OP(OC_AND) {
+            V[op->X] &= V[op->Y];
+            V[0xF] = 0;
+            NEXT_OP();
+        }
+        OP(OC_XOR) {
+            V[op->X] ^= V[op->Y];
+            V[0xF] = 0;
+            NEXT_OP();
+        }
+        OP(OC_OR_KEEP) {
+            V[op->X] |= V[op->Y];
+            NEXT_OP();
+        }
+        OP(OC_AND_KEEP) {
+            V[op->X] &= V[op->Y];
+            NEXT_OP();
+        }
+        OP(OC_XOR_KEEP) {
+            V[op->X] ^= V[op->Y];
+            NEXT_OP();
+        }
+        OP(OC_ADD_VX_VY) {
+            int sum = V[op->X] + V[op->Y];
+            V[op->X] = sum;
+            V[0xF] = sum > 255;
+            NEXT_OP();
+        }
+        OP(OC_SUB) {
+            uint8_t flag = V[op->X] >= V[op->Y];
+            V[op->X] -= V[op->Y];
+            V[0xF] = flag;
+            NEXT_OP();
+        }
+        OP(OC_SHR) {
+            uint8_t bit = V[op->Y] & 1;
+            V[op->X] = V[op->Y] >> 1;
+            V[0xF] = bit;
+            NEXT_OP();
+        }
+        OP(OC_SUBN) {
+            uint8_t flag = V[op->Y] >= V[op->X];
+            V[op->X] = V[op->Y] - V[op->X];
+            V[0xF] = flag;
+            NEXT_OP();
+        }
+        OP(OC_SHL) {
+            uint8_t bit = V[op->Y] >> 7;
+            V[op->X] = V[op->Y] << 1;
+            V[0xF] = bit;
+            NEXT_OP();
+        }
+        OP(OC_SHR_VX) {
+            uint8_t bit = V[op->X] & 1;
+            V[op->X] >>= 1;
+            V[0xF] = bit;
+            NEXT_OP();
+        }
+        OP(OC_SHL_VX) {
+            uint8_t bit = V[op->X] >> 7;
+            V[op->X] <<= 1;
+            V[0xF] = bit;
+            NEXT_OP();
+        }
+        OP(OC_LD_I) {
+            c8->I = op->NNN;
+            NEXT_OP();
+        }
+        OP(OC_JP_V0) {
+            pc = op->NNN + V[0];
+            NEXT_OP();
+        }
+        OP(OC_JP_VX) {
+            pc = op->NNN + V[op->X];
+            NEXT_OP();
+        }
+        OP(OC_SKP) {
+            if (c8->KEYBOARD[V[op->X]]) pc += 2;
+            NEXT_OP();
+        }
+        OP(OC_SKNP) {
+            if (!c8->KEYBOARD[V[op->X]]) pc += 2;
+            NEXT_OP();
+        }
+        OP(OC_LD_VX_DT) {
+            V[op->X] = c8->DT;
+            NEXT_OP();
+        }
+        OP(OC_LD_DT_VX) {
+            c8->DT = V[op->X];
+            NEXT_OP();
+        }
+        OP(OC_LD_ST_VX) {
+            c8->ST = V[op->X];
+            NEXT_OP();
+        }
+        OP(OC_ADD_I_VX) {
+            c8->I += V[op->X];
+            NEXT_OP();
+        }
+        OP(OC_LD_F_VX) {
+            c8->I = FONTSET_ADDRESS + V[op->X] * FONT_OFFSET;
+            NEXT_OP();
+        }
+        OP(OC_LD_VX_I) {
+            for (int i = 0; i <= op->X; i++) {
+                V[i] = c8->RAM[c8->I++ & c8->RAM_MASK];
+            }
+            NEXT_OP();
+        }
+        OP(OC_LD_VX_I_X) {
+            for (int i = 0; i <= op->X; i++) {
+                V[i] = c8->RAM[(c8->I + i) & c8->RAM_MASK];
+            }
+            c8->I += op->X;
+            NEXT_OP();
+        }
+        OP(OC_LD_VX_I_KEEP) {
+            for (int i = 0; i <= op->X; i++) {
+                V[i] = c8->RAM[(c8->I + i) & c8->RAM_MASK];
+            }
+            NEXT_OP();
+        }
+        // rare, heavy or RAM writing instructions
+        OP(OC_CLS)
+        OP(OC_RND)
+        OP(OC_DRW)
+        OP(OC_LD_VX_K)
+        OP(OC_LD_B_VX)
+        OP(OC_LD_I_VX)
+        OP(OC_SCD)
+        OP(OC_SCR)
+        OP(OC_SCL)
+        OP(OC_LOW)
+        OP(OC_HIGH)
+        OP(OC_LD_HF_VX)
+        OP(OC_LD_R_VX)
+        OP(OC_LD_VX_R)
+        OP(OC_SAVE)
+        OP(OC_LOAD)
+        OP(OC_LD_I_LONG)
+        OP(OC_PLANE)
+        OP(OC_AUDIO)
+        OP(OC_PITCH)
+        OP(OC_SKIP_LONG)
+        OP(OC_UNKNOWN) {
+            uint16_t address = b->start + 2 * (op - first + 1);
+            c8->PC = address;
+            result = chip8_execute(c8, op);
+            if (result != EXEC_SUCCESS) {
+                pc = c8->PC;
+                goto done;
+            }
+            if (address == b->end) { // FX0A, F000 NNNN, XO-CHIP skips or an unknown opcode may end the block
+                pc = c8->PC;
+            } else if (c8->CODE_GEN != bc->gen) { // the block rewrote translated code
+                pc = address;
+                n += op - first + 1;
+                b = from = NULL;
+                continue;
+            }
+            NEXT_OP();
+        }
+        OP(OC_BLOCK_END) {
+            n += b->length;
+            if (pc >= RAM_SIZE) {
+                pc = START_ADDRESS;
+                result = PC_OVERFLOW;
+                goto finish;
+            }
+            // follow the chain if this exit was linked before
+            from = b;
+            taken = (pc == b->exit[0]) ? 0 : 1;
+            b = b->next[taken];
+            continue;
+        }
+#ifndef BLOCK_DISPATCH
+            default: {
+                NEXT_OP();
+            }
+        }
+#endif
+    }
+    goto finish;
+
+done:
+    n += op - first + 1;
+finish:
+    c8->PC = pc;
+    if (executed) *executed = n;
+    return result;
+}
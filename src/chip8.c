@@ -3,6 +3,21 @@
 #include <string.h>
 
 #include "include/chip8.h"
+#ifdef CHIP8_PROFILER
+#include "include/profiler.h"
+#endif
+
+// the quirks are folded into specialized copies of the execute function and the run loop
+#if defined(__GNUC__) || defined(__clang__)
+#define CHIP8_SPECIALIZE static inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define CHIP8_SPECIALIZE static __forceinline
+#else
+#define CHIP8_SPECIALIZE static inline
+#endif
+
+// mask of the data addresses under the quirks of a profile
+#define QUIRK_MASK(quirks) (((quirks) & QUIRK_LONG) ? XO_RAM_SIZE - 1 : RAM_SIZE - 1)
 
 uint8_t fontset[80] = {
     0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
@@ -23,9 +38,36 @@ uint8_t fontset[80] = {
     0xF0, 0x80, 0xF0, 0x80, 0x80, // F
 };
 
+uint8_t big_fontset[160] = {
+    0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, // 0
+    0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, // 1
+    0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, // 2
+    0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, // 3
+    0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, // 5
+    0x3E, 0x7C, 0xE0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, // 6
+    0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, // 8
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C, // 9
+    0x3C, 0x7E, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFE, 0xC3, 0xC3, 0xFE, 0xFE, 0xC3, 0xC3, 0xFE, 0xFC, // B
+    0x3C, 0x7E, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0x7E, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xC0, 0xC0, // F
+};
+
+const char *const profile_names[PROFILE_COUNT] = { "vip", "chip48", "schip", "xochip" };
+
 chip8_t *chip8_create()
 {
-    return malloc(sizeof(chip8_t));
+    chip8_t *c8 = malloc(sizeof(chip8_t));
+    if (c8) {
+        c8->PROFILER = NULL;
+        // chip8_reset bumps the generation, which has to start from a known value
+        c8->CODE_GEN = 0;
+    }
+    return c8;
 }
 
 void chip8_destroy(chip8_t **c8)
@@ -36,20 +78,101 @@ void chip8_destroy(chip8_t **c8)
 
 void chip8_reset(chip8_t *c8)
 {
-    memset(c8->RAM, 0, sizeof(uint8_t) * RAM_SIZE);
+    memset(c8->RAM, 0, sizeof(uint8_t) * XO_RAM_SIZE);
+    memset(c8->DECODED_VALID, 0, sizeof(uint8_t) * RAM_SIZE);
+    memset(c8->CODE, 0, sizeof(uint8_t) * RAM_SIZE);
+    c8->CODE_GEN++;
+    c8->CODE_LO = 0;
+    c8->CODE_HI = RAM_SIZE - 1;
     memset(c8->V, 0, sizeof(uint8_t) * 16);
     memset(c8->STACK, 0, sizeof(uint16_t) * STACK_SIZE);
-    memset(c8->SCREEN, 0, sizeof(uint8_t) * SCREEN_WIDTH * SCREEN_HEIGHT);
+    memset(c8->SCREEN, 0, sizeof(c8->SCREEN));
+    memset(c8->RPL, 0, sizeof(uint8_t) * RPL_SIZE);
+    memset(c8->PATTERN, 0, sizeof(uint8_t) * PATTERN_SIZE);
     memset(c8->KEYBOARD, 0, sizeof(uint8_t) * 16);
+    memset(c8->BREAKPOINTS, 0, sizeof(uint8_t) * RAM_SIZE);
+    c8->STOP_ON_DRAW = 0;
     memcpy(&c8->RAM[FONTSET_ADDRESS], fontset, sizeof(uint8_t) * FONT_OFFSET * 16);
-    c8->I = c8->SP = c8->RF = 0;
+    memcpy(&c8->RAM[BIG_FONTSET_ADDRESS], big_fontset, sizeof(uint8_t) * BIG_FONT_OFFSET * 16);
+    c8->I = c8->SP = c8->RF = c8->HIRES = c8->AUDIO = 0;
+    c8->DIRTY = ALL_ROWS;
+    c8->PLANE = 1;
+    c8->PITCH = 64;
     c8->DT = c8->ST = 0;
     c8->PC = START_ADDRESS;
+    c8->PROFILE = PROFILE_VIP;
+    c8->RAM_MASK = RAM_SIZE - 1;
+    chip8_seed(c8, 0);
+}
+
+void chip8_seed(chip8_t *c8, uint64_t seed)
+{
+    // splitmix64, so that nearby seeds start unrelated sequences
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    c8->RNG = z ? z : 0x9E3779B97F4A7C15ULL; // xorshift gets stuck at 0
+}
+
+uint8_t chip8_random(chip8_t *c8)
+{
+    uint64_t x = c8->RNG;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    c8->RNG = x;
+    return (x * 0x2545F4914F6CDD1DULL) >> 56;
+}
+
+void chip8_profile(chip8_t *c8, profile_t profile)
+{
+    c8->PROFILE = profile;
+    c8->RAM_MASK = QUIRK_MASK(PROFILE_QUIRKS(profile));
+    // predecoded and translated instructions were specialized for the old quirks
+    memset(c8->DECODED_VALID, 0, sizeof(uint8_t) * RAM_SIZE);
+    c8->CODE_GEN++;
+    c8->CODE_LO = 0;
+    c8->CODE_HI = RAM_SIZE - 1;
+}
+
+void chip8_specialize(instruction_t *inst, profile_t profile)
+{
+    int quirks = PROFILE_QUIRKS(profile);
+    switch (inst->OC) {
+        case OC_OR: if (!(quirks & QUIRK_VF_RESET)) inst->OC = OC_OR_KEEP; break;
+        case OC_AND: if (!(quirks & QUIRK_VF_RESET)) inst->OC = OC_AND_KEEP; break;
+        case OC_XOR: if (!(quirks & QUIRK_VF_RESET)) inst->OC = OC_XOR_KEEP; break;
+        case OC_SHR: if (!(quirks & QUIRK_SHIFT_VY)) inst->OC = OC_SHR_VX; break;
+        case OC_SHL: if (!(quirks & QUIRK_SHIFT_VY)) inst->OC = OC_SHL_VX; break;
+        case OC_LD_VX_I: {
+            if (quirks & QUIRK_INDEX_X) inst->OC = OC_LD_VX_I_X;
+            else if (!(quirks & QUIRK_INDEX_X1)) inst->OC = OC_LD_VX_I_KEEP;
+            break;
+        }
+        case OC_JP_V0: if (quirks & QUIRK_JUMP_VX) inst->OC = OC_JP_VX; break;
+        case OC_SE_VX_NN: case OC_SNE_VX_NN: case OC_SE_VX_VY: case OC_SNE_VX_VY: case OC_SKP: case OC_SKNP: {
+            // how far to skip depends on the next opcode, left to chip8_execute
+            if (quirks & QUIRK_LONG) inst->OC = OC_SKIP_LONG;
+            break;
+        }
+        case OC_SCD: case OC_SCR: case OC_SCL: case OC_LOW: case OC_HIGH: case OC_LD_HF_VX: case OC_LD_R_VX:
+        case OC_LD_VX_R: {
+            if (!(quirks & QUIRK_SCHIP)) inst->OC = OC_UNKNOWN;
+            break;
+        }
+        case OC_SAVE: case OC_LOAD: case OC_LD_I_LONG: case OC_PLANE: case OC_AUDIO: case OC_PITCH: {
+            if (!(quirks & QUIRK_XOCHIP)) inst->OC = OC_UNKNOWN;
+            break;
+        }
+        default: break;
+    }
 }
 
 void chip8_ramcpy(chip8_t *c8, uint8_t *bytes, uint8_t size)
 {
     memcpy(&c8->RAM[START_ADDRESS], bytes, sizeof(uint8_t) * size);
+    chip8_invalidate(c8, START_ADDRESS, size);
 }
 
 rom_ld_t chip8_load_rom(chip8_t *c8, FILE *rom)
@@ -60,19 +183,139 @@ rom_ld_t chip8_load_rom(chip8_t *c8, FILE *rom)
     fseek(rom, 0, SEEK_END);
     size_t bytes = ftell(rom);
     rewind(rom);
-    if (bytes > RAM_SIZE - START_ADDRESS) {
+    if (bytes > (size_t)c8->RAM_MASK + 1 - START_ADDRESS) {
         return ROM_TOO_LARGE;
     }
     fread(&c8->RAM[START_ADDRESS], sizeof(uint8_t), bytes, rom);
+    chip8_invalidate(c8, START_ADDRESS, bytes);
     return ROM_LOAD_SUCCESS;
 }
 
+void chip8_invalidate(chip8_t *c8, uint16_t address, uint16_t size)
+{
+    uint32_t end = address + size;
+    if (address <= c8->RAM_MASK && end > (uint32_t)c8->RAM_MASK + 1) { // write wrapped around the end of RAM
+        chip8_invalidate(c8, 0, end - c8->RAM_MASK - 1);
+    }
+    if (address >= RAM_SIZE) { // XO-CHIP data above the code
+        return;
+    }
+    // the instruction starting one byte earlier overlaps the first written byte
+    uint16_t from = address > 0 ? address - 1 : 0;
+    uint16_t to = end < RAM_SIZE ? end : RAM_SIZE;
+    if (from < to) {
+        memset(&c8->DECODED_VALID[from], 0, sizeof(uint8_t) * (to - from));
+    }
+    for (uint16_t i = address; i < to; i++) {
+        if (c8->CODE[i]) { // let the translating engines know
+            if (i < c8->CODE_LO) c8->CODE_LO = i;
+            if (i > c8->CODE_HI) c8->CODE_HI = i;
+            c8->CODE_GEN++;
+        }
+    }
+}
+
+// predecoded instruction at an address below RAM_SIZE - 1
+static instruction_t *chip8_decoded(chip8_t *c8, uint16_t address)
+{
+    if (!c8->DECODED_VALID[address]) {
+        chip8_decode(c8->RAM[address] << 8 | c8->RAM[address + 1], &c8->DECODED[address]);
+        chip8_specialize(&c8->DECODED[address], c8->PROFILE);
+        c8->DECODED_VALID[address] = 1;
+    }
+    return &c8->DECODED[address];
+}
+
 exec_res_t chip8_cycle(chip8_t *c8)
 {
-    uint16_t opcode = chip8_fetch(c8);
-    instruction_t inst;
-    chip8_decode(opcode, &inst);
-    return chip8_execute(c8, &inst);
+    uint16_t pc = c8->PC;
+    if (pc >= RAM_SIZE - 1) { // opcode would straddle the end of RAM
+        uint16_t opcode = chip8_fetch(c8);
+        instruction_t inst;
+        chip8_decode(opcode, &inst);
+        return chip8_execute(c8, &inst);
+    }
+    c8->PC = pc + 2;
+    return chip8_execute(c8, chip8_decoded(c8, pc));
+}
+
+CHIP8_SPECIALIZE void chip8_run_quirks(chip8_t *c8, uint32_t max_instructions, run_result_t *run,
+    exec_res_t (*execute)(chip8_t *, instruction_t *))
+{
+    instruction_t fetched, *inst;
+    run->executed = 0;
+    run->stop = RUN_BUDGET;
+    run->result = EXEC_SUCCESS;
+
+    while (run->executed < max_instructions) {
+        uint16_t pc = c8->PC;
+        // a breakpoint stops before its instruction, unless the run resumes from it
+        if (pc < RAM_SIZE && c8->BREAKPOINTS[pc] && run->executed > 0) {
+            run->stop = RUN_BREAKPOINT;
+            return;
+        }
+        if (pc >= RAM_SIZE - 1) {
+            chip8_decode(chip8_fetch(c8), &fetched);
+            inst = &fetched;
+        } else {
+            c8->PC = pc + 2;
+            inst = chip8_decoded(c8, pc);
+        }
+        run->result = execute(c8, inst);
+        run->executed++;
+
+        if (run->result != EXEC_SUCCESS) {
+            run->stop = RUN_ERROR;
+            return;
+        }
+        if (inst->OC == OC_DRW && c8->STOP_ON_DRAW) {
+            run->stop = RUN_DRAW;
+            return;
+        }
+        if (inst->OC == OC_LD_VX_K && c8->PC == pc) { // no key pressed yet
+            run->stop = RUN_WAIT;
+            return;
+        }
+        if (inst->OC == OC_JP) {
+            uint32_t skipped = chip8_idle(c8, max_instructions - run->executed);
+            if (skipped > 0) {
+                run->executed += skipped;
+                run->stop = RUN_IDLE;
+                return;
+            }
+        }
+    }
+}
+
+uint32_t chip8_idle(chip8_t *c8, uint32_t budget)
+{
+    uint16_t pc = c8->PC;
+    if (budget == 0 || pc >= RAM_SIZE - 5 || c8->BREAKPOINTS[pc]) {
+        return 0;
+    }
+    // 1NNN jumping to itself
+    instruction_t *inst = chip8_decoded(c8, pc);
+    if (inst->OC == OC_JP && inst->NNN == pc) {
+#ifdef CHIP8_PROFILER
+        if (c8->PROFILER) profiler_idle(c8->PROFILER, c8, pc, 1, budget);
+#endif
+        return budget;
+    }
+    // FX07, 3X00, 1NNN back to FX07 until the delay timer runs out
+    instruction_t *check = chip8_decoded(c8, pc + 2);
+    instruction_t *loop = chip8_decoded(c8, pc + 4);
+    if (inst->OC == OC_LD_VX_DT && (check->OP & 0xF0FF) == 0x3000 && check->X == inst->X
+        && loop->OC == OC_JP && loop->NNN == pc && c8->DT > 0
+        && !c8->BREAKPOINTS[pc + 2] && !c8->BREAKPOINTS[pc + 4]) {
+        // leave the loop where the skipped instructions would have
+#ifdef CHIP8_PROFILER
+        if (c8->PROFILER) profiler_idle(c8->PROFILER, c8, pc, 3, budget);
+#endif
+        c8->V[inst->X] = c8->DT;
+        c8->PC = pc + 2 * (budget % 3);
+        return budget;
+    }
+    return 0;
 }
 
 uint16_t chip8_fetch(chip8_t *c8)
@@ -84,6 +327,86 @@ uint16_t chip8_fetch(chip8_t *c8)
     return OH << 8 | OL;
 }
 
+static opclass_t chip8_classify(uint16_t opcode)
+{
+    switch (opcode & 0xF000) {
+        case 0x0000: {
+            if ((opcode & 0xFFF0) == 0x00C0) return OC_SCD;
+            switch (opcode) {
+                case 0x0000: return OC_NOP;
+                case 0x00E0: return OC_CLS;
+                case 0x00EE: return OC_RET;
+                case 0x00FB: return OC_SCR;
+                case 0x00FC: return OC_SCL;
+                case 0x00FE: return OC_LOW;
+                case 0x00FF: return OC_HIGH;
+                default: return OC_UNKNOWN;
+            }
+        }
+        case 0x1000: return OC_JP;
+        case 0x2000: return OC_CALL;
+        case 0x3000: return OC_SE_VX_NN;
+        case 0x4000: return OC_SNE_VX_NN;
+        case 0x5000: {
+            switch (opcode & 0x000F) {
+                case 0: return OC_SE_VX_VY;
+                case 2: return OC_SAVE;
+                case 3: return OC_LOAD;
+                default: return OC_UNKNOWN;
+            }
+        }
+        case 0x6000: return OC_LD_VX_NN;
+        case 0x7000: return OC_ADD_VX_NN;
+        case 0x8000: {
+            switch (opcode & 0x000F) {
+                case 0: return OC_LD_VX_VY;
+                case 1: return OC_OR;
+                case 2: return OC_AND;
+                case 3: return OC_XOR;
+                case 4: return OC_ADD_VX_VY;
+                case 5: return OC_SUB;
+                case 6: return OC_SHR;
+                case 7: return OC_SUBN;
+                case 0xE: return OC_SHL;
+                default: return OC_UNKNOWN;
+            }
+        }
+        case 0x9000: return (opcode & 0x000F) == 0 ? OC_SNE_VX_VY : OC_UNKNOWN;
+        case 0xA000: return OC_LD_I;
+        case 0xB000: return OC_JP_V0;
+        case 0xC000: return OC_RND;
+        case 0xD000: return OC_DRW;
+        case 0xE000: {
+            switch (opcode & 0x00FF) {
+                case 0x9E: return OC_SKP;
+                case 0xA1: return OC_SKNP;
+                default: return OC_UNKNOWN;
+            }
+        }
+        default: {
+            switch (opcode & 0x00FF) {
+                case 0x00: return opcode == 0xF000 ? OC_LD_I_LONG : OC_UNKNOWN;
+                case 0x01: return OC_PLANE;
+                case 0x02: return opcode == 0xF002 ? OC_AUDIO : OC_UNKNOWN;
+                case 0x07: return OC_LD_VX_DT;
+                case 0x0A: return OC_LD_VX_K;
+                case 0x15: return OC_LD_DT_VX;
+                case 0x18: return OC_LD_ST_VX;
+                case 0x1E: return OC_ADD_I_VX;
+                case 0x29: return OC_LD_F_VX;
+                case 0x30: return OC_LD_HF_VX;
+                case 0x33: return OC_LD_B_VX;
+                case 0x3A: return OC_PITCH;
+                case 0x55: return OC_LD_I_VX;
+                case 0x65: return OC_LD_VX_I;
+                case 0x75: return OC_LD_R_VX;
+                case 0x85: return OC_LD_VX_R;
+                default: return OC_UNKNOWN;
+            }
+        }
+    }
+}
+
 void chip8_decode(uint16_t opcode, instruction_t *inst)
 {
     inst->OP = opcode;
@@ -92,19 +415,167 @@ void chip8_decode(uint16_t opcode, instruction_t *inst)
     inst->N = opcode & 0x000F;
     inst->NN = opcode & 0x00FF;
     inst->NNN = opcode & 0x0FFF;
+    inst->OC = chip8_classify(opcode);
 }
 
-exec_res_t chip8_execute(chip8_t *c8, instruction_t *inst)
+// XOR the rows of a sprite from address onto a plane; returns the colliding pixels
+CHIP8_SPECIALIZE uint64_t chip8_draw_plane(chip8_t *c8, uint64_t (*screen)[2], int X, int Y, int rows, int wide,
+    uint16_t address, const int quirks)
+{
+    const int clip = quirks & QUIRK_CLIP;
+    int height = chip8_height(c8);
+    uint64_t collision = 0;
+    for (int py = 0; py < rows; py++, address += 1 + wide) {
+        // rows below the bottom are clipped or wrap around
+        if (clip && py + Y >= height) break;
+        uint64_t *line = screen[(py + Y) & (height - 1)];
+        uint64_t row = (uint64_t)c8->RAM[address & QUIRK_MASK(quirks)] << 56;
+        if (wide) row |= (uint64_t)c8->RAM[(address + 1) & QUIRK_MASK(quirks)] << 48;
+        if (!c8->HIRES) {
+            uint64_t pattern = clip ? row >> X : row >> X | row << ((SCREEN_WIDTH - X) & (SCREEN_WIDTH - 1));
+            collision |= line[0] & pattern;
+            line[0] ^= pattern;
+        } else { // the row spans both words; pixels right of the edge are clipped or wrap around
+            uint64_t left, right;
+            if (X < 64) {
+                left = row >> X;
+                right = X ? row << (64 - X) : 0;
+            } else {
+                left = (!clip && X > 64) ? row << (HIRES_WIDTH - X) : 0;
+                right = row >> (X - 64);
+            }
+            collision |= (line[0] & left) | (line[1] & right);
+            line[0] ^= left;
+            line[1] ^= right;
+        }
+    }
+    return collision;
+}
+
+// rows of the screen a sprite of N rows at Y covers, a bit each; below the bottom they are clipped or wrap around
+CHIP8_SPECIALIZE uint64_t chip8_sprite_rows(int height, int Y, int rows, const int quirks)
+{
+    uint64_t sprite = (1ULL << rows) - 1;
+    uint64_t covered = sprite << Y;
+    uint64_t wrapped = height == HIRES_HEIGHT ? (Y ? sprite >> (HIRES_HEIGHT - Y) : 0) : covered >> SCREEN_HEIGHT;
+    if (height == SCREEN_HEIGHT) covered &= 0xFFFFFFFFULL;
+    return (quirks & QUIRK_CLIP) ? covered : covered | wrapped;
+}
+
+// XOR a sprite of N rows, or of 16 rows of 16 pixels for DXY0, onto each selected plane, with the data of one
+// plane after the other; returns the collision flag
+CHIP8_SPECIALIZE uint8_t chip8_draw(chip8_t *c8, uint8_t vx, uint8_t vy, uint8_t n, const int quirks)
+{
+    int X = vx & (chip8_width(c8) - 1), Y = vy & (chip8_height(c8) - 1);
+    int wide = n == 0 && (quirks & QUIRK_SCHIP), rows = wide ? 16 : n;
+    c8->DIRTY |= chip8_sprite_rows(chip8_height(c8), Y, rows, quirks);
+    if (c8->PLANE == 1) { // everything but XO-CHIP
+        return chip8_draw_plane(c8, c8->SCREEN[0], X, Y, rows, wide, c8->I, quirks) != 0;
+    }
+    uint16_t address = c8->I;
+    uint64_t collision = 0;
+    for (int plane = 0; plane < PLANES; plane++) {
+        if (!(c8->PLANE >> plane & 1)) continue;
+        collision |= chip8_draw_plane(c8, c8->SCREEN[plane], X, Y, rows, wide, address, quirks);
+        address += rows * (1 + wide);
+    }
+    return collision != 0;
+}
+
+// clear the selected planes
+static void chip8_clear(chip8_t *c8)
+{
+    for (int plane = 0; plane < PLANES; plane++) {
+        if (c8->PLANE >> plane & 1) memset(c8->SCREEN[plane], 0, sizeof(c8->SCREEN[plane]));
+    }
+}
+
+// scroll the rows of the selected planes down by n in the current resolution, the top ones become empty
+static void chip8_scroll_down(chip8_t *c8, int n)
+{
+    int height = chip8_height(c8);
+    for (int plane = 0; plane < PLANES; plane++) {
+        if (!(c8->PLANE >> plane & 1)) continue;
+        memmove(c8->SCREEN[plane][n], c8->SCREEN[plane][0], sizeof(c8->SCREEN[plane][0]) * (height - n));
+        memset(c8->SCREEN[plane][0], 0, sizeof(c8->SCREEN[plane][0]) * n);
+    }
+}
+
+// scroll every row of the selected planes by 4 pixels, to the right or to the left
+static void chip8_scroll_side(chip8_t *c8, int right)
 {
+    int height = chip8_height(c8);
+    for (int plane = 0; plane < PLANES; plane++) {
+        if (!(c8->PLANE >> plane & 1)) continue;
+        for (int y = 0; y < height; y++) {
+            uint64_t *line = c8->SCREEN[plane][y];
+            if (!c8->HIRES) {
+                line[0] = right ? line[0] >> 4 : line[0] << 4;
+            } else if (right) {
+                line[1] = line[1] >> 4 | line[0] << 60;
+                line[0] >>= 4;
+            } else {
+                line[0] = line[0] << 4 | line[1] >> 60;
+                line[1] <<= 4;
+            }
+        }
+    }
+}
+
+// how far a skip goes: over F000 NNNN it takes 4 bytes with XO-CHIP
+CHIP8_SPECIALIZE uint16_t chip8_skip(chip8_t *c8, const int quirks)
+{
+    if ((quirks & QUIRK_LONG) && c8->RAM[c8->PC] == 0xF0 && c8->RAM[c8->PC + 1] == 0x00) {
+        return 4;
+    }
+    return 2;
+}
+
+CHIP8_SPECIALIZE exec_res_t chip8_execute_quirks(chip8_t *c8, instruction_t *inst, const int quirks)
+{
+#ifdef CHIP8_PROFILER
+    if (c8->PROFILER) profiler_count(c8->PROFILER, c8, inst);
+#endif
     switch (inst->OP & 0xF000) {
         case 0x0000: {
+            if ((inst->OP & 0xFFF0) == 0x00C0) { // scroll down N rows
+                if (!(quirks & QUIRK_SCHIP)) return UNKNOWN_OPCODE;
+                chip8_scroll_down(c8, inst->N);
+                c8->RF = 1;
+                c8->DIRTY = ALL_ROWS;
+                break;
+            }
             switch (inst->OP) {
                 case 0x0000: { // no operation
                     break;
                 }
                 case 0x00E0: { // clear screen
-                    memset(c8->SCREEN, 0, sizeof(uint8_t) * SCREEN_WIDTH * SCREEN_HEIGHT);
+                    chip8_clear(c8);
+                    c8->RF = 1;
+                    c8->DIRTY = ALL_ROWS;
+                    break;
+                }
+                case 0x00FB: { // scroll right 4 pixels
+                    if (!(quirks & QUIRK_SCHIP)) return UNKNOWN_OPCODE;
+                    chip8_scroll_side(c8, 1);
+                    c8->RF = 1;
+                    c8->DIRTY = ALL_ROWS;
+                    break;
+                }
+                case 0x00FC: { // scroll left 4 pixels
+                    if (!(quirks & QUIRK_SCHIP)) return UNKNOWN_OPCODE;
+                    chip8_scroll_side(c8, 0);
+                    c8->RF = 1;
+                    c8->DIRTY = ALL_ROWS;
+                    break;
+                }
+                case 0x00FE: // 64x32 mode
+                case 0x00FF: { // 128x64 mode
+                    if (!(quirks & QUIRK_SCHIP)) return UNKNOWN_OPCODE;
+                    c8->HIRES = inst->OP == 0x00FF;
+                    memset(c8->SCREEN, 0, sizeof(c8->SCREEN));
                     c8->RF = 1;
+                    c8->DIRTY = ALL_ROWS;
                     break;
                 }
                 case 0x00EE: { // return from subroutine
@@ -130,20 +601,41 @@ exec_res_t chip8_execute(chip8_t *c8, instruction_t *inst)
         }
         case 0x3000: { // skip if VX == NN
             if (c8->V[inst->X] == inst->NN) {
-                c8->PC += 2;
+                c8->PC += chip8_skip(c8, quirks);
             }
             break;
         }
         case 0x4000: { // skip if VX != NN
             if (c8->V[inst->X] != inst->NN) {
-                c8->PC += 2;
+                c8->PC += chip8_skip(c8, quirks);
             }
             break;
         }
-        case 0x5000: { // skip if VX == VY
-            if (inst->N != 0) return UNKNOWN_OPCODE;
-            if (c8->V[inst->X] == c8->V[inst->Y]) {
-                c8->PC += 2;
+        case 0x5000: {
+            int step = inst->X <= inst->Y ? 1 : -1;
+            switch (inst->N) {
+                case 0: { // skip if VX == VY
+                    if (c8->V[inst->X] == c8->V[inst->Y]) {
+                        c8->PC += chip8_skip(c8, quirks);
+                    }
+                    break;
+                }
+                case 2: { // store VX-VY, in either direction
+                    if (!(quirks & QUIRK_XOCHIP)) return UNKNOWN_OPCODE;
+                    for (int i = 0, r = inst->X; i <= abs(inst->Y - inst->X); i++, r += step) {
+                        c8->RAM[(c8->I + i) & QUIRK_MASK(quirks)] = c8->V[r];
+                    }
+                    chip8_invalidate(c8, c8->I & QUIRK_MASK(quirks), abs(inst->Y - inst->X) + 1);
+                    break;
+                }
+                case 3: { // load VX-VY, in either direction
+                    if (!(quirks & QUIRK_XOCHIP)) return UNKNOWN_OPCODE;
+                    for (int i = 0, r = inst->X; i <= abs(inst->Y - inst->X); i++, r += step) {
+                        c8->V[r] = c8->RAM[(c8->I + i) & QUIRK_MASK(quirks)];
+                    }
+                    break;
+                }
+                default: return UNKNOWN_OPCODE;
             }
             break;
         }
@@ -163,17 +655,17 @@ exec_res_t chip8_execute(chip8_t *c8, instruction_t *inst)
                 }
                 case 1: { // VX |= VY
                     c8->V[inst->X] |= c8->V[inst->Y];
-                    c8->V[0xF] = 0;
+                    if (quirks & QUIRK_VF_RESET) c8->V[0xF] = 0;
                     break;
                 }
                 case 2: { // VX &= VY
                     c8->V[inst->X] &= c8->V[inst->Y];
-                    c8->V[0xF] = 0;
+                    if (quirks & QUIRK_VF_RESET) c8->V[0xF] = 0;
                     break;
                 }
                 case 3: { // VX ^= VY
                     c8->V[inst->X] ^= c8->V[inst->Y];
-                    c8->V[0xF] = 0;
+                    if (quirks & QUIRK_VF_RESET) c8->V[0xF] = 0;
                     break;
                 }
                 case 4: { // VX += VY
@@ -189,9 +681,9 @@ exec_res_t chip8_execute(chip8_t *c8, instruction_t *inst)
                     break;
                 }
                 case 6: { // VX = VY >> 1
-                    uint8_t bit = c8->V[inst->Y] & 1;
-                    c8->V[inst->X] = c8->V[inst->Y] >> 1;
-                    c8->V[0xF] = bit;
+                    uint8_t source = c8->V[(quirks & QUIRK_SHIFT_VY) ? inst->Y : inst->X];
+                    c8->V[inst->X] = source >> 1;
+                    c8->V[0xF] = source & 1;
                     break;
                 }
                 case 7: { // VX = VY - VX
@@ -201,9 +693,9 @@ exec_res_t chip8_execute(chip8_t *c8, instruction_t *inst)
                     break;
                 }
                 case 0xE: { // VX = VY << 1
-                    uint8_t bit = c8->V[inst->Y] >> 7;
-                    c8->V[inst->X] = c8->V[inst->Y] << 1;
-                    c8->V[0xF] = bit;
+                    uint8_t source = c8->V[(quirks & QUIRK_SHIFT_VY) ? inst->Y : inst->X];
+                    c8->V[inst->X] = source << 1;
+                    c8->V[0xF] = source >> 7;
                     break;
                 }
                 default: return UNKNOWN_OPCODE;
@@ -213,7 +705,7 @@ exec_res_t chip8_execute(chip8_t *c8, instruction_t *inst)
         case 0x9000: { // skip if VX != VY
             if (inst->N != 0) return UNKNOWN_OPCODE;
             if (c8->V[inst->X] != c8->V[inst->Y]) {
-                c8->PC += 2;
+                c8->PC += chip8_skip(c8, quirks);
             }
             break;
         }
@@ -221,28 +713,16 @@ exec_res_t chip8_execute(chip8_t *c8, instruction_t *inst)
             c8->I = inst->NNN;
             break;
         }
-        case 0xB000: { // jump to address NNN + V0
-            c8->PC = inst->NNN + c8->V[0];
+        case 0xB000: { // jump to address NNN + V0, or XNN + VX
+            c8->PC = inst->NNN + c8->V[(quirks & QUIRK_JUMP_VX) ? inst->X : 0];
             break;
         }
         case 0xC000: { // VX = random NN
-            c8->V[inst->X] = (rand() % 256) & inst->NN;
+            c8->V[inst->X] = chip8_random(c8) & inst->NN;
             break;
         }
         case 0xD000: { // draw
-            c8->V[0xF] = 0;
-            uint8_t X = c8->V[inst->X] % SCREEN_WIDTH;
-            uint8_t Y = c8->V[inst->Y] % SCREEN_HEIGHT;
-            for (int py = 0; py < inst->N && py + Y < SCREEN_HEIGHT; py++) {
-                uint8_t pattern = c8->RAM[c8->I + py];
-                for (int px = 0; px <= 7 && px + X < SCREEN_WIDTH; px++) {
-                    uint8_t pixel = (pattern >> (7 - px)) & 1;
-                    if (pixel) {
-                        c8->V[0xF] |= c8->SCREEN[px + X][py + Y];
-                        c8->SCREEN[px + X][py + Y] ^= pixel;
-                    }
-                }
-            }
+            c8->V[0xF] = chip8_draw(c8, c8->V[inst->X], c8->V[inst->Y], inst->N, quirks);
             c8->RF = 1;
             break;
         }
@@ -250,13 +730,13 @@ exec_res_t chip8_execute(chip8_t *c8, instruction_t *inst)
             switch (inst->NN) {
                 case 0x9E: { // skip if VX key pressed
                     if (c8->KEYBOARD[c8->V[inst->X]]) {
-                        c8->PC += 2;
+                        c8->PC += chip8_skip(c8, quirks);
                     }
                     break;
                 }
                 case 0xA1: { // skip if VX key not pressed
                     if (!c8->KEYBOARD[c8->V[inst->X]]) {
-                        c8->PC += 2;
+                        c8->PC += chip8_skip(c8, quirks);
                     }
                     break;
                 }
@@ -266,6 +746,25 @@ exec_res_t chip8_execute(chip8_t *c8, instruction_t *inst)
         }
         case 0xF000: {
             switch (inst->NN) {
+                case 0x00: { // I = NNNN, the next opcode
+                    if (inst->X != 0 || !(quirks & QUIRK_XOCHIP)) return UNKNOWN_OPCODE;
+                    c8->I = c8->RAM[c8->PC] << 8 | c8->RAM[c8->PC + 1];
+                    c8->PC += 2;
+                    break;
+                }
+                case 0x01: { // select the planes in X
+                    if (!(quirks & QUIRK_XOCHIP)) return UNKNOWN_OPCODE;
+                    c8->PLANE = inst->X & ((1 << PLANES) - 1);
+                    break;
+                }
+                case 0x02: { // load the audio pattern from I
+                    if (inst->X != 0 || !(quirks & QUIRK_XOCHIP)) return UNKNOWN_OPCODE;
+                    for (int i = 0; i < PATTERN_SIZE; i++) {
+                        c8->PATTERN[i] = c8->RAM[(c8->I + i) & QUIRK_MASK(quirks)];
+                    }
+                    c8->AUDIO = 1;
+                    break;
+                }
                 case 0x07: { // VX = DT
                     c8->V[inst->X] = c8->DT;
                     break;
@@ -300,25 +799,51 @@ exec_res_t chip8_execute(chip8_t *c8, instruction_t *inst)
                     c8->I = FONTSET_ADDRESS + c8->V[inst->X] * FONT_OFFSET;
                     break;
                 }
+                case 0x30: { // set I to the big HEX char at VX
+                    if (!(quirks & QUIRK_SCHIP)) return UNKNOWN_OPCODE;
+                    c8->I = BIG_FONTSET_ADDRESS + c8->V[inst->X] * BIG_FONT_OFFSET;
+                    break;
+                }
+                case 0x3A: { // pitch of the audio pattern = VX
+                    if (!(quirks & QUIRK_XOCHIP)) return UNKNOWN_OPCODE;
+                    c8->PITCH = c8->V[inst->X];
+                    break;
+                }
                 case 0x33: { // VX BCD
                     uint8_t num = c8->V[inst->X], mod;
                     for (int i = 2; i >= 0; i--) {
                         mod = num % 10;
-                        c8->RAM[c8->I + i] = mod;
+                        c8->RAM[(c8->I + i) & QUIRK_MASK(quirks)] = mod;
                         num = (num - mod) / 10;
                     }
+                    chip8_invalidate(c8, c8->I & QUIRK_MASK(quirks), 3);
                     break;
                 }
                 case 0x55: { // store V0-VX
+                    chip8_invalidate(c8, c8->I & QUIRK_MASK(quirks), inst->X + 1);
                     for (int i = 0; i <= inst->X; i++) {
-                        c8->RAM[c8->I++] = c8->V[i];
+                        c8->RAM[(c8->I + i) & QUIRK_MASK(quirks)] = c8->V[i];
                     }
+                    if (quirks & QUIRK_INDEX_X1) c8->I += inst->X + 1;
+                    if (quirks & QUIRK_INDEX_X) c8->I += inst->X;
                     break;
                 }
                 case 0x65: { // load V0-VX
                     for (int i = 0; i <= inst->X; i++) {
-                        c8->V[i] = c8->RAM[c8->I++];
+                        c8->V[i] = c8->RAM[(c8->I + i) & QUIRK_MASK(quirks)];
                     }
+                    if (quirks & QUIRK_INDEX_X1) c8->I += inst->X + 1;
+                    if (quirks & QUIRK_INDEX_X) c8->I += inst->X;
+                    break;
+                }
+                case 0x75: { // store V0-VX in the user flags
+                    if (!(quirks & QUIRK_SCHIP)) return UNKNOWN_OPCODE;
+                    memcpy(c8->RPL, c8->V, sizeof(uint8_t) * (inst->X + 1));
+                    break;
+                }
+                case 0x85: { // load V0-VX from the user flags
+                    if (!(quirks & QUIRK_SCHIP)) return UNKNOWN_OPCODE;
+                    memcpy(c8->V, c8->RPL, sizeof(uint8_t) * (inst->X + 1));
                     break;
                 }
                 default: return UNKNOWN_OPCODE;
@@ -334,8 +859,93 @@ exec_res_t chip8_execute(chip8_t *c8, instruction_t *inst)
     return EXEC_SUCCESS;
 }
 
+// an execute function and a run loop for each profile, with its quirks as constants
+#define CHIP8_PROFILE(name, profile) \
+    static exec_res_t chip8_execute_##name(chip8_t *c8, instruction_t *inst) \
+    { \
+        return chip8_execute_quirks(c8, inst, PROFILE_QUIRKS(profile)); \
+    } \
+    static void chip8_run_##name(chip8_t *c8, uint32_t max_instructions, run_result_t *run) \
+    { \
+        chip8_run_quirks(c8, max_instructions, run, chip8_execute_##name); \
+    }
+
+CHIP8_PROFILE(vip, PROFILE_VIP)
+CHIP8_PROFILE(chip48, PROFILE_CHIP48)
+CHIP8_PROFILE(schip, PROFILE_SCHIP)
+CHIP8_PROFILE(xochip, PROFILE_XOCHIP)
+
+static exec_res_t (*const chip8_executors[PROFILE_COUNT])(chip8_t *, instruction_t *) = {
+    chip8_execute_vip, chip8_execute_chip48, chip8_execute_schip, chip8_execute_xochip
+};
+
+static void (*const chip8_runners[PROFILE_COUNT])(chip8_t *, uint32_t, run_result_t *) = {
+    chip8_run_vip, chip8_run_chip48, chip8_run_schip, chip8_run_xochip
+};
+
+exec_res_t chip8_execute(chip8_t *c8, instruction_t *inst)
+{
+    return chip8_executors[c8->PROFILE](c8, inst);
+}
+
+void chip8_run(chip8_t *c8, uint32_t max_instructions, run_result_t *run)
+{
+    chip8_runners[c8->PROFILE](c8, max_instructions, run);
+}
+
 void chip8_tick(chip8_t *c8)
 {
     if (c8->DT > 0) c8->DT--;
     if (c8->ST > 0) c8->ST--;
 }
+
+int chip8_width(chip8_t *c8)
+{
+    return c8->HIRES ? HIRES_WIDTH : SCREEN_WIDTH;
+}
+
+int chip8_height(chip8_t *c8)
+{
+    return c8->HIRES ? HIRES_HEIGHT : SCREEN_HEIGHT;
+}
+
+uint8_t chip8_pixel(chip8_t *c8, int x, int y)
+{
+    uint8_t color = 0;
+    for (int plane = 0; plane < PLANES; plane++) {
+        color |= (c8->SCREEN[plane][y][x >> 6] >> (63 - (x & 63)) & 1) << plane;
+    }
+    return color;
+}
+
+// the 8 pixels of a screen byte as bytes of 0 or 1, leftmost first in memory
+static uint64_t chip8_spread(uint8_t byte)
+{
+    uint64_t bytes = ((byte * 0x8040201008040201ULL) & 0x8080808080808080ULL) >> 7;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    bytes = __builtin_bswap64(bytes);
+#endif
+    return bytes;
+}
+
+void chip8_screen_bytes(chip8_t *c8, uint8_t *bytes)
+{
+    chip8_screen_rows(c8, bytes, ALL_ROWS);
+}
+
+// like chip8_screen_bytes, but only the given rows are written, at their place in the bytes
+void chip8_screen_rows(chip8_t *c8, uint8_t *bytes, uint64_t rows)
+{
+    // one byte per pixel of the current resolution, row by row, with the bit of plane p in bit p;
+    // the planes are composed 8 pixels at a time
+    int width = chip8_width(c8), height = chip8_height(c8);
+    for (int y = 0; y < height; y++, bytes += width) {
+        if (!(rows >> y & 1)) continue;
+        for (int x = 0; x < width; x += 8) {
+            int word = x >> 6, shift = 56 - (x & 63);
+            uint64_t pixels = chip8_spread(c8->SCREEN[0][y][word] >> shift & 0xFF)
+                | chip8_spread(c8->SCREEN[1][y][word] >> shift & 0xFF) << 1;
+            memcpy(bytes + x, &pixels, 8);
+        }
+    }
+}
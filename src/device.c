@@ -3,6 +3,7 @@
 #endif
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <SDL2/SDL.h>
 #include "include/device.h"
@@ -10,26 +11,145 @@
 #include "include/input.h"
 #include "include/display.h"
 #include "include/beeper.h"
+#include "include/threaded.h"
+#include "include/block.h"
+#include "include/jit.h"
+#include "include/aot.h"
+#include "include/snapshot.h"
+#include "include/movie.h"
+#include "include/profiler.h"
+#include "include/frames.h"
+
+static const char *movie_errors[] = {
+    [MOVIE_SUCCESS] = "success",
+    [MOVIE_NOT_EXISTS] = "file not accessible",
+    [MOVIE_BAD_MAGIC] = "not a movie",
+    [MOVIE_BAD_VERSION] = "unsupported movie version",
+    [MOVIE_TRUNCATED] = "truncated movie",
+    [MOVIE_WRITE_FAILED] = "write failed"
+};
 
 device_t *device_init(args_t *args)
 {
-    srand(time(NULL));
     device_t *device = malloc(sizeof(device_t));
     device->chip_8 = chip8_create();
-    device->display = display_create("CHIP-8 emulator", SCREEN_WIDTH * 10, SCREEN_HEIGHT * 10, args->bg_color, args->fg_color);
-    device->beeper = beeper_create(args->tone);
+    if (args->headless) { // no window, renderer or audio device
+        device->display = NULL;
+        device->beeper = NULL;
+    } else {
+        uint32_t colors[COLORS] = { args->bg_color, args->fg_color, args->plane2_color, args->both_color };
+        // the brightness an unlit pixel keeps every frame, from a percentage to a fraction of 256
+        uint8_t decay = args->phosphor * 256 / 100 > 255 ? 255 : args->phosphor * 256 / 100;
+        device->display = display_create("CHIP-8 emulator", SCREEN_WIDTH * 10, SCREEN_HEIGHT * 10, colors, decay);
+        device->beeper = beeper_create(args->tone);
+    }
     device->rom_path = args->rom_path;
     device->ipf = args->ipf;
+    device->engine = args->engine;
+    device->seed = args->seed;
+    device->profile = args->profile;
+    device->error = EXEC_SUCCESS;
+    device->profiler = NULL;
+    device->profiler_path = args->profiler_path;
+    if (device->profiler_path) {
+#ifdef CHIP8_PROFILER
+        // the other engines run most instructions without chip8_execute
+        if (device->engine != ENGINE_SWITCH) {
+            fprintf(stderr, "profiling %s: with the switch engine\n", device->profiler_path);
+            device->engine = ENGINE_SWITCH;
+        }
+        device->profiler = profiler_create();
+        device->chip_8->PROFILER = device->profiler;
+#else
+        fprintf(stderr, "profiling %s: not in this build, see 'make profiler'\n", device->profiler_path);
+#endif
+    }
+    device->jit = (device->engine == ENGINE_JIT) ? jit_create() : NULL;
+    if (device->engine == ENGINE_JIT && device->jit == NULL) { // no JIT for this host
+        device->engine = ENGINE_BLOCK;
+    }
+    device->blocks = (device->engine == ENGINE_BLOCK) ? block_cache_create() : NULL;
+    device->rewind = args->headless ? NULL : rewind_create(REWIND_BYTES, REWIND_FRAMES);
+    device->rewinding = 0;
+    device->movie = NULL;
+    device->playing = 0;
+    device->movie_path = args->record_path;
+    if (args->play_path) { // the movie decides the random numbers and the quirks
+        FILE *f = fopen(args->play_path, "rb");
+        movie_res_t result = movie_read(&device->movie, f);
+        if (f) fclose(f);
+        if (result == MOVIE_SUCCESS) {
+            device->seed = device->movie->seed;
+            device->profile = device->movie->profile;
+            device->playing = 1;
+            device->movie_path = args->play_path;
+        } else {
+            fprintf(stderr, "playing %s: %s\n", args->play_path, movie_errors[result]);
+        }
+    }
+    device->thread = NULL;
+    SDL_AtomicSet(&device->emulating, 0);
+    device->finished = args->headless ? NULL : frames_create();
+    input_queue_init(&device->input);
+    memset(device->keys, 0, sizeof(device->keys));
+    device->keys_sent = 0;
+    device->frame = 0;
+    device->instructions = 0;
+    device->instructions_shown = device->title_instructions = 0;
     device->t1 = device->t60 = SDL_GetTicks();
     device->frames = 0;
     device->running = 1;
     return device;
 }
 
+static const char *profiler_errors[] = {
+    [PROFILER_SUCCESS] = "success",
+    [PROFILER_NOT_EXISTS] = "file not accessible",
+    [PROFILER_WRITE_FAILED] = "write failed"
+};
+
+// writes the reports of the profiler next to each other: <path>.csv, <path>.json and <path>.ppm
+static void device_profile(device_t *device)
+{
+    size_t length = strlen(device->profiler_path);
+    char *path = malloc(length + sizeof(".json"));
+    const char *extensions[] = { ".csv", ".json", ".ppm" };
+    for (int i = 0; i < 3; i++) {
+        memcpy(path, device->profiler_path, length);
+        strcpy(path + length, extensions[i]);
+        FILE *f = fopen(path, i == 2 ? "wb" : "w");
+        profiler_res_t result = i == 0 ? profiler_write_csv(device->profiler, device->chip_8, f)
+            : i == 1 ? profiler_write_json(device->profiler, f) : profiler_write_heatmap(device->profiler, f);
+        if (f) fclose(f);
+        fprintf(stderr, "profiling %s: %s\n", path, profiler_errors[result]);
+    }
+    free(path);
+}
+
 void device_destroy(device_t **device)
 {
-    display_destroy(&(*device)->display);
-    beeper_destroy(&(*device)->beeper);
+    if ((*device)->thread) { // the emulation stops after its current frame
+        SDL_AtomicSet(&(*device)->emulating, 0);
+        SDL_WaitThread((*device)->thread, NULL);
+    }
+    if ((*device)->finished) frames_destroy(&(*device)->finished);
+    if ((*device)->display) display_destroy(&(*device)->display);
+    if ((*device)->beeper) beeper_destroy(&(*device)->beeper);
+    if ((*device)->blocks) block_cache_destroy(&(*device)->blocks);
+    if ((*device)->jit) jit_destroy(&(*device)->jit);
+    if ((*device)->rewind) rewind_destroy(&(*device)->rewind);
+    if ((*device)->movie && !(*device)->playing) { // the recording ends here
+        movie_finish((*device)->movie, (*device)->frame, (*device)->instructions, (*device)->chip_8);
+        FILE *f = fopen((*device)->movie_path, "wb");
+        movie_res_t result = movie_write((*device)->movie, f);
+        if (f) fclose(f);
+        fprintf(stderr, "recording %s: %s\n", (*device)->movie_path, movie_errors[result]);
+    }
+    if ((*device)->movie) movie_destroy(&(*device)->movie);
+    if ((*device)->profiler) {
+        device_profile(*device);
+        profiler_destroy(&(*device)->profiler);
+    }
     chip8_destroy(&(*device)->chip_8);
     free(*device);
     *device = NULL;
@@ -37,60 +157,394 @@ void device_destroy(device_t **device)
 
 rom_ld_t device_start(device_t *device)
 {
+    device->error = EXEC_SUCCESS;
+    if (device->rewind) rewind_clear(device->rewind);
     chip8_reset(device->chip_8);
+    chip8_seed(device->chip_8, device->seed);
+    chip8_profile(device->chip_8, device->profile);
     FILE *rom = fopen(device->rom_path, "rb");
     rom_ld_t status = chip8_load_rom(device->chip_8, rom);
     if (rom) fclose(rom);
+    device->frame = 0;
+    device->instructions = 0;
+    if (status == ROM_LOAD_SUCCESS && device->playing) {
+        device->movie->next = 0;
+        if (device->movie->rom_hash != movie_rom_hash(device->chip_8)) {
+            fprintf(stderr, "playing %s: recorded with another ROM\n", device->movie_path);
+        }
+    } else if (status == ROM_LOAD_SUCCESS && device->movie_path) { // a restart records from scratch
+        if (device->movie) movie_destroy(&device->movie);
+        device->movie = movie_create(movie_rom_hash(device->chip_8), device->seed, device->profile);
+    }
     return status;
 }
 
-#ifdef __EMSCRIPTEN__
-void device_iterate(void *_device) {
-    device_t *device = _device;
-#else
-void device_iterate(device_t *device) {
-#endif
-    int ticks = SDL_GetTicks();
-    input_event_t ie = intput_handle(device->chip_8->KEYBOARD);
+// at the start of every frame: the movie sets the keys and the IPF, or records the ones in use
+static void device_movie(device_t *device)
+{
+    if (device->movie == NULL) {
+        return;
+    }
+    if (!device->playing) {
+        movie_record(device->movie, device->frame, device->instructions, device->chip_8->KEYBOARD, device->ipf);
+    } else if (!movie_play(device->movie, device->frame, device->instructions, device->chip_8->KEYBOARD, &device->ipf)) {
+        fprintf(stderr, "playing %s: out of sync at frame %u\n", device->movie_path, device->frame);
+    }
+}
 
+// does the run end like the played movie? stops playing it
+int device_verify(device_t *device)
+{
+    int same = movie_verify(device->movie, device->frame, device->instructions, device->chip_8);
+    fprintf(stderr, "playing %s: %s after %u frames\n", device->movie_path, same ? "verified" : "out of sync", device->frame);
+    movie_destroy(&device->movie);
+    device->playing = 0;
+    return same;
+}
+
+static const char *snapshot_errors[] = {
+    [SNAPSHOT_SUCCESS] = "success",
+    [SNAPSHOT_NOT_EXISTS] = "file not accessible",
+    [SNAPSHOT_BAD_MAGIC] = "not a snapshot",
+    [SNAPSHOT_BAD_VERSION] = "unsupported snapshot version",
+    [SNAPSHOT_TRUNCATED] = "truncated snapshot",
+    [SNAPSHOT_WRITE_FAILED] = "write failed",
+    [SNAPSHOT_CORRUPT] = "corrupt snapshot",
+    [SNAPSHOT_NO_MEMORY] = "out of memory"
+};
+
+// after restoring a state: the keys held right now win over the saved ones, and a halted emulation resumes
+static void device_restored(device_t *device, const uint8_t *keyboard)
+{
+    memcpy(device->chip_8->KEYBOARD, keyboard, sizeof(uint8_t) * 16);
+    device->chip_8->RF = 1;
+    device->chip_8->DIRTY = ALL_ROWS;
+    device->error = EXEC_SUCCESS;
+}
+
+// save the instance next to the ROM file
+static void device_save(device_t *device)
+{
+    char path[FILENAME_MAX];
+    snprintf(path, sizeof(path), "%s.state", device->rom_path);
+    FILE *f = fopen(path, "wb");
+    snapshot_res_t result = chip8_snapshot_write(device->chip_8, f);
+    if (f) fclose(f);
+    fprintf(stderr, "saving %s: %s\n", path, snapshot_errors[result]);
+}
+
+// restore the instance saved next to the ROM file
+static void device_load(device_t *device)
+{
+    char path[FILENAME_MAX];
+    snprintf(path, sizeof(path), "%s.state", device->rom_path);
+    uint8_t keyboard[16];
+    memcpy(keyboard, device->chip_8->KEYBOARD, sizeof(keyboard));
+    FILE *f = fopen(path, "rb");
+    snapshot_res_t result = chip8_snapshot_read(device->chip_8, f);
+    if (f) fclose(f);
+    fprintf(stderr, "loading %s: %s\n", path, snapshot_errors[result]);
+    if (result == SNAPSHOT_SUCCESS) {
+        device_restored(device, keyboard);
+    }
+}
+
+static const char *exec_errors[] = {
+    [EXEC_SUCCESS] = "success",
+    [UNKNOWN_OPCODE] = "unknown opcode",
+    [STACK_OVERFLOW] = "stack overflow",
+    [STACK_UNDERFLOW] = "stack underflow",
+    [PC_OVERFLOW] = "program counter overflow"
+};
+
+// run up to budget instructions, stopping at the first error; returns the instructions used up
+static exec_res_t device_execute(device_t *device, uint32_t budget, uint32_t *used)
+{
+    exec_res_t result = EXEC_SUCCESS;
+    uint32_t executed;
+    uint32_t i;
+    for (i = 0; i < budget && result == EXEC_SUCCESS; i += executed) {
+        switch (device->engine) {
+            case ENGINE_THREADED: {
+                result = chip8_threaded_run(device->chip_8, budget - i, &executed);
+                break;
+            }
+            case ENGINE_BLOCK: {
+                result = block_run(device->blocks, device->chip_8, budget - i, &executed);
+                break;
+            }
+            case ENGINE_JIT: {
+                result = jit_run(device->jit, device->chip_8, budget - i, &executed);
+                break;
+            }
+            case ENGINE_AOT: {
+                result = aot_run(device->chip_8, budget - i, &executed);
+                break;
+            }
+            default: {
+                run_result_t run;
+                chip8_run(device->chip_8, budget - i, &run);
+                if (run.stop == RUN_WAIT) { // nothing to do until a key is pressed
+                    *used = budget;
+                    return EXEC_SUCCESS;
+                }
+                result = run.result;
+                executed = run.executed;
+            }
+        }
+    }
+    *used = i;
+    return result;
+}
+
+static void device_report(device_t *device)
+{
+    fprintf(stderr, "%s at %03X, emulation halted until restart\n",
+        exec_errors[device->error], device->chip_8->PC);
+}
+
+exec_res_t device_run(device_t *device, uint32_t frames, uint64_t instructions)
+{
+    uint64_t total = 0;
+    uint32_t frame = 0;
+    uint32_t used = 0;
+    clock_t start = clock();
+
+    while ((frames == 0 || frame < frames) && (instructions == 0 || total < instructions)) {
+        if (used == 0) { // a virtual 60 Hz frame starts every ipf instructions
+            device_movie(device);
+            chip8_tick(device->chip_8);
+            device->frame++;
+            frame++;
+        }
+        uint32_t budget = device->ipf - used;
+        if (instructions > 0 && instructions - total < budget) {
+            budget = instructions - total;
+        }
+        if (budget == 0 && frames == 0 && !device->playing) { // no frame limit, and no movie to raise the IPF again
+            fprintf(stderr, "IPF of 0, nothing left to run\n");
+            break;
+        }
+        uint32_t executed;
+        device->error = device_execute(device, budget, &executed);
+        total += executed;
+        device->instructions += executed;
+        used += executed;
+        if (used >= device->ipf) used = 0;
+        if (device->error != EXEC_SUCCESS) {
+            device_report(device);
+            break;
+        }
+        device->chip_8->RF = 0;
+    }
+
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("%u frames, %llu instructions in %.3f s (%.1f MIPS)\n", frame, (unsigned long long)total,
+        seconds, seconds > 0 ? total / seconds / 1e6 : 0.0);
+    return device->error;
+}
+
+// an input event, on the emulation side; going back in time or changing the speed would break a movie
+static void device_control(device_t *device, input_event_t ie)
+{
     switch (ie) {
-        case IE_HALT: device->running = 0; break;
         case IE_RESTART: device_start(device); break;
-        case IE_INC_ISP: device->ipf++; break;
-        case IE_DEC_ISP: device->ipf -= (device->ipf > 0) ? 1 : 0; break;
+        case IE_INC_ISP: device->ipf += !device->playing; break;
+        case IE_DEC_ISP: device->ipf -= (device->ipf > 0 && !device->playing) ? 1 : 0; break;
+        case IE_SAVE: device_save(device); break;
+        case IE_LOAD: if (device->movie == NULL) device_load(device); break;
+        case IE_REWIND: device->rewinding = device->rewind != NULL && device->movie == NULL; break;
+        case IE_REWIND_STOP: device->rewinding = 0; break;
+        default: break;
     }
+}
 
-    int ms = (device->frames % 3 == 0) ? 16 : 17;
-#ifndef __EMSCRIPTEN__
-    if (ticks - device->t60 >= ms) { // ~60 Hz
-#endif
-        chip8_tick(device->chip_8);
+// the keys held, unless a played movie owns them
+static void device_keys(device_t *device, uint16_t keys)
+{
+    if (device->playing) {
+        return;
+    }
+    for (int i = 0; i < 16; i++) {
+        device->chip_8->KEYBOARD[i] = keys >> i & 1;
+    }
+}
+
+static uint16_t device_keys_held(device_t *device)
+{
+    uint16_t keys = 0;
+    for (int i = 0; i < 16; i++) {
+        keys |= (device->keys[i] != 0) << i;
+    }
+    return keys;
+}
 
-        for (int i = 0; i < device->ipf; i++) {
-            chip8_cycle(device->chip_8);
+// one 60 Hz frame: a frame back while rewinding, otherwise the timers and the instructions of a frame
+static void device_frame(device_t *device)
+{
+    if (device->rewinding) {
+        uint8_t keyboard[16];
+        memcpy(keyboard, device->chip_8->KEYBOARD, sizeof(keyboard));
+        if (rewind_pop(device->rewind, device->chip_8)) { // one frame back
+            device_restored(device, keyboard);
         }
+        return;
+    }
+    if (device->playing && device->frame == device->movie->frames) { // live input from here on
+        device_verify(device);
+    }
+    device_movie(device);
+    chip8_tick(device->chip_8);
+    device->frame++;
 
-        if (device->chip_8->RF) {
-            display_render(device->display, (uint8_t *)device->chip_8->SCREEN, SCREEN_WIDTH, SCREEN_HEIGHT, 10);
-            device->chip_8->RF = 0;
+    if (device->error == EXEC_SUCCESS) {
+        uint32_t executed;
+        device->error = device_execute(device, device->ipf, &executed);
+        device->instructions += executed;
+        if (device->error != EXEC_SUCCESS) {
+            device_report(device);
         }
-        if (device->chip_8->ST) {
-            beeper_beep(device->beeper);
-        } else {
-            beeper_mute(device->beeper);
+    }
+    if (device->rewind) rewind_push(device->rewind, device->chip_8);
+}
+
+// hand the frame over to the main loop: the screen, with only the rows changed since the last frame composed
+static void device_publish(device_t *device)
+{
+    chip8_t *c8 = device->chip_8;
+    frame_t *frame = frames_back(device->finished);
+    frame->rows = 0;
+    if (c8->RF) {
+        chip8_screen_rows(c8, (uint8_t *)device->screen, c8->DIRTY);
+        frame->rows = c8->DIRTY;
+        c8->RF = 0;
+        c8->DIRTY = 0;
+    }
+    frame->width = chip8_width(c8);
+    frame->height = chip8_height(c8);
+    memcpy(frame->screen, device->screen, frame->width * frame->height);
+    frame->sound = c8->ST > 0;
+    frame->audio = c8->AUDIO;
+    memcpy(frame->pattern, c8->PATTERN, sizeof(frame->pattern));
+    frame->pitch = c8->PITCH;
+    frame->instructions = device->instructions;
+    frames_publish(device->finished);
+}
+
+// show the newest finished frame and play its sound; returns 0 if there was none
+static int device_present(device_t *device)
+{
+    frame_t *frame = frames_latest(device->finished);
+    if (frame == NULL) {
+        return 0;
+    }
+    // scaled to the window by the renderer, 64x32 pixels of 10 or 128x64 pixels of 5; with phosphor persistence
+    // every frame fades the glow, whether rows changed or not
+    display_render(device->display, frame->screen, frame->width, frame->height, frame->rows);
+    beeper_pattern(device->beeper, frame->audio ? frame->pattern : NULL, frame->pitch);
+    if (frame->sound) {
+        beeper_beep(device->beeper);
+    } else {
+        beeper_mute(device->beeper);
+    }
+    device->instructions_shown = frame->instructions;
+    device->frames++;
+    return 1;
+}
+
+// wait until the performance counter reaches the deadline: asleep while milliseconds are left, then yielding
+static void device_wait(uint64_t deadline)
+{
+    uint64_t frequency = SDL_GetPerformanceFrequency();
+    for (uint64_t now = SDL_GetPerformanceCounter(); now < deadline; now = SDL_GetPerformanceCounter()) {
+        uint64_t ms = (deadline - now) * 1000 / frequency;
+        SDL_Delay(ms > 1 ? ms - 1 : 0);
+    }
+}
+
+// the emulation thread: input from the queue, a frame, and the frame to the main loop, at exactly 60 Hz
+static int device_thread(void *data)
+{
+    device_t *device = data;
+    uint64_t frequency = SDL_GetPerformanceFrequency();
+    uint64_t start = SDL_GetPerformanceCounter();
+    uint64_t frames = 0;
+    while (SDL_AtomicGet(&device->emulating)) {
+        input_message_t message;
+        while (input_pop(&device->input, &message)) {
+            device_keys(device, message.keys);
+            device_control(device, message.event);
         }
+        device_frame(device);
+        device_publish(device);
 
-        device->frames++;
+        // frame n is due at start + n / 60 s; after falling far behind, the pace starts over instead of catching up
+        uint64_t deadline = start + ++frames * frequency / 60;
+        uint64_t now = SDL_GetPerformanceCounter();
+        if (now > deadline + frequency / 10) {
+            start = now;
+            frames = 0;
+            continue;
+        }
+        device_wait(deadline);
+    }
+    return 0;
+}
+
+void device_launch(device_t *device)
+{
 #ifndef __EMSCRIPTEN__
-        device->t60 = SDL_GetTicks();
-        SDL_Delay(10);
+    SDL_AtomicSet(&device->emulating, 1);
+    device->thread = SDL_CreateThread(device_thread, "emulation", device);
+    if (device->thread == NULL) { // the main loop emulates
+        SDL_AtomicSet(&device->emulating, 0);
+    }
+#endif
+}
+
+#ifdef __EMSCRIPTEN__
+void device_iterate(void *_device) {
+    device_t *device = _device;
+#else
+void device_iterate(device_t *device) {
+#endif
+    int ticks = SDL_GetTicks();
+    input_event_t ie = intput_handle(device->keys);
+    if (ie == IE_HALT) {
+        device->running = 0;
     }
+
+    if (device->thread) { // only input and presenting here
+        uint16_t keys = device_keys_held(device);
+        if ((ie != IE_NONE || keys != device->keys_sent) && input_push(&device->input, (input_message_t){ ie, keys })) {
+            device->keys_sent = keys;
+        }
+        if (!device_present(device)) {
+            SDL_Delay(1);
+        }
+    } else {
+        device_keys(device, device_keys_held(device));
+        device_control(device, ie);
+        int ms = (device->frames % 3 == 0) ? 16 : 17;
+#ifndef __EMSCRIPTEN__
+        if (ticks - device->t60 >= ms) { // ~60 Hz
 #endif
+            device_frame(device);
+            device_publish(device);
+            device_present(device);
+#ifndef __EMSCRIPTEN__
+            device->t60 = SDL_GetTicks();
+            SDL_Delay(10);
+        }
+#endif
+    }
 
     if (ticks - device->t1 >= 1000) { // 1 Hz
         char buffer[TITLE_LENGTH];
-        snprintf(buffer, TITLE_LENGTH, "CHIP-8 Emulator (%d FPS; %d IPS) - %s", device->frames, device->ipf * device->frames, device->rom_path);
+        snprintf(buffer, TITLE_LENGTH, "CHIP-8 Emulator (%d FPS; %llu IPS) - %s", device->frames,
+            (unsigned long long)(device->instructions_shown - device->title_instructions), device->rom_path);
         display_title_set(device->display, buffer);
+        device->title_instructions = device->instructions_shown;
         device->t1 = SDL_GetTicks();
         device->frames = 0;
     }
@@ -1,14 +1,42 @@
 #include <stdlib.h>
+#include <string.h>
 #include "include/display.h"
 
-display_t *display_create(char* title, int width, int height, uint32_t bg_color, uint32_t fg_color)
+// the color of a palette entry in RGB: the color itself, or with phosphor persistence the color of its top bits at
+// the brightness of the others, mixed with the background
+static uint32_t display_color(const uint32_t colors[COLORS], int entry, int phosphor)
+{
+    if (!phosphor) {
+        return colors[entry & (COLORS - 1)];
+    }
+    uint32_t bg = colors[0], fg = colors[entry >> GLOW_SHIFT];
+    int level = entry & GLOW_FULL;
+    uint32_t rgb = 0;
+    for (int shift = 0; shift < 24; shift += 8) {
+        int from = bg >> shift & 0xFF, to = fg >> shift & 0xFF;
+        rgb |= (uint32_t)(from + (to - from) * level / GLOW_FULL) << shift;
+    }
+    return rgb;
+}
+
+display_t *display_create(char* title, int width, int height, const uint32_t colors[COLORS], uint8_t decay)
 {
     SDL_Window *window = SDL_CreateWindow(title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, SDL_WINDOW_SHOWN);
     if (window == NULL) {
         return NULL;
     }
-    SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE | SDL_RENDERER_PRESENTVSYNC);
-    if (renderer == NULL) {
+    SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    SDL_Surface *surface = NULL;
+    if (renderer == NULL) { // no GPU, the screen is scaled straight into the window
+        surface = SDL_GetWindowSurface(window);
+        if (surface != NULL && surface->format->BytesPerPixel != 4) {
+            surface = NULL;
+        }
+    }
+    if (renderer == NULL && surface == NULL) { // SDL scales the texture in software
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE | SDL_RENDERER_PRESENTVSYNC);
+    }
+    if (renderer == NULL && surface == NULL) {
         SDL_DestroyWindow(window);
         return NULL;
     }
@@ -16,36 +44,105 @@ display_t *display_create(char* title, int width, int height, uint32_t bg_color,
     display_t *display = malloc(sizeof(display_t));
     display->window = window;
     display->renderer = renderer;
-    display->bg_color = (color_t) {
-        .R = bg_color >> 16,
-        .G = (bg_color & 0x00FF00) >> 8,
-        .B = bg_color & 0x0000FF,
-    };
-    display->fg_color = (color_t) {
-        .R = fg_color >> 16,
-        .G = (fg_color & 0x00FF00) >> 8,
-        .B = fg_color & 0x0000FF,
-    };
+    display->texture = NULL;
+    display->surface = surface;
+    display->screen_width = display->screen_height = 0;
+    display->decay = decay;
+    memset(display->glow, 0, sizeof(display->glow));
+    for (int i = 0; i < SCALE_PALETTE; i++) {
+        uint32_t rgb = display_color(colors, i, decay != 0);
+        display->palette[i] = surface ? SDL_MapRGB(surface->format, rgb >> 16 & 0xFF, rgb >> 8 & 0xFF, rgb & 0xFF)
+            : 0xFF000000 | (rgb & 0xFFFFFF);
+    }
     return display;
 }
 
-void display_render(display_t *display, uint8_t *screen_buffer, int width, int height, int pixel_size)
+// a texture of the size of the screen, made again when the resolution changes; is it new?
+static int display_texture(display_t *display, int width, int height)
+{
+    if (display->texture && display->screen_width == width && display->screen_height == height) {
+        return 0;
+    }
+    if (display->texture) SDL_DestroyTexture(display->texture);
+    display->texture = SDL_CreateTexture(display->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+        width, height);
+    display->screen_width = width;
+    display->screen_height = height;
+    return 1;
+}
+
+// expand the rows from first to last into the texture; locked pixels start undefined, so all of them are written
+static void display_update(display_t *display, uint8_t *screen_buffer, int width, int first, int last)
 {
-    SDL_Rect rect;
-    uint8_t pixel_set;
-    color_t *color;
+    SDL_Rect rect = { 0, first, width, last - first + 1 };
+    void *pixels;
+    int pitch;
+    if (SDL_LockTexture(display->texture, &rect, &pixels, &pitch) != 0) {
+        return;
+    }
+    // the screen buffer is row by row, a color index per pixel
+    scale_rows(pixels, pitch, &screen_buffer[first * width], width, rect.h, 1, display->palette);
+    SDL_UnlockTexture(display->texture);
+}
 
-    for (int x = 0; x < width; x++) {
-        for (int y = 0; y < height; y++) {
-            rect.x = x * pixel_size;
-            rect.y = y * pixel_size ;
-            rect.w = rect.h = pixel_size;
-            pixel_set = *((screen_buffer + x * height) + y);
-            color = (pixel_set) ? &display->fg_color : &display->bg_color;
-            SDL_SetRenderDrawColor(display->renderer, color->R, color->G, color->B, 255);
-            SDL_RenderFillRect(display->renderer, &rect);
+// scale the changed rows into the window surface at the largest integer scale that fits, centered
+static void display_blit(display_t *display, uint8_t *screen_buffer, int width, int height, uint64_t rows)
+{
+    SDL_Surface *surface = display->surface;
+    int scale = surface->w / width < surface->h / height ? surface->w / width : surface->h / height;
+    if (scale == 0) {
+        return;
+    }
+    if (display->screen_width != width || display->screen_height != height) { // new borders around it
+        SDL_FillRect(surface, NULL, display->palette[0]);
+        display->screen_width = width;
+        display->screen_height = height;
+        rows = ~0ULL;
+    }
+    // a rect per run of changed rows, at most every other one of 64
+    SDL_Rect rects[32];
+    int count = 0;
+    int left = (surface->w - width * scale) / 2, top = (surface->h - height * scale) / 2;
+    if (SDL_MUSTLOCK(surface)) SDL_LockSurface(surface);
+    for (int y = 0; y < height; y++) {
+        if (!(rows >> y & 1)) continue;
+        int first = y;
+        while (y + 1 < height && (rows >> (y + 1) & 1)) y++;
+        uint8_t *pixels = (uint8_t *)surface->pixels + (size_t)(top + first * scale) * surface->pitch + left * 4;
+        scale_rows(pixels, surface->pitch, &screen_buffer[first * width], width, y - first + 1, scale, display->palette);
+        rects[count++] = (SDL_Rect){ left, top + first * scale, width * scale, (y - first + 1) * scale };
+    }
+    if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
+    SDL_UpdateWindowSurfaceRects(display->window, rects, count);
+}
+
+void display_render(display_t *display, uint8_t *screen_buffer, int width, int height, uint64_t rows)
+{
+    if (display->decay) { // the glow is drawn instead, it changes while pixels fade out
+        if (display->screen_width != width || display->screen_height != height) {
+            memset(display->glow, 0, sizeof(display->glow));
         }
+        rows = scale_phosphor(display->glow, screen_buffer, width, height, display->decay);
+        screen_buffer = display->glow;
+    }
+    if (display->surface) {
+        display_blit(display, screen_buffer, width, height, rows);
+        return;
+    }
+    if (display_texture(display, width, height)) {
+        rows = ~0ULL;
+    }
+    if (display->texture == NULL || rows == 0) {
+        return;
+    }
+    // a texture update for each run of changed rows
+    for (int y = 0; y < height; y++) {
+        if (!(rows >> y & 1)) continue;
+        int first = y;
+        while (y + 1 < height && (rows >> (y + 1) & 1)) y++;
+        display_update(display, screen_buffer, width, first, y);
     }
+    SDL_RenderCopy(display->renderer, display->texture, NULL, NULL);
     SDL_RenderPresent(display->renderer);
 }
 
@@ -56,7 +153,8 @@ void display_title_set(display_t* display, char* title)
 
 void display_destroy(display_t **display)
 {
-    SDL_DestroyRenderer((*display)->renderer);
+    if ((*display)->texture) SDL_DestroyTexture((*display)->texture);
+    if ((*display)->renderer) SDL_DestroyRenderer((*display)->renderer);
     SDL_DestroyWindow((*display)->window);
     free(*display);
     *display = NULL;
@@ -0,0 +1,55 @@
+#include <stdlib.h>
+
+#include "include/frames.h"
+
+frames_t *frames_create()
+{
+    frames_t *frames = calloc(1, sizeof(frames_t));
+    if (frames == NULL) {
+        return NULL;
+    }
+    frames->back = 0;
+    SDL_AtomicSet(&frames->finished, 1);
+    frames->front = 2;
+    return frames;
+}
+
+void frames_destroy(frames_t **frames)
+{
+    free(*frames);
+    *frames = NULL;
+}
+
+// the slot the emulation fills next, with the rows it changed
+frame_t *frames_back(frames_t *frames)
+{
+    return &frames->slots[frames->back];
+}
+
+// hand the filled slot over as the finished frame and take back the previous one; a frame the main thread
+// skipped passes its rows on, so that the one it takes next redraws them too
+void frames_publish(frames_t *frames)
+{
+    frame_t *frame = &frames->slots[frames->back];
+    uint64_t rows = frame->rows;
+    frame->rows |= frames->carry;
+    // the frame is written before its slot is published, and the slot taken back is read by the main thread before
+    // it is written again; SDL_AtomicSet alone is only an acquire barrier
+    SDL_MemoryBarrierRelease();
+    int previous = SDL_AtomicSet(&frames->finished, frames->back | FRAME_FRESH);
+    SDL_MemoryBarrierAcquire();
+    frames->carry = (previous & FRAME_FRESH) ? frame->rows : rows;
+    frames->back = previous & (FRAME_FRESH - 1);
+}
+
+// the newest finished frame, or NULL if none was finished since the last call
+frame_t *frames_latest(frames_t *frames)
+{
+    if (!(SDL_AtomicGet(&frames->finished) & FRAME_FRESH)) {
+        return NULL;
+    }
+    SDL_MemoryBarrierRelease();
+    frames->front = SDL_AtomicSet(&frames->finished, frames->front) & (FRAME_FRESH - 1);
+    SDL_MemoryBarrierAcquire();
+    return &frames->slots[frames->front];
+}
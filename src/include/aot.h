@@ -0,0 +1,12 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include <stdint.h>
+#include "chip8.h"
+
+// ROM recompiled into the binary by `make recompile`, NULL if none
+extern const char *aot_rom;
+
+exec_res_t aot_run(chip8_t *c8, uint32_t count, uint32_t *executed);
+
+#endif
@@ -7,6 +7,13 @@
 #define TONE 440
 #define BG_COLOR 0x000000
 #define FG_COLOR 0x00FF00
+#define PLANE2_COLOR 0xFF8000
+#define BOTH_COLOR 0xFFFF00
+#ifndef ENGINE
+#define ENGINE ENGINE_SWITCH
+#endif
+
+typedef enum engine_t { ENGINE_SWITCH, ENGINE_THREADED, ENGINE_BLOCK, ENGINE_JIT, ENGINE_AOT } engine_t;
 
 typedef struct args_t {
     char *rom_path;
@@ -14,6 +21,18 @@ typedef struct args_t {
     uint16_t tone;
     uint32_t bg_color;
     uint32_t fg_color;
+    uint32_t plane2_color;
+    uint32_t both_color;
+    uint8_t phosphor;
+    engine_t engine;
+    uint8_t headless;
+    uint32_t frames;
+    uint64_t instructions;
+    uint64_t seed;
+    uint8_t profile;
+    char *record_path;
+    char *play_path;
+    char *profiler_path;
 } args_t;
 
 args_t parse_args(int argc, char *argv[]);
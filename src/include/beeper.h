@@ -6,6 +6,8 @@
 
 #define SAMPLE_FREQ 44100
 #define SAMPLES 2048
+// bits of an XO-CHIP audio pattern, played as a loop of 1-bit samples
+#define PATTERN_BITS 128
 
 typedef enum beeper_state_t { BEEPING, MUTED } beeper_state_t;
 
@@ -15,11 +17,20 @@ typedef struct beeper_t {
     unsigned int period;
     unsigned int half_period;
     unsigned int nth_chunk;
+    // XO-CHIP audio pattern in use instead of the tone, its bits expanded to samples
+    uint8_t custom;
+    uint8_t pattern[PATTERN_BITS / 8];
+    uint8_t pitch;
+    int16_t samples[PATTERN_BITS];
+    // position in the pattern and its advance per output sample, 16.16 fixed point
+    uint32_t phase;
+    uint32_t step;
 } beeper_t;
 
 beeper_t *beeper_create(uint16_t tone);
 void beeper_destroy(beeper_t **beeper);
 void beeper_beep(beeper_t *beeper);
 void beeper_mute(beeper_t *beeper);
+void beeper_pattern(beeper_t *beeper, const uint8_t *pattern, uint8_t pitch);
 
 #endif
@@ -0,0 +1,54 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <stdint.h>
+#include "chip8.h"
+
+#define BLOCK_COUNT 2048
+#define BLOCK_OPS 16384
+#define BLOCK_LENGTH 64
+
+// micro-op closing every translated block
+#define OC_BLOCK_END OC_COUNT
+
+typedef struct block_t {
+    // guest address of the first instruction
+    uint16_t start;
+    // guest address after the last instruction
+    uint16_t end;
+    // number of instructions
+    uint16_t length;
+    // index of the first micro-op
+    uint16_t op;
+    // exit addresses: fall-through or static target, taken skip
+    uint16_t exit[2];
+    // successors chained to the exits
+    struct block_t *next[2];
+    // is the translation up to date?
+    uint8_t valid;
+    // times entered, and host code compiled by the JIT
+    uint16_t hits;
+    void *native;
+} block_t;
+
+typedef struct block_cache_t {
+    // block starting at each RAM address
+    block_t *map[RAM_SIZE];
+    // block pool
+    block_t blocks[BLOCK_COUNT];
+    uint16_t block_count;
+    // micro-op arena
+    instruction_t ops[BLOCK_OPS];
+    uint16_t op_count;
+    // code write generation seen at the last sync
+    uint32_t gen;
+} block_cache_t;
+
+block_cache_t *block_cache_create();
+void block_cache_destroy(block_cache_t **bc);
+void block_cache_flush(block_cache_t *bc);
+block_t *block_translate(block_cache_t *bc, chip8_t *c8, uint16_t address);
+void block_sync(block_cache_t *bc, chip8_t *c8);
+exec_res_t block_run(block_cache_t *bc, chip8_t *c8, uint32_t count, uint32_t *executed);
+
+#endif
@@ -4,7 +4,10 @@
 #include <stdint.h>
 #include <stdio.h>
 
+// address space of the code, and of the data of every profile but XO-CHIP
 #define RAM_SIZE 4096
+// XO-CHIP address space of the data
+#define XO_RAM_SIZE 0x10000
 #define STACK_SIZE 16
 
 #define START_ADDRESS 0x200
@@ -12,12 +15,90 @@
 #define SCREEN_WIDTH 64
 #define SCREEN_HEIGHT 32
 
+// SUPER-CHIP high resolution mode
+#define HIRES_WIDTH 128
+#define HIRES_HEIGHT 64
+
 #define FONTSET_ADDRESS 0x100
 #define FONT_OFFSET 5
 
+// SUPER-CHIP 8x10 digits, right after the small ones
+#define BIG_FONTSET_ADDRESS 0x150
+#define BIG_FONT_OFFSET 10
+
+// SUPER-CHIP persistent user flags of FX75 and FX85
+#define RPL_SIZE 16
+
+// XO-CHIP bit-planes of the screen and bytes of the 1-bit audio pattern
+#define PLANES 2
+#define PATTERN_SIZE 16
+
+// every row of the screen in DIRTY
+#define ALL_ROWS (~0ULL)
+
+typedef enum opclass_t {
+    OC_UNKNOWN, OC_NOP, OC_CLS, OC_RET, OC_JP, OC_CALL, OC_SE_VX_NN, OC_SNE_VX_NN, OC_SE_VX_VY, OC_LD_VX_NN,
+    OC_ADD_VX_NN, OC_LD_VX_VY, OC_OR, OC_AND, OC_XOR, OC_ADD_VX_VY, OC_SUB, OC_SHR, OC_SUBN, OC_SHL, OC_SNE_VX_VY,
+    OC_LD_I, OC_JP_V0, OC_RND, OC_DRW, OC_SKP, OC_SKNP, OC_LD_VX_DT, OC_LD_VX_K, OC_LD_DT_VX, OC_LD_ST_VX,
+    OC_ADD_I_VX, OC_LD_F_VX, OC_LD_B_VX, OC_LD_I_VX, OC_LD_VX_I,
+    // SUPER-CHIP scrolling, resolution, big font and user flags
+    OC_SCD, OC_SCR, OC_SCL, OC_LOW, OC_HIGH, OC_LD_HF_VX, OC_LD_R_VX, OC_LD_VX_R,
+    // XO-CHIP register ranges, long loads, planes and audio
+    OC_SAVE, OC_LOAD, OC_LD_I_LONG, OC_PLANE, OC_AUDIO, OC_PITCH,
+    // variants of the opclasses above for the quirks of other profiles, see chip8_specialize
+    OC_OR_KEEP, OC_AND_KEEP, OC_XOR_KEEP, OC_SHR_VX, OC_SHL_VX, OC_LD_VX_I_X, OC_LD_VX_I_KEEP, OC_JP_VX,
+    OC_SKIP_LONG, OC_COUNT
+} opclass_t;
+
+// behaviours that differ between the CHIP-8 implementations
+#define QUIRK_VF_RESET 0x01 // 8XY1, 8XY2 and 8XY3 clear VF
+#define QUIRK_SHIFT_VY 0x02 // 8XY6 and 8XYE shift VY into VX, not VX in place
+#define QUIRK_INDEX_X1 0x04 // FX55 and FX65 leave I at I + X + 1
+#define QUIRK_INDEX_X 0x08  // FX55 and FX65 leave I at I + X; with neither I stays
+#define QUIRK_CLIP 0x10     // DXYN clips sprites at the screen edges instead of wrapping them
+#define QUIRK_JUMP_VX 0x20  // BXNN jumps to XNN + VX, not to NNN + V0
+#define QUIRK_LONG 0x40     // I wraps around at XO_RAM_SIZE and skips step over the 4 bytes of F000 NNNN
+#define QUIRK_SCHIP 0x80    // the SUPER-CHIP 00CN, 00FB-00FF, DXY0, FX30, FX75 and FX85 are known
+#define QUIRK_XOCHIP 0x100  // the XO-CHIP 5XY2, 5XY3, F000 NNNN, FN01, F002 and FX3A are known
+
+typedef enum profile_t { PROFILE_VIP, PROFILE_CHIP48, PROFILE_SCHIP, PROFILE_XOCHIP, PROFILE_COUNT } profile_t;
+
+// command line names of the profiles
+extern const char *const profile_names[PROFILE_COUNT];
+
+// quirks of a profile, a constant expression for constant profiles
+#define PROFILE_QUIRKS(p) \
+    ((p) == PROFILE_VIP ? QUIRK_VF_RESET | QUIRK_SHIFT_VY | QUIRK_INDEX_X1 | QUIRK_CLIP : \
+     (p) == PROFILE_CHIP48 ? QUIRK_INDEX_X | QUIRK_CLIP | QUIRK_JUMP_VX : \
+     (p) == PROFILE_SCHIP ? QUIRK_CLIP | QUIRK_JUMP_VX | QUIRK_SCHIP : \
+     QUIRK_SHIFT_VY | QUIRK_INDEX_X1 | QUIRK_LONG | QUIRK_SCHIP | QUIRK_XOCHIP)
+
+typedef struct instruction_t {
+    uint16_t OP;    // opcode
+    uint8_t X;      // X index for V register
+    uint8_t Y;      // Y index for V register
+    uint8_t N;      // 4th nibble
+    uint8_t NN;     // 3rd and 4th nibble
+    uint16_t NNN;   // 2nd, 3rd and 4th nibble
+    uint8_t OC;     // opcode class
+} instruction_t;
+
 typedef struct chip8_t {
-    // RAM
-    uint8_t RAM[RAM_SIZE];
+    // RAM; code runs in the first RAM_SIZE bytes, XO-CHIP data may fill all of it
+    uint8_t RAM[XO_RAM_SIZE];
+    // I wraps around at RAM_SIZE, or at XO_RAM_SIZE with XO-CHIP
+    uint16_t RAM_MASK;
+    // predecoded instruction for every RAM address
+    instruction_t DECODED[RAM_SIZE];
+    // is the predecoded instruction up to date?
+    uint8_t DECODED_VALID[RAM_SIZE];
+    // RAM bytes covered by translated code
+    uint8_t CODE[RAM_SIZE];
+    // generation counter, bumped on every write into translated code
+    uint32_t CODE_GEN;
+    // lowest and highest translated address written since the last sync
+    uint16_t CODE_LO;
+    uint16_t CODE_HI;
     // V0-VF register
     uint8_t V[16];
     // index register
@@ -32,36 +113,73 @@ typedef struct chip8_t {
     uint8_t DT;
     // sound timer
     uint8_t ST;
-    // render flag
+    // render flag, and the rows of the screen changed since the last render, a bit each
     uint8_t RF;
-    // screen buffer
-    uint8_t SCREEN[SCREEN_WIDTH][SCREEN_HEIGHT];
+    uint64_t DIRTY;
+    // xorshift64* state of CXNN
+    uint64_t RNG;
+    // profile of the quirks
+    uint8_t PROFILE;
+    // screen buffer, for each bit-plane one row per pair of words with the leftmost pixel in the top bit
+    // of the first; low resolution only uses the first word of the top SCREEN_HEIGHT rows
+    uint64_t SCREEN[PLANES][HIRES_HEIGHT][2];
+    // bit-planes drawn, cleared and scrolled, a bit each
+    uint8_t PLANE;
+    // is the 128x64 mode on?
+    uint8_t HIRES;
+    // user flags of FX75 and FX85
+    uint8_t RPL[RPL_SIZE];
+    // XO-CHIP audio: 1-bit samples played while ST > 0, their pitch, and were they loaded by F002?
+    uint8_t PATTERN[PATTERN_SIZE];
+    uint8_t PITCH;
+    uint8_t AUDIO;
     // keyboard buffer
     uint8_t KEYBOARD[16];
+    // addresses chip8_run stops at
+    uint8_t BREAKPOINTS[RAM_SIZE];
+    // should chip8_run stop after DXYN?
+    uint8_t STOP_ON_DRAW;
+    // counters every executed instruction goes to, if any; only builds with CHIP8_PROFILER report to them, the
+    // field is there in every build to keep the layout the same for libchip8
+    struct profiler_t *PROFILER;
 } chip8_t;
 
-typedef struct instruction_t {
-    uint16_t OP;    // opcode
-    uint8_t X;      // X index for V register
-    uint8_t Y;      // Y index for V register
-    uint8_t N;      // 4th nibble
-    uint8_t NN;     // 3rd and 4th nibble
-    uint16_t NNN;   // 2nd, 3rd and 4th nibble
-} instruction_t;
-
 typedef enum exec_res_t { EXEC_SUCCESS, UNKNOWN_OPCODE, STACK_OVERFLOW, STACK_UNDERFLOW, PC_OVERFLOW } exec_res_t;
 
+typedef enum run_stop_t { RUN_BUDGET, RUN_ERROR, RUN_DRAW, RUN_WAIT, RUN_BREAKPOINT, RUN_IDLE } run_stop_t;
+
+typedef struct run_result_t {
+    // instructions executed
+    uint32_t executed;
+    // reason of returning
+    run_stop_t stop;
+    // result of the last instruction
+    exec_res_t result;
+} run_result_t;
+
 typedef enum rom_ld_t { ROM_LOAD_SUCCESS, ROM_NOT_EXISTS, ROM_TOO_LARGE } rom_ld_t;
 
 chip8_t *chip8_create();
 void chip8_destroy(chip8_t **c8);
 void chip8_reset(chip8_t *c8);
+void chip8_seed(chip8_t *c8, uint64_t seed);
+uint8_t chip8_random(chip8_t *c8);
+void chip8_profile(chip8_t *c8, profile_t profile);
+void chip8_specialize(instruction_t *inst, profile_t profile);
 void chip8_ramcpy(chip8_t *c8, uint8_t *bytes, uint8_t size);
 rom_ld_t chip8_load_rom(chip8_t *c8, FILE *f);
+void chip8_invalidate(chip8_t *c8, uint16_t address, uint16_t size);
 uint16_t chip8_fetch(chip8_t *c8);
 void chip8_decode(uint16_t opcode, instruction_t *inst);
 exec_res_t chip8_execute(chip8_t *c8, instruction_t *inst);
 exec_res_t chip8_cycle(chip8_t *c8);
+void chip8_run(chip8_t *c8, uint32_t max_instructions, run_result_t *run);
+uint32_t chip8_idle(chip8_t *c8, uint32_t budget);
 void chip8_tick(chip8_t *c8);
+int chip8_width(chip8_t *c8);
+int chip8_height(chip8_t *c8);
+uint8_t chip8_pixel(chip8_t *c8, int x, int y);
+void chip8_screen_bytes(chip8_t *c8, uint8_t *bytes);
+void chip8_screen_rows(chip8_t *c8, uint8_t *bytes, uint64_t rows);
 
 #endif
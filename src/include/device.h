@@ -8,6 +8,13 @@
 #include "chip8.h"
 #include "display.h"
 #include "beeper.h"
+#include "block.h"
+#include "jit.h"
+#include "rewind.h"
+#include "movie.h"
+#include "profiler.h"
+#include "frames.h"
+#include "input.h"
 
 typedef struct device_t {
     // CHIP-8 interpreter
@@ -16,10 +23,49 @@ typedef struct device_t {
     display_t *display;
     // beeper
     beeper_t *beeper;
+    // byte per pixel view of the screen for rendering, row by row, with the planes as a color index
+    uint8_t screen[HIRES_HEIGHT][HIRES_WIDTH];
+    // emulation thread, running while emulating is set; NULL if the main loop emulates
+    SDL_Thread *thread;
+    SDL_atomic_t emulating;
+    // finished frames from the emulation to the main loop, and the input the other way
+    frames_t *finished;
+    input_queue_t input;
+    // keys held as the main loop sees them, and the ones last sent, a bit per key
+    uint8_t keys[16];
+    uint16_t keys_sent;
+    // translation cache of the block engine
+    block_cache_t *blocks;
+    // native code cache of the JIT engine
+    jit_t *jit;
+    // history of the frames for rewinding, and is it rewinding?
+    rewind_t *rewind;
+    uint8_t rewinding;
+    // movie being recorded or played, and its file path
+    movie_t *movie;
+    uint8_t playing;
+    char *movie_path;
+    // guest profiler and the path its reports are written to without extension
+    profiler_t *profiler;
+    char *profiler_path;
+    // frames and instructions run since the start, the movie's clock
+    uint32_t frame;
+    uint64_t instructions;
     // ROM file path
     char *rom_path;
     // instructions per frame
     uint16_t ipf;
+    // execution engine
+    engine_t engine;
+    // seed of the random numbers, the same on every restart
+    uint64_t seed;
+    // profile of the quirks
+    uint8_t profile;
+    // error that halted the emulation
+    exec_res_t error;
+    // instructions run up to the frame presented last, and up to the one a second ago, for the title
+    uint64_t instructions_shown;
+    uint64_t title_instructions;
     // ticks for 1 Hz timer
     uint32_t t1;
     // ticks for 60 Hz timer
@@ -32,7 +78,10 @@ typedef struct device_t {
 
 device_t *device_init(args_t *args);
 rom_ld_t device_start(device_t *device);
+void device_launch(device_t *device);
 void device_destroy(device_t **device);
+exec_res_t device_run(device_t *device, uint32_t frames, uint64_t instructions);
+int device_verify(device_t *device);
 #ifdef __EMSCRIPTEN__
 void device_iterate(void *_device);
 #else
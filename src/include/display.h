@@ -2,24 +2,35 @@
 #define DISPLAY_H
 
 #include <SDL2/SDL.h>
+#include "chip8.h"
+#include "scale.h"
 
 #define TITLE_LENGTH 256
-
-typedef struct color_t {
-    uint8_t R;
-    uint8_t G;
-    uint8_t B;
-} color_t;
+// colors of the background, plane 1, plane 2 and both planes
+#define COLORS 4
 
 typedef struct display_t {
     SDL_Window *window;
+    // GPU renderer, or the software one if the window surface has no 32-bit pixels
     SDL_Renderer *renderer;
-    color_t bg_color;
-    color_t fg_color;
+    // streaming texture the screen is expanded into, scaled to the window by the renderer
+    SDL_Texture *texture;
+    // without a GPU: window surface the screen is scaled into directly, NULL with a renderer
+    SDL_Surface *surface;
+    // size of the screen drawn last
+    int screen_width;
+    int screen_height;
+    // pixels of the texture or the surface for every screen byte: the colors, or with phosphor persistence every
+    // glow of them, faded towards the background
+    uint32_t palette[SCALE_PALETTE];
+    // brightness kept by an unlit pixel every frame, out of 256; 0 without phosphor persistence
+    uint8_t decay;
+    // phosphor glow of every pixel, row by row like the screen
+    uint8_t glow[HIRES_HEIGHT * HIRES_WIDTH];
 } display_t;
 
-display_t *display_create(char* title, int width, int height, uint32_t bg_color, uint32_t fg_color);
-void display_render(display_t *display, uint8_t *screen_buffer, int width, int height, int pixel_size);
+display_t *display_create(char* title, int width, int height, const uint32_t colors[COLORS], uint8_t decay);
+void display_render(display_t *display, uint8_t *screen_buffer, int width, int height, uint64_t rows);
 void display_title_set(display_t* display, char *title);
 void display_destroy(display_t **display);
 
@@ -0,0 +1,46 @@
+#ifndef FRAMES_H
+#define FRAMES_H
+
+#include <stdint.h>
+#include <SDL2/SDL.h>
+#include "chip8.h"
+
+// slots of the triple buffer: one written by the emulation, one shown, and the newest finished one between them
+#define FRAME_SLOTS 3
+// bit of the shared slot index telling that the finished frame is not taken yet
+#define FRAME_FRESH 4
+
+typedef struct frame_t {
+    // byte per pixel view of the screen, row by row with the planes as a color index, and its size
+    uint8_t screen[HIRES_HEIGHT * HIRES_WIDTH];
+    int width;
+    int height;
+    // rows changed since the last frame taken, a bit each
+    uint64_t rows;
+    // is the sound timer running, and the XO-CHIP audio pattern and its pitch if one is loaded
+    uint8_t sound;
+    uint8_t audio;
+    uint8_t pattern[PATTERN_SIZE];
+    uint8_t pitch;
+    // instructions run since the start
+    uint64_t instructions;
+} frame_t;
+
+typedef struct frames_t {
+    frame_t slots[FRAME_SLOTS];
+    // slot of the finished frame, with FRAME_FRESH until it is taken; swapped atomically by both sides
+    SDL_atomic_t finished;
+    // slots owned by the emulation and by the main thread
+    int back;
+    int front;
+    // rows of the frames finished since the main thread took one, the emulation's side
+    uint64_t carry;
+} frames_t;
+
+frames_t *frames_create();
+void frames_destroy(frames_t **frames);
+frame_t *frames_back(frames_t *frames);
+void frames_publish(frames_t *frames);
+frame_t *frames_latest(frames_t *frames);
+
+#endif
@@ -2,9 +2,31 @@
 #define INPUT_H
 
 #include <stdint.h>
+#include <SDL2/SDL.h>
 
-typedef enum input_event_t { IE_NONE, IE_HALT = 1, IE_RESTART = 2, IE_INC_ISP = 4, IE_DEC_ISP = 8 } input_event_t;
+// messages the input queue holds, a power of 2
+#define INPUT_QUEUE_SIZE 64
+
+typedef enum input_event_t { IE_NONE, IE_HALT = 1, IE_RESTART = 2, IE_INC_ISP = 4, IE_DEC_ISP = 8, IE_SAVE = 16, IE_LOAD = 32,
+    IE_REWIND = 64, IE_REWIND_STOP = 128 } input_event_t;
+
+typedef struct input_message_t {
+    // control event, and the keys held, a bit per key
+    input_event_t event;
+    uint16_t keys;
+} input_message_t;
+
+// single producer, single consumer ring of messages from the main thread to the emulation thread
+typedef struct input_queue_t {
+    input_message_t messages[INPUT_QUEUE_SIZE];
+    // messages pushed and popped so far, each written by one side only
+    SDL_atomic_t pushed;
+    SDL_atomic_t popped;
+} input_queue_t;
 
 input_event_t intput_handle(uint8_t *c8_keyboard);
+void input_queue_init(input_queue_t *queue);
+int input_push(input_queue_t *queue, input_message_t message);
+int input_pop(input_queue_t *queue, input_message_t *message);
 
 #endif
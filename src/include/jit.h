@@ -0,0 +1,28 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "chip8.h"
+#include "block.h"
+
+#define JIT_ARENA_SIZE (4 * 1024 * 1024)
+#define JIT_THRESHOLD 8
+
+typedef struct jit_t {
+    // translation cache the compiled blocks come from
+    block_cache_t *blocks;
+    // executable code arena
+    uint8_t *arena;
+    size_t size;
+    size_t used;
+    // RAM bytes the guest has overwritten as code
+    uint8_t smc[RAM_SIZE];
+} jit_t;
+
+jit_t *jit_create();
+void jit_destroy(jit_t **jit);
+void jit_flush(jit_t *jit);
+exec_res_t jit_run(jit_t *jit, chip8_t *c8, uint32_t count, uint32_t *executed);
+
+#endif
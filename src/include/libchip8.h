@@ -0,0 +1,31 @@
+#ifndef LIBCHIP8_H
+#define LIBCHIP8_H
+
+// libchip8: the emulator core without SDL, built by 'make lib'
+// every function works only on the instances passed to it, so separate
+// instances can run on separate threads without locking
+
+// bumped with every change of the layout of chip8_t or of the other public structs:
+// 2 CXNN generator per instance, 3 quirk profiles, 4 SUPER-CHIP screen, 5 XO-CHIP memory and planes,
+// 6 dirty rows, 7 snapshot sizes in rewind_t, 8 profiler pointer in every build
+#define LIBCHIP8_VERSION 8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "chip8.h"
+#include "threaded.h"
+#include "block.h"
+#include "jit.h"
+#include "lockstep.h"
+#include "snapshot.h"
+#include "rewind.h"
+#include "movie.h"
+#include "profiler.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <stdint.h>
+#include "chip8.h"
+
+#define LOCKSTEP_LANES 32
+
+typedef struct lockstep_t {
+    // instance run in each lane
+    chip8_t *lanes[LOCKSTEP_LANES];
+    uint8_t count;
+    // error that halted each lane, lanes with an error are skipped
+    exec_res_t result[LOCKSTEP_LANES];
+    // instructions each lane executed in the last run
+    uint32_t executed[LOCKSTEP_LANES];
+    // registers of the lanes as structure of arrays, valid during a run
+    uint8_t V[16][LOCKSTEP_LANES];
+    uint16_t I[LOCKSTEP_LANES];
+    uint16_t PC[LOCKSTEP_LANES];
+    uint8_t DT[LOCKSTEP_LANES];
+    uint8_t ST[LOCKSTEP_LANES];
+    // instructions executed by whole lane groups at once, and lane by lane
+    uint64_t vector_steps;
+    uint64_t scalar_steps;
+} lockstep_t;
+
+lockstep_t *lockstep_create();
+void lockstep_destroy(lockstep_t **ls);
+int lockstep_add(lockstep_t *ls, chip8_t *c8);
+void lockstep_run(lockstep_t *ls, uint32_t count);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "chip8.h"
+
+#define MOVIE_VERSION 3
+
+typedef struct movie_event_t {
+    // frame it applies from, and the instructions run before that frame
+    uint32_t frame;
+    uint64_t instructions;
+    // keys held, a bit per key, and instructions per frame
+    uint16_t keys;
+    uint16_t ipf;
+} movie_event_t;
+
+typedef struct movie_t {
+    // FNV-1a hash of the program memory after loading the ROM
+    uint64_t rom_hash;
+    // seed of the random numbers
+    uint64_t seed;
+    // profile of the quirks the run used
+    uint8_t profile;
+    // an event for every change of the keys or of the IPF
+    movie_event_t *events;
+    uint32_t count;
+    uint32_t capacity;
+    // next event to play
+    uint32_t next;
+    // frames, instructions and state hash at the end
+    uint32_t frames;
+    uint64_t instructions;
+    uint64_t state_hash;
+} movie_t;
+
+typedef enum movie_res_t {
+    MOVIE_SUCCESS, MOVIE_NOT_EXISTS, MOVIE_BAD_MAGIC, MOVIE_BAD_VERSION, MOVIE_TRUNCATED, MOVIE_WRITE_FAILED
+} movie_res_t;
+
+movie_t *movie_create(uint64_t rom_hash, uint64_t seed, uint8_t profile);
+void movie_destroy(movie_t **movie);
+void movie_record(movie_t *movie, uint32_t frame, uint64_t instructions, uint8_t *keyboard, uint16_t ipf);
+void movie_finish(movie_t *movie, uint32_t frame, uint64_t instructions, chip8_t *c8);
+int movie_play(movie_t *movie, uint32_t frame, uint64_t instructions, uint8_t *keyboard, uint16_t *ipf);
+int movie_verify(movie_t *movie, uint32_t frame, uint64_t instructions, chip8_t *c8);
+movie_res_t movie_write(movie_t *movie, FILE *f);
+movie_res_t movie_read(movie_t **movie, FILE *f);
+uint64_t movie_rom_hash(chip8_t *c8);
+uint64_t movie_state_hash(chip8_t *c8);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "chip8.h"
+
+// guest profiler: chip8_execute reports every instruction to it in builds with CHIP8_PROFILER,
+// other builds have no hook at all
+// heat map: a pixel per RAM address, a row per 64 of them
+#define HEATMAP_SIDE 64
+
+typedef struct profiler_frame_t {
+    // subroutine called and the instructions counted when it was entered
+    uint16_t address;
+    uint64_t start;
+    uint8_t valid;
+} profiler_frame_t;
+
+typedef struct profiler_t {
+    // instructions counted in all
+    uint64_t instructions;
+    // executions per opclass, specialized variants on their own
+    uint64_t opclasses[OC_COUNT];
+    // executions per guest PC
+    uint64_t addresses[RAM_SIZE];
+    // calls of the subroutine at each address, and the instructions run inside them up to their 00EE
+    uint64_t calls[RAM_SIZE];
+    uint64_t cycles[RAM_SIZE];
+    // subroutines entered, at the depth of the stack they were called from
+    profiler_frame_t frames[STACK_SIZE];
+} profiler_t;
+
+typedef enum profiler_res_t { PROFILER_SUCCESS, PROFILER_NOT_EXISTS, PROFILER_WRITE_FAILED } profiler_res_t;
+
+profiler_t *profiler_create();
+void profiler_destroy(profiler_t **profiler);
+void profiler_count(profiler_t *profiler, chip8_t *c8, instruction_t *inst);
+void profiler_idle(profiler_t *profiler, chip8_t *c8, uint16_t address, int length, uint32_t skipped);
+profiler_res_t profiler_write_csv(profiler_t *profiler, chip8_t *c8, FILE *f);
+profiler_res_t profiler_write_json(profiler_t *profiler, FILE *f);
+profiler_res_t profiler_write_heatmap(profiler_t *profiler, FILE *f);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stdint.h>
+#include "chip8.h"
+#include "snapshot.h"
+
+// default history: 4 MB of deltas, at most 10 minutes at 60 frames per second
+#define REWIND_BYTES (4 << 20)
+#define REWIND_FRAMES (60 * 60 * 10)
+
+typedef struct rewind_entry_t {
+    // where the delta starts in the ring, and its length
+    uint32_t offset;
+    uint32_t length;
+    // size of the snapshot it turns back into
+    uint32_t size;
+} rewind_entry_t;
+
+typedef struct rewind_t {
+    // ring of deltas: each one turns a state into the state captured before it
+    uint8_t *ring;
+    uint32_t size;
+    // where the next delta goes
+    uint32_t tail;
+    // deltas, oldest first
+    rewind_entry_t *entries;
+    uint32_t capacity;
+    uint32_t first;
+    uint32_t count;
+    // latest captured state in full and the capture buffer, in words to keep the copies aligned; zero past the
+    // snapshot in them, whose size depends on the profile
+    uint64_t states[2][(SNAPSHOT_SIZE + 7) / 8];
+    uint32_t sizes[2];
+    uint8_t newest;
+    uint8_t has_newest;
+} rewind_t;
+
+rewind_t *rewind_create(uint32_t bytes, uint32_t frames);
+void rewind_destroy(rewind_t **rw);
+void rewind_clear(rewind_t *rw);
+void rewind_push(rewind_t *rw, chip8_t *c8);
+int rewind_pop(rewind_t *rw, chip8_t *c8);
+uint32_t rewind_bytes(rewind_t *rw);
+
+#endif
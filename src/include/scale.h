@@ -0,0 +1,17 @@
+#ifndef SCALE_H
+#define SCALE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// pixels a screen byte can stand for
+#define SCALE_PALETTE 256
+// phosphor glow bytes: the color index in the top 2 bits, the brightness in the others
+#define GLOW_SHIFT 6
+#define GLOW_FULL ((1 << GLOW_SHIFT) - 1)
+
+void scale_rows(uint8_t *pixels, size_t pitch, const uint8_t *screen, int width, int rows, int scale,
+    const uint32_t palette[SCALE_PALETTE]);
+uint64_t scale_phosphor(uint8_t *glow, const uint8_t *screen, int width, int height, uint8_t decay);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "chip8.h"
+
+#define SNAPSHOT_VERSION 4
+
+// header: magic "CH8S", version, profile and a reserved byte, so that RAM and screen stay 8 byte aligned
+// all multi-byte values are little-endian
+#define SNAPSHOT_HEADER 8
+// everything after the RAM, which is as large as the profile can address
+#define SNAPSHOT_STATE (PLANES * HIRES_HEIGHT * 16 + 8 + 16 + STACK_SIZE * 2 + 2 + 2 + 1 + 1 + 1 + 1 + 2 + 1 + RPL_SIZE \
+    + 1 + PATTERN_SIZE + 1 + 1)
+// the largest snapshot, of a profile addressing XO_RAM_SIZE
+#define SNAPSHOT_SIZE (SNAPSHOT_HEADER + XO_RAM_SIZE + SNAPSHOT_STATE)
+
+typedef enum snapshot_res_t {
+    SNAPSHOT_SUCCESS, SNAPSHOT_NOT_EXISTS, SNAPSHOT_BAD_MAGIC, SNAPSHOT_BAD_VERSION, SNAPSHOT_TRUNCATED,
+    SNAPSHOT_WRITE_FAILED, SNAPSHOT_CORRUPT, SNAPSHOT_NO_MEMORY
+} snapshot_res_t;
+
+size_t chip8_snapshot_size(profile_t profile);
+size_t chip8_snapshot_save(chip8_t *c8, uint8_t *buffer);
+snapshot_res_t chip8_snapshot_load(chip8_t *c8, const uint8_t *buffer, size_t size);
+snapshot_res_t chip8_snapshot_write(chip8_t *c8, FILE *f);
+snapshot_res_t chip8_snapshot_read(chip8_t *c8, FILE *f);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef THREADED_H
+#define THREADED_H
+
+#include <stdint.h>
+#include "chip8.h"
+
+exec_res_t chip8_threaded_run(chip8_t *c8, uint32_t count, uint32_t *executed);
+
+#endif
@@ -48,6 +48,18 @@ input_event_t intput_handle(uint8_t *c8_keyboard)
                         input_event = event.type == SDL_KEYDOWN ? IE_RESTART : IE_NONE;
                         break;
                     }
+                    case SDLK_F5: {
+                        input_event = event.type == SDL_KEYDOWN ? IE_SAVE : IE_NONE;
+                        break;
+                    }
+                    case SDLK_F9: {
+                        input_event = event.type == SDL_KEYDOWN ? IE_LOAD : IE_NONE;
+                        break;
+                    }
+                    case SDLK_F8: { // held down to rewind
+                        input_event = event.type == SDL_KEYDOWN ? IE_REWIND : IE_REWIND_STOP;
+                        break;
+                    }
                     case SDLK_KP_PLUS: {
                         input_event = event.type == SDL_KEYDOWN ? IE_INC_ISP : IE_NONE;
                         break;
@@ -70,3 +82,40 @@ input_event_t intput_handle(uint8_t *c8_keyboard)
     }
     return input_event;
 }
+
+void input_queue_init(input_queue_t *queue)
+{
+    SDL_AtomicSet(&queue->pushed, 0);
+    SDL_AtomicSet(&queue->popped, 0);
+}
+
+// called by the main thread only; returns 0 if the queue is full
+int input_push(input_queue_t *queue, input_message_t message)
+{
+    int pushed = SDL_AtomicGet(&queue->pushed);
+    if (pushed - SDL_AtomicGet(&queue->popped) == INPUT_QUEUE_SIZE) {
+        return 0;
+    }
+    // the slot is written after the emulation thread is done reading it
+    SDL_MemoryBarrierAcquire();
+    queue->messages[pushed & (INPUT_QUEUE_SIZE - 1)] = message;
+    // the message is written before the count shows it; SDL_AtomicSet alone is only an acquire barrier
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&queue->pushed, pushed + 1);
+    return 1;
+}
+
+// called by the emulation thread only; returns 0 if the queue is empty
+int input_pop(input_queue_t *queue, input_message_t *message)
+{
+    int popped = SDL_AtomicGet(&queue->popped);
+    if (popped == SDL_AtomicGet(&queue->pushed)) {
+        return 0;
+    }
+    // the message is read after the count that shows it, and before the slot is given back
+    SDL_MemoryBarrierAcquire();
+    *message = queue->messages[popped & (INPUT_QUEUE_SIZE - 1)];
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&queue->popped, popped + 1);
+    return 1;
+}
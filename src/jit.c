@@ -0,0 +1,684 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "include/chip8.h"
+#include "include/block.h"
+#include "include/jit.h"
+
+// native code is only emitted for x86-64 hosts, anything else runs without a JIT
+#if defined(__x86_64__) || defined(_M_X64)
+#define JIT_X64
+#endif
+
+#ifdef JIT_X64
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// compiled block: returns the executed instruction count << 8 | exec_res_t
+typedef uint32_t (*jit_block_t)(chip8_t *c8);
+
+enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+// x86 condition codes
+enum { CC_B = 2, CC_AE = 3, CC_E = 4, CC_NE = 5 };
+
+// host registers that hold guest registers, all of them are spilled around calls
+static const int jit_pool[] = { RSI, RDI, RBP, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+#define JIT_POOL_SIZE (int)(sizeof(jit_pool) / sizeof(jit_pool[0]))
+#define JIT_FIELD(f) ((int32_t)offsetof(chip8_t, f))
+#define JIT_V(x) (JIT_FIELD(V) + (x))
+// stack slot holding CODE_GEN at block entry
+#define JIT_GEN_SLOT 32
+
+// shorthand for opcode byte strings
+#define BYTES(...) (const uint8_t[]){ __VA_ARGS__ }, sizeof((const uint8_t[]){ __VA_ARGS__ })
+
+typedef struct jit_ctx_t {
+    uint8_t *code;
+    size_t len;
+    size_t cap;
+    // host register caching each guest register, -1 if it lives in chip8_t
+    int host[16];
+    // guest registers the native code writes
+    uint16_t written;
+} jit_ctx_t;
+
+static void e8(jit_ctx_t *j, uint8_t b)
+{
+    if (j->len < j->cap) j->code[j->len] = b;
+    j->len++;
+}
+
+static void e16(jit_ctx_t *j, uint16_t v)
+{
+    e8(j, v);
+    e8(j, v >> 8);
+}
+
+static void e32(jit_ctx_t *j, uint32_t v)
+{
+    e16(j, v);
+    e16(j, v >> 16);
+}
+
+static void e64(jit_ctx_t *j, uint64_t v)
+{
+    e32(j, v);
+    e32(j, v >> 32);
+}
+
+static void emit_bytes(jit_ctx_t *j, const uint8_t *bytes, int count)
+{
+    for (int i = 0; i < count; i++) {
+        e8(j, bytes[i]);
+    }
+}
+
+/**
+ * emit an instruction with a ModRM operand: either the host register rm or,
+ * when rm is negative, [rbx + disp]. A REX prefix is always emitted so byte
+ * operands address sil, dil and bpl instead of the high byte registers.
+ */
+static void emit_rm(jit_ctx_t *j, int size, const uint8_t *op, int oplen, int reg, int rm, int32_t disp)
+{
+    if (size == 16) e8(j, 0x66);
+    e8(j, 0x40 | (size == 64 ? 8 : 0) | (reg & 8) >> 1 | (rm >= 0 ? (rm & 8) >> 3 : 0));
+    emit_bytes(j, op, oplen);
+    if (rm >= 0) {
+        e8(j, 0xC0 | (reg & 7) << 3 | (rm & 7));
+    } else {
+        e8(j, 0x80 | (reg & 7) << 3 | RBX);
+        e32(j, disp);
+    }
+}
+
+// same with guest register x as operand
+static void emit_v(jit_ctx_t *j, int size, const uint8_t *op, int oplen, int reg, int x)
+{
+    emit_rm(j, size, op, oplen, reg, j->host[x], JIT_V(x));
+}
+
+static void emit_load_v(jit_ctx_t *j, int reg, int x)
+{
+    emit_v(j, 8, BYTES(0x8A), reg, x);
+}
+
+static void emit_store_v(jit_ctx_t *j, int x, int reg)
+{
+    j->written |= 1 << x;
+    emit_v(j, 8, BYTES(0x88), reg, x);
+}
+
+static void emit_set_v(jit_ctx_t *j, int x, uint8_t imm)
+{
+    j->written |= 1 << x;
+    emit_v(j, 8, BYTES(0xC6), 0, x);
+    e8(j, imm);
+}
+
+static void emit_setcc(jit_ctx_t *j, int cc, int reg)
+{
+    emit_rm(j, 8, BYTES(0x0F, 0x90 | cc), 0, reg, 0);
+}
+
+static void emit_store_pc(jit_ctx_t *j, uint16_t pc)
+{
+    emit_rm(j, 16, BYTES(0xC7), 0, -1, JIT_FIELD(PC));
+    e16(j, pc);
+}
+
+// jcc rel32 to a label patched later
+static size_t emit_jcc(jit_ctx_t *j, int cc)
+{
+    e8(j, 0x0F);
+    e8(j, 0x80 | cc);
+    e32(j, 0);
+    return j->len - 4;
+}
+
+static void emit_label(jit_ctx_t *j, size_t at)
+{
+    if (at + 4 > j->cap) return;
+    uint32_t rel = j->len - (at + 4);
+    memcpy(&j->code[at], &rel, sizeof(rel));
+}
+
+// move guest registers between host registers and chip8_t
+static void emit_spill(jit_ctx_t *j)
+{
+    for (int x = 0; x < 16; x++) {
+        if (j->host[x] >= 0 && j->written & 1 << x) {
+            emit_rm(j, 8, BYTES(0x88), j->host[x], -1, JIT_V(x));
+        }
+    }
+}
+
+static void emit_reload(jit_ctx_t *j)
+{
+    for (int x = 0; x < 16; x++) {
+        if (j->host[x] >= 0) {
+            emit_rm(j, 8, BYTES(0x8A), j->host[x], -1, JIT_V(x));
+        }
+    }
+}
+
+static void emit_prologue(jit_ctx_t *j)
+{
+    // rbx, rbp, rsi, rdi, r12-r15 are callee saved on Windows, a superset of System V
+    emit_bytes(j, BYTES(0x53, 0x55, 0x56, 0x57, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57));
+    // shadow space, the CODE_GEN slot and 16 byte alignment
+    emit_bytes(j, BYTES(0x48, 0x83, 0xEC, 0x28));
+#ifdef _WIN32
+    emit_bytes(j, BYTES(0x48, 0x89, 0xCB)); // mov rbx, rcx
+#else
+    emit_bytes(j, BYTES(0x48, 0x89, 0xFB)); // mov rbx, rdi
+#endif
+    emit_rm(j, 32, BYTES(0x8B), RAX, -1, JIT_FIELD(CODE_GEN));
+    emit_bytes(j, BYTES(0x89, 0x44, 0x24, JIT_GEN_SLOT));
+    emit_reload(j);
+}
+
+// return eax to the caller
+static void emit_epilogue(jit_ctx_t *j)
+{
+    emit_bytes(j, BYTES(0x48, 0x83, 0xC4, 0x28));
+    emit_bytes(j, BYTES(0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5F, 0x5E, 0x5D, 0x5B, 0xC3));
+}
+
+static void emit_return(jit_ctx_t *j, uint32_t count, exec_res_t result)
+{
+    e8(j, 0xB8);
+    e32(j, count << 8 | result);
+    emit_epilogue(j);
+}
+
+// leave the block at the static address pc
+static void emit_exit(jit_ctx_t *j, uint32_t count, uint16_t pc)
+{
+    emit_spill(j);
+    emit_store_pc(j, pc);
+    emit_return(j, count, EXEC_SUCCESS);
+}
+
+// leave the block at address + 2 if the flag in dl is set, at address otherwise
+static void emit_skip(jit_ctx_t *j, uint32_t count, uint16_t address)
+{
+    emit_bytes(j, BYTES(0x0F, 0xB6, 0xD2)); // movzx edx, dl
+    emit_bytes(j, BYTES(0x8D, 0x04, 0x55)); // lea eax, [rdx * 2 + address]
+    e32(j, address);
+    emit_spill(j);
+    emit_rm(j, 16, BYTES(0x89), RAX, -1, JIT_FIELD(PC));
+    emit_return(j, count, EXEC_SUCCESS);
+}
+
+/**
+ * hand the instruction over to chip8_execute with every guest register in
+ * chip8_t. Errors, FX0A and writes into translated code leave the block.
+ */
+static int emit_generic(jit_ctx_t *j, instruction_t *op, uint32_t count, uint16_t address)
+{
+    emit_spill(j);
+    emit_store_pc(j, address);
+#ifdef _WIN32
+    emit_bytes(j, BYTES(0x48, 0x89, 0xD9, 0x48, 0xBA)); // mov rcx, rbx; mov rdx, op
+#else
+    emit_bytes(j, BYTES(0x48, 0x89, 0xDF, 0x48, 0xBE)); // mov rdi, rbx; mov rsi, op
+#endif
+    e64(j, (uintptr_t)op);
+    emit_bytes(j, BYTES(0x48, 0xB8)); // mov rax, chip8_execute
+    e64(j, (uintptr_t)&chip8_execute);
+    emit_bytes(j, BYTES(0xFF, 0xD0, 0x85, 0xC0)); // call rax; test eax, eax
+    size_t ok = emit_jcc(j, CC_E);
+    e8(j, 0x0D); // or eax, count << 8
+    e32(j, count << 8);
+    emit_epilogue(j);
+    emit_label(j, ok);
+
+    if (op->OC == OC_LD_VX_K || op->OC == OC_UNKNOWN || op->OC == OC_LD_I_LONG || op->OC == OC_SKIP_LONG) {
+        // PC is up to chip8_execute
+        emit_return(j, count, EXEC_SUCCESS);
+        return 1;
+    }
+    if (op->OC == OC_LD_B_VX || op->OC == OC_LD_I_VX || op->OC == OC_SAVE) {
+        emit_rm(j, 32, BYTES(0x8B), RAX, -1, JIT_FIELD(CODE_GEN));
+        emit_bytes(j, BYTES(0x3B, 0x44, 0x24, JIT_GEN_SLOT)); // cmp eax, [rsp + slot]
+        size_t same = emit_jcc(j, CC_E);
+        emit_return(j, count, EXEC_SUCCESS); // the block rewrote translated code
+        emit_label(j, same);
+    }
+    emit_reload(j);
+    return 0;
+}
+
+/**
+ * emit one instruction; count is the number of instructions executed when it
+ * completes and address the guest address after it. Returns 1 if the emitted
+ * code always leaves the block.
+ */
+static int emit_op(jit_ctx_t *j, instruction_t *op, uint32_t count, uint16_t address)
+{
+    int x = op->X, y = op->Y;
+    switch (op->OC) {
+        case OC_NOP: {
+            return 0;
+        }
+        case OC_LD_VX_NN: {
+            emit_set_v(j, x, op->NN);
+            return 0;
+        }
+        case OC_ADD_VX_NN: {
+            j->written |= 1 << x;
+            emit_v(j, 8, BYTES(0x80), 0, x);
+            e8(j, op->NN);
+            return 0;
+        }
+        case OC_LD_VX_VY: {
+            emit_load_v(j, RAX, y);
+            emit_store_v(j, x, RAX);
+            return 0;
+        }
+        case OC_OR:
+        case OC_AND:
+        case OC_XOR:
+        case OC_OR_KEEP:
+        case OC_AND_KEEP:
+        case OC_XOR_KEEP: {
+            uint8_t alu = (op->OC == OC_OR || op->OC == OC_OR_KEEP) ? 0x0A
+                : (op->OC == OC_AND || op->OC == OC_AND_KEEP) ? 0x22 : 0x32;
+            emit_load_v(j, RAX, x);
+            emit_v(j, 8, &alu, 1, RAX, y);
+            emit_store_v(j, x, RAX);
+            if (op->OC == OC_OR || op->OC == OC_AND || op->OC == OC_XOR) {
+                emit_set_v(j, 0xF, 0);
+            }
+            return 0;
+        }
+        case OC_ADD_VX_VY:
+        case OC_SUB:
+        case OC_SUBN: {
+            uint8_t alu = op->OC == OC_ADD_VX_VY ? 0x02 : 0x2A;
+            emit_load_v(j, RAX, op->OC == OC_SUBN ? y : x);
+            emit_v(j, 8, &alu, 1, RAX, op->OC == OC_SUBN ? x : y);
+            emit_setcc(j, op->OC == OC_ADD_VX_VY ? CC_B : CC_AE, RDX);
+            emit_store_v(j, x, RAX);
+            emit_store_v(j, 0xF, RDX);
+            return 0;
+        }
+        case OC_SHR:
+        case OC_SHL:
+        case OC_SHR_VX:
+        case OC_SHL_VX: {
+            emit_load_v(j, RAX, (op->OC == OC_SHR || op->OC == OC_SHL) ? y : x);
+            emit_rm(j, 8, BYTES(0x8A), RDX, RAX, 0);
+            if (op->OC == OC_SHR || op->OC == OC_SHR_VX) {
+                emit_rm(j, 8, BYTES(0x80), 4, RDX, 0); // and dl, 1
+                e8(j, 1);
+                emit_rm(j, 8, BYTES(0xD0), 5, RAX, 0); // shr al, 1
+            } else {
+                emit_rm(j, 8, BYTES(0xC0), 5, RDX, 0); // shr dl, 7
+                e8(j, 7);
+                emit_rm(j, 8, BYTES(0x02), RAX, RAX, 0); // add al, al
+            }
+            emit_store_v(j, x, RAX);
+            emit_store_v(j, 0xF, RDX);
+            return 0;
+        }
+        case OC_LD_I: {
+            emit_rm(j, 16, BYTES(0xC7), 0, -1, JIT_FIELD(I));
+            e16(j, op->NNN);
+            return 0;
+        }
+        case OC_ADD_I_VX: {
+            emit_v(j, 32, BYTES(0x0F, 0xB6), RAX, x);
+            emit_rm(j, 16, BYTES(0x01), RAX, -1, JIT_FIELD(I));
+            return 0;
+        }
+        case OC_LD_F_VX: {
+            emit_v(j, 32, BYTES(0x0F, 0xB6), RAX, x);
+            emit_bytes(j, BYTES(0x69, 0xC0)); // imul eax, eax, FONT_OFFSET
+            e32(j, FONT_OFFSET);
+            e8(j, 0x05); // add eax, FONTSET_ADDRESS
+            e32(j, FONTSET_ADDRESS);
+            emit_rm(j, 16, BYTES(0x89), RAX, -1, JIT_FIELD(I));
+            return 0;
+        }
+        case OC_LD_VX_DT: {
+            emit_rm(j, 8, BYTES(0x8A), RAX, -1, JIT_FIELD(DT));
+            emit_store_v(j, x, RAX);
+            return 0;
+        }
+        case OC_LD_DT_VX:
+        case OC_LD_ST_VX: {
+            emit_load_v(j, RAX, x);
+            emit_rm(j, 8, BYTES(0x88), RAX, -1, op->OC == OC_LD_DT_VX ? JIT_FIELD(DT) : JIT_FIELD(ST));
+            return 0;
+        }
+        case OC_LD_VX_I:
+        case OC_LD_VX_I_X:
+        case OC_LD_VX_I_KEEP: {
+            emit_rm(j, 32, BYTES(0x0F, 0xB7), RAX, -1, JIT_FIELD(I));
+            for (int i = 0; i <= x; i++) {
+                emit_bytes(j, BYTES(0x89, 0xC1)); // mov ecx, eax
+                emit_rm(j, 16, BYTES(0x23), RCX, -1, JIT_FIELD(RAM_MASK)); // and cx, [rbx + RAM_MASK]
+                emit_bytes(j, BYTES(0x8A, 0x94, 0x0B)); // mov dl, [rbx + rcx + RAM]
+                e32(j, JIT_FIELD(RAM));
+                emit_store_v(j, i, RDX);
+                emit_bytes(j, BYTES(0x66, 0xFF, 0xC0)); // inc ax
+            }
+            if (op->OC == OC_LD_VX_I_X) {
+                emit_bytes(j, BYTES(0x66, 0xFF, 0xC8)); // dec ax
+            }
+            if (op->OC != OC_LD_VX_I_KEEP) {
+                emit_rm(j, 16, BYTES(0x89), RAX, -1, JIT_FIELD(I));
+            }
+            return 0;
+        }
+        case OC_JP: {
+            emit_exit(j, count, op->NNN);
+            return 1;
+        }
+        case OC_JP_V0:
+        case OC_JP_VX: {
+            emit_v(j, 32, BYTES(0x0F, 0xB6), RAX, op->OC == OC_JP_VX ? x : 0);
+            e8(j, 0x05); // add eax, NNN
+            e32(j, op->NNN);
+            emit_spill(j);
+            emit_rm(j, 16, BYTES(0x89), RAX, -1, JIT_FIELD(PC));
+            emit_return(j, count, EXEC_SUCCESS);
+            return 1;
+        }
+        case OC_CALL: {
+            emit_rm(j, 32, BYTES(0x0F, 0xB6), RAX, -1, JIT_FIELD(SP));
+            emit_bytes(j, BYTES(0x3C, STACK_SIZE)); // cmp al, STACK_SIZE
+            size_t ok = emit_jcc(j, CC_NE);
+            emit_spill(j);
+            emit_store_pc(j, address);
+            emit_return(j, count, STACK_OVERFLOW);
+            emit_label(j, ok);
+            emit_bytes(j, BYTES(0x66, 0xC7, 0x84, 0x43)); // mov word [rbx + rax * 2 + STACK], address
+            e32(j, JIT_FIELD(STACK));
+            e16(j, address);
+            emit_rm(j, 8, BYTES(0xFE), 0, -1, JIT_FIELD(SP));
+            emit_exit(j, count, op->NNN);
+            return 1;
+        }
+        case OC_RET: {
+            emit_rm(j, 32, BYTES(0x0F, 0xB6), RAX, -1, JIT_FIELD(SP));
+            emit_bytes(j, BYTES(0x84, 0xC0)); // test al, al
+            size_t ok = emit_jcc(j, CC_NE);
+            emit_spill(j);
+            emit_store_pc(j, address);
+            emit_return(j, count, STACK_UNDERFLOW);
+            emit_label(j, ok);
+            emit_bytes(j, BYTES(0xFE, 0xC8)); // dec al
+            emit_rm(j, 8, BYTES(0x88), RAX, -1, JIT_FIELD(SP));
+            emit_bytes(j, BYTES(0x0F, 0xB7, 0x84, 0x43)); // movzx eax, word [rbx + rax * 2 + STACK]
+            e32(j, JIT_FIELD(STACK));
+            emit_spill(j);
+            emit_rm(j, 16, BYTES(0x89), RAX, -1, JIT_FIELD(PC));
+            emit_return(j, count, EXEC_SUCCESS);
+            return 1;
+        }
+        case OC_SE_VX_NN:
+        case OC_SNE_VX_NN: {
+            emit_v(j, 8, BYTES(0x80), 7, x); // cmp VX, NN
+            e8(j, op->NN);
+            emit_setcc(j, op->OC == OC_SE_VX_NN ? CC_E : CC_NE, RDX);
+            emit_skip(j, count, address);
+            return 1;
+        }
+        case OC_SE_VX_VY:
+        case OC_SNE_VX_VY: {
+            emit_load_v(j, RAX, x);
+            emit_v(j, 8, BYTES(0x3A), RAX, y);
+            emit_setcc(j, op->OC == OC_SE_VX_VY ? CC_E : CC_NE, RDX);
+            emit_skip(j, count, address);
+            return 1;
+        }
+        case OC_SKP:
+        case OC_SKNP: {
+            emit_v(j, 32, BYTES(0x0F, 0xB6), RAX, x);
+            emit_bytes(j, BYTES(0x80, 0xBC, 0x03)); // cmp byte [rbx + rax + KEYBOARD], 0
+            e32(j, JIT_FIELD(KEYBOARD));
+            e8(j, 0);
+            emit_setcc(j, op->OC == OC_SKP ? CC_NE : CC_E, RDX);
+            emit_skip(j, count, address);
+            return 1;
+        }
+        default: { // CLS, RND, DRW, FX0A, FX33, FX55, SUPER-CHIP, XO-CHIP and unknown opcodes
+            return emit_generic(j, op, count, address);
+        }
+    }
+}
+
+// count how often each guest register is touched by natively emitted code
+static void jit_count_uses(instruction_t *op, int *uses)
+{
+    switch (op->OC) {
+        case OC_LD_VX_VY: case OC_SE_VX_VY: case OC_SNE_VX_VY: {
+            uses[op->X]++;
+            uses[op->Y]++;
+            break;
+        }
+        case OC_OR: case OC_AND: case OC_XOR: case OC_ADD_VX_VY: case OC_SUB: case OC_SUBN: case OC_SHR: case OC_SHL:
+        case OC_OR_KEEP: case OC_AND_KEEP: case OC_XOR_KEEP: case OC_SHR_VX: case OC_SHL_VX: {
+            uses[op->X]++;
+            uses[op->Y]++;
+            uses[0xF]++;
+            break;
+        }
+        case OC_LD_VX_NN: case OC_ADD_VX_NN: case OC_SE_VX_NN: case OC_SNE_VX_NN: case OC_SKP: case OC_SKNP:
+        case OC_LD_VX_DT: case OC_LD_DT_VX: case OC_LD_ST_VX: case OC_ADD_I_VX: case OC_LD_F_VX: {
+            uses[op->X]++;
+            break;
+        }
+        case OC_JP_V0: {
+            uses[0]++;
+            break;
+        }
+        case OC_JP_VX: {
+            uses[op->X]++;
+            break;
+        }
+        case OC_LD_VX_I: case OC_LD_VX_I_X: case OC_LD_VX_I_KEEP: {
+            for (int i = 0; i <= op->X; i++) uses[i]++;
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+static void *jit_compile(jit_t *jit, block_t *b)
+{
+    jit_ctx_t ctx = { .code = jit->arena + jit->used, .cap = jit->size - jit->used };
+    jit_ctx_t *j = &ctx;
+    instruction_t *ops = &jit->blocks->ops[b->op];
+
+    // give the busiest guest registers a host register
+    int uses[16] = { 0 };
+    for (int i = 0; i < b->length; i++) {
+        jit_count_uses(&ops[i], uses);
+    }
+    for (int x = 0; x < 16; x++) {
+        j->host[x] = -1;
+    }
+    for (int r = 0; r < JIT_POOL_SIZE; r++) {
+        int best = -1;
+        for (int x = 0; x < 16; x++) {
+            if (j->host[x] < 0 && uses[x] > 0 && (best < 0 || uses[x] > uses[best])) best = x;
+        }
+        if (best < 0) break;
+        j->host[best] = jit_pool[r];
+    }
+
+    // the spill set must be known before any exit is emitted
+    j->written = 0;
+    for (int x = 0; x < 16; x++) {
+        if (j->host[x] >= 0) j->written |= 1 << x;
+    }
+
+    emit_prologue(j);
+    int left = 0;
+    for (int i = 0; i < b->length && !left; i++) {
+        left = emit_op(j, &ops[i], i + 1, b->start + 2 * (i + 1));
+    }
+    if (!left) {
+        emit_exit(j, b->length, b->end);
+    }
+
+    if (j->len > j->cap) {
+        return NULL;
+    }
+    jit->used += (j->len + 15) & ~(size_t)15;
+    if (jit->used > jit->size) jit->used = jit->size;
+    return j->code;
+}
+
+jit_t *jit_create()
+{
+    jit_t *jit = malloc(sizeof(jit_t));
+    if (jit == NULL) {
+        return NULL;
+    }
+    jit->size = JIT_ARENA_SIZE;
+#ifdef _WIN32
+    jit->arena = VirtualAlloc(NULL, jit->size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+    jit->arena = mmap(NULL, jit->size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (jit->arena == MAP_FAILED) jit->arena = NULL;
+#endif
+    jit->blocks = block_cache_create();
+    if (jit->arena == NULL || jit->blocks == NULL) {
+        jit_destroy(&jit);
+        return NULL;
+    }
+    jit_flush(jit);
+    return jit;
+}
+
+void jit_destroy(jit_t **jit)
+{
+    if ((*jit)->arena != NULL) {
+#ifdef _WIN32
+        VirtualFree((*jit)->arena, 0, MEM_RELEASE);
+#else
+        munmap((*jit)->arena, (*jit)->size);
+#endif
+    }
+    if ((*jit)->blocks != NULL) {
+        block_cache_destroy(&(*jit)->blocks);
+    }
+    free(*jit);
+    *jit = NULL;
+}
+
+void jit_flush(jit_t *jit)
+{
+    block_cache_flush(jit->blocks);
+    jit->used = 0;
+    memset(jit->smc, 0, sizeof(uint8_t) * RAM_SIZE);
+}
+
+static int jit_self_modified(jit_t *jit, block_t *b)
+{
+    for (int i = b->start; i < b->end; i++) {
+        if (jit->smc[i]) return 1;
+    }
+    return 0;
+}
+
+exec_res_t jit_run(jit_t *jit, chip8_t *c8, uint32_t count, uint32_t *executed)
+{
+    block_cache_t *bc = jit->blocks;
+    exec_res_t result = EXEC_SUCCESS;
+    uint32_t n = 0;
+
+    while (n < count && result == EXEC_SUCCESS) {
+        if (c8->CODE_GEN != bc->gen) {
+            // code that got overwritten stays with the interpreter from now on
+            if (c8->CODE_LO == 0 && c8->CODE_HI == RAM_SIZE - 1) { // reset
+                jit_flush(jit);
+            } else if (c8->CODE_LO <= c8->CODE_HI) {
+                memset(&jit->smc[c8->CODE_LO], 1, sizeof(uint8_t) * (c8->CODE_HI - c8->CODE_LO + 1));
+            }
+            block_sync(bc, c8);
+        }
+        uint16_t pc = c8->PC;
+        block_t *b = (pc < RAM_SIZE) ? bc->map[pc] : NULL;
+        if (b == NULL || !b->valid) {
+            b = block_translate(bc, c8, pc);
+        }
+        if (b == NULL || b->length > count - n) {
+            result = chip8_cycle(c8);
+            n++;
+            continue;
+        }
+
+        if (b->native == NULL && ++b->hits >= JIT_THRESHOLD && !jit_self_modified(jit, b)) {
+            b->native = jit_compile(jit, b);
+            if (b->native == NULL) { // arena full, start over
+                block_cache_flush(bc);
+                jit->used = 0;
+                continue;
+            }
+        }
+        if (b->native != NULL) {
+            uint32_t r = ((jit_block_t)b->native)(c8);
+            result = r & 0xFF;
+            n += r >> 8;
+            if (result == EXEC_SUCCESS && c8->PC >= RAM_SIZE) {
+                c8->PC = START_ADDRESS;
+                result = PC_OVERFLOW;
+            }
+        } else { // cold or self-modifying block
+            uint32_t gen = c8->CODE_GEN;
+            for (int i = 0; i < b->length && result == EXEC_SUCCESS && c8->CODE_GEN == gen; i++) {
+                result = chip8_cycle(c8);
+                n++;
+            }
+        }
+    }
+
+    if (executed) *executed = n;
+    return result;
+}
+
+#else
+
+jit_t *jit_create()
+{
+    return NULL;
+}
+
+void jit_destroy(jit_t **jit)
+{
+    *jit = NULL;
+}
+
+void jit_flush(jit_t *jit)
+{
+    (void)jit;
+}
+
+exec_res_t jit_run(jit_t *jit, chip8_t *c8, uint32_t count, uint32_t *executed)
+{
+    (void)jit;
+    exec_res_t result = EXEC_SUCCESS;
+    uint32_t n = 0;
+    while (n < count && result == EXEC_SUCCESS) {
+        result = chip8_cycle(c8);
+        n++;
+    }
+    if (executed) *executed = n;
+    return result;
+}
+
+#endif
@@ -0,0 +1,275 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/chip8.h"
+#include "include/lockstep.h"
+
+// GCC and Clang vector extensions, SSE2 by default and AVX2 with -mavx2;
+// anything else runs every lane through chip8_cycle
+#if defined(__GNUC__) || defined(__clang__)
+#define LOCKSTEP_SIMD
+#endif
+
+lockstep_t *lockstep_create()
+{
+    return calloc(1, sizeof(lockstep_t));
+}
+
+void lockstep_destroy(lockstep_t **ls)
+{
+    free(*ls);
+    *ls = NULL;
+}
+
+int lockstep_add(lockstep_t *ls, chip8_t *c8)
+{
+    if (ls->count == LOCKSTEP_LANES) {
+        return -1;
+    }
+    ls->lanes[ls->count] = c8;
+    ls->result[ls->count] = EXEC_SUCCESS;
+    ls->executed[ls->count] = 0;
+    return ls->count++;
+}
+
+// copy the registers of an instance into its lane
+static void lockstep_load(lockstep_t *ls, int lane)
+{
+    chip8_t *c8 = ls->lanes[lane];
+    for (int x = 0; x < 16; x++) {
+        ls->V[x][lane] = c8->V[x];
+    }
+    ls->I[lane] = c8->I;
+    ls->PC[lane] = c8->PC;
+    ls->DT[lane] = c8->DT;
+    ls->ST[lane] = c8->ST;
+}
+
+// copy the registers of a lane back into its instance
+static void lockstep_store(lockstep_t *ls, int lane)
+{
+    chip8_t *c8 = ls->lanes[lane];
+    for (int x = 0; x < 16; x++) {
+        c8->V[x] = ls->V[x][lane];
+    }
+    c8->I = ls->I[lane];
+    c8->PC = ls->PC[lane];
+    c8->DT = ls->DT[lane];
+    c8->ST = ls->ST[lane];
+}
+
+// run one instruction of a lane on its instance
+static void lockstep_scalar(lockstep_t *ls, int lane)
+{
+    lockstep_store(ls, lane);
+    ls->result[lane] = chip8_cycle(ls->lanes[lane]);
+    lockstep_load(ls, lane);
+    ls->scalar_steps++;
+}
+
+#ifdef LOCKSTEP_SIMD
+// bytes per host vector register
+#ifdef __AVX2__
+#define LOCKSTEP_VECTOR 32
+#else
+#define LOCKSTEP_VECTOR 16
+#endif
+#define WORD_LANES (LOCKSTEP_VECTOR / 2)
+
+typedef uint8_t bytes_t __attribute__((vector_size(LOCKSTEP_VECTOR), aligned(1)));
+typedef uint8_t half_bytes_t __attribute__((vector_size(WORD_LANES), aligned(1)));
+typedef int8_t half_mask_t __attribute__((vector_size(WORD_LANES)));
+typedef uint16_t words_t __attribute__((vector_size(LOCKSTEP_VECTOR), aligned(1)));
+typedef int16_t words_mask_t __attribute__((vector_size(LOCKSTEP_VECTOR)));
+
+#define LANE_BYTES(a) (*(bytes_t *)(a))
+#define LANE_WORDS(a) (*(words_t *)(a))
+// byte lanes widened to word lanes, comparison results stay all ones
+#define LANE_WIDEN(a) __builtin_convertvector(*(half_bytes_t *)(a), words_t)
+#define LANE_WIDEN_MASK(m) ((words_t)__builtin_convertvector((half_mask_t)(m), words_mask_t))
+// overwrite the lanes selected by the mask only
+#define LANE_BLEND(dst, value, mask) ((dst) = ((dst) & ~(mask)) | ((value) & (mask)))
+
+// all ones in the byte lanes of the group, from lane first on
+static bytes_t lockstep_byte_mask(uint32_t group, int first)
+{
+    uint8_t spread[LOCKSTEP_VECTOR];
+    bytes_t bits;
+    for (int i = 0; i < LOCKSTEP_VECTOR; i += 8) {
+        uint64_t byte = (group >> (first + i)) & 0xFF;
+        uint64_t all = byte * 0x0101010101010101ULL;
+        memcpy(&spread[i], &all, 8);
+        for (int k = 0; k < 8; k++) bits[i + k] = 1 << k;
+    }
+    return (bytes_t)((LANE_BYTES(spread) & bits) != 0);
+}
+
+// all ones in the word lanes of the group, from lane first on
+static words_t lockstep_word_mask(uint32_t group, int first)
+{
+    const words_t zero = { 0 };
+    words_t bits;
+    for (int i = 0; i < WORD_LANES; i++) bits[i] = 1 << i;
+    return (words_t)(((zero + (uint16_t)(group >> first)) & bits) != 0);
+}
+
+// run the instruction at pc for every lane of the group at once, 0 if it has no vector form;
+// when the group holds every running lane the others are free to be overwritten
+static int lockstep_vector(lockstep_t *ls, instruction_t *inst, uint16_t pc, uint32_t group, int all, uint32_t *halted)
+{
+    switch (inst->OC) {
+        case OC_NOP: case OC_JP: case OC_JP_V0: case OC_SE_VX_NN: case OC_SNE_VX_NN: case OC_SE_VX_VY:
+        case OC_SNE_VX_VY: case OC_LD_VX_NN: case OC_ADD_VX_NN: case OC_LD_VX_VY: case OC_OR: case OC_AND:
+        case OC_XOR: case OC_ADD_VX_VY: case OC_SUB: case OC_SHR: case OC_SUBN: case OC_SHL: case OC_LD_I:
+        case OC_ADD_I_VX: case OC_LD_F_VX: case OC_LD_VX_DT: case OC_LD_DT_VX: case OC_LD_ST_VX: case OC_OR_KEEP:
+        case OC_AND_KEEP: case OC_XOR_KEEP: case OC_SHR_VX: case OC_SHL_VX: case OC_JP_VX: break;
+        default: return 0;
+    }
+    uint8_t X = inst->X, Y = inst->Y;
+
+    // byte registers
+    const bytes_t zero8 = { 0 };
+    for (int c = 0; c < LOCKSTEP_LANES; c += LOCKSTEP_VECTOR) {
+        bytes_t m = all ? ~zero8 : lockstep_byte_mask(group, c);
+        bytes_t x = LANE_BYTES(&ls->V[X][c]);
+        bytes_t y = LANE_BYTES(&ls->V[Y][c]);
+        bytes_t *VX = (bytes_t *)&ls->V[X][c];
+        bytes_t *VF = (bytes_t *)&ls->V[0xF][c];
+        switch (inst->OC) {
+            case OC_LD_VX_NN: LANE_BLEND(*VX, zero8 + inst->NN, m); break;
+            case OC_ADD_VX_NN: LANE_BLEND(*VX, x + inst->NN, m); break;
+            case OC_LD_VX_VY: LANE_BLEND(*VX, y, m); break;
+            case OC_OR: LANE_BLEND(*VX, x | y, m); LANE_BLEND(*VF, zero8, m); break;
+            case OC_AND: LANE_BLEND(*VX, x & y, m); LANE_BLEND(*VF, zero8, m); break;
+            case OC_XOR: LANE_BLEND(*VX, x ^ y, m); LANE_BLEND(*VF, zero8, m); break;
+            case OC_OR_KEEP: LANE_BLEND(*VX, x | y, m); break;
+            case OC_AND_KEEP: LANE_BLEND(*VX, x & y, m); break;
+            case OC_XOR_KEEP: LANE_BLEND(*VX, x ^ y, m); break;
+            case OC_ADD_VX_VY: {
+                bytes_t sum = x + y;
+                LANE_BLEND(*VX, sum, m);
+                LANE_BLEND(*VF, (bytes_t)(sum < x) & 1, m);
+                break;
+            }
+            case OC_SUB: LANE_BLEND(*VX, x - y, m); LANE_BLEND(*VF, (bytes_t)(x >= y) & 1, m); break;
+            case OC_SHR: LANE_BLEND(*VX, y >> 1, m); LANE_BLEND(*VF, y & 1, m); break;
+            case OC_SUBN: LANE_BLEND(*VX, y - x, m); LANE_BLEND(*VF, (bytes_t)(y >= x) & 1, m); break;
+            case OC_SHL: LANE_BLEND(*VX, y << 1, m); LANE_BLEND(*VF, y >> 7, m); break;
+            case OC_SHR_VX: LANE_BLEND(*VX, x >> 1, m); LANE_BLEND(*VF, x & 1, m); break;
+            case OC_SHL_VX: LANE_BLEND(*VX, x << 1, m); LANE_BLEND(*VF, x >> 7, m); break;
+            case OC_LD_VX_DT: LANE_BLEND(*VX, LANE_BYTES(&ls->DT[c]), m); break;
+            case OC_LD_DT_VX: LANE_BLEND(LANE_BYTES(&ls->DT[c]), x, m); break;
+            case OC_LD_ST_VX: LANE_BLEND(LANE_BYTES(&ls->ST[c]), x, m); break;
+            default: break;
+        }
+    }
+
+    // word registers, the instructions below leave the byte registers alone
+    const words_t zero16 = { 0 };
+    for (int c = 0; c < LOCKSTEP_LANES; c += WORD_LANES) {
+        words_t m = all ? ~zero16 : lockstep_word_mask(group, c);
+        words_t next = zero16 + (uint16_t)(pc + 2);
+        half_bytes_t x = *(half_bytes_t *)&ls->V[X][c];
+        half_bytes_t y = *(half_bytes_t *)&ls->V[Y][c];
+        switch (inst->OC) {
+            case OC_JP: next = zero16 + inst->NNN; break;
+            case OC_JP_V0: next = LANE_WIDEN(&ls->V[0][c]) + inst->NNN; break;
+            case OC_JP_VX: next = LANE_WIDEN(&ls->V[X][c]) + inst->NNN; break;
+            case OC_SE_VX_NN: next += LANE_WIDEN_MASK(x == inst->NN) & 2; break;
+            case OC_SNE_VX_NN: next += LANE_WIDEN_MASK(x != inst->NN) & 2; break;
+            case OC_SE_VX_VY: next += LANE_WIDEN_MASK(x == y) & 2; break;
+            case OC_SNE_VX_VY: next += LANE_WIDEN_MASK(x != y) & 2; break;
+            case OC_LD_I: LANE_BLEND(LANE_WORDS(&ls->I[c]), zero16 + inst->NNN, m); break;
+            case OC_ADD_I_VX: LANE_BLEND(LANE_WORDS(&ls->I[c]), LANE_WORDS(&ls->I[c]) + LANE_WIDEN(&ls->V[X][c]), m); break;
+            case OC_LD_F_VX: LANE_BLEND(LANE_WORDS(&ls->I[c]), LANE_WIDEN(&ls->V[X][c]) * FONT_OFFSET + FONTSET_ADDRESS, m); break;
+            default: break;
+        }
+        LANE_BLEND(LANE_WORDS(&ls->PC[c]), next, m);
+    }
+
+    if (inst->OC == OC_JP_V0 || inst->OC == OC_JP_VX || pc >= RAM_SIZE - 4) { // the only ways past the end of RAM
+        for (int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+            if ((group >> lane & 1) && ls->PC[lane] >= RAM_SIZE) {
+                ls->PC[lane] = START_ADDRESS;
+                ls->result[lane] = PC_OVERFLOW;
+                *halted |= 1u << lane;
+            }
+        }
+    }
+    ls->vector_steps++;
+    return 1;
+}
+#else
+static int lockstep_vector(lockstep_t *ls, instruction_t *inst, uint16_t pc, uint32_t group, int all, uint32_t *halted)
+{
+    return 0;
+}
+#endif
+
+void lockstep_run(lockstep_t *ls, uint32_t count)
+{
+    uint32_t active = 0;
+    for (int lane = 0; lane < ls->count; lane++) {
+        ls->executed[lane] = 0;
+        if (ls->result[lane] == EXEC_SUCCESS) {
+            lockstep_load(ls, lane);
+            active |= 1u << lane;
+        }
+    }
+
+    for (uint32_t step = 0; step < count && active; step++) {
+        uint32_t todo = active;
+        uint32_t halted = 0;
+        for (int lead = 0; todo; lead++) {
+            if (!(todo >> lead & 1)) continue;
+            // group the lanes about to run the same opcode at the same address under the same quirks
+            uint16_t pc = ls->PC[lead];
+            uint8_t profile = ls->lanes[lead]->PROFILE;
+            uint32_t group = 1u << lead;
+            if (pc < RAM_SIZE - 1) {
+                uint32_t same = 0;
+                for (int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+                    same |= (uint32_t)(ls->PC[lane] == pc) << lane;
+                }
+                same &= todo;
+                uint16_t opcode, other;
+                memcpy(&opcode, &ls->lanes[lead]->RAM[pc], 2);
+                for (int lane = lead + 1; lane < ls->count; lane++) {
+                    memcpy(&other, &ls->lanes[lane]->RAM[pc], 2);
+                    if ((same >> lane & 1) && other == opcode && ls->lanes[lane]->PROFILE == profile) group |= 1u << lane;
+                }
+            }
+            todo &= ~group;
+
+            if (group & (group - 1)) {
+                chip8_t *c8 = ls->lanes[lead];
+                instruction_t decoded, *inst = &c8->DECODED[pc];
+                if (!c8->DECODED_VALID[pc]) {
+                    chip8_decode(c8->RAM[pc] << 8 | c8->RAM[pc + 1], &decoded);
+                    chip8_specialize(&decoded, profile);
+                    inst = &decoded;
+                }
+                if (lockstep_vector(ls, inst, pc, group, group == active, &halted)) continue;
+            }
+            // divergent lane or no vector form
+            for (int lane = lead; lane < ls->count; lane++) {
+                if (!(group >> lane & 1)) continue;
+                lockstep_scalar(ls, lane);
+                if (ls->result[lane] != EXEC_SUCCESS) halted |= 1u << lane;
+            }
+        }
+        // halted lanes are written back at once, their registers are not kept up to date any more
+        for (int lane = 0; halted && lane < ls->count; lane++) {
+            if (!(halted >> lane & 1)) continue;
+            ls->executed[lane] = step + 1;
+            lockstep_store(ls, lane);
+        }
+        active &= ~halted;
+    }
+
+    for (int lane = 0; lane < ls->count; lane++) {
+        if (!(active >> lane & 1)) continue;
+        ls->executed[lane] = count;
+        lockstep_store(ls, lane);
+    }
+}
@@ -12,19 +12,37 @@ void clean_up();
 
 int main(int argc, char *argv[])
 {
-    if (argc < 2 || SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
+    if (argc < 2) {
         return EXIT_FAILURE;
     }
 
     args_t args = parse_args(argc, argv);
+    if (!args.headless && SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
+        return EXIT_FAILURE;
+    }
     device = device_init(&args);
 
     atexit(clean_up);
 
+    if (args.play_path && !device->playing) {
+        return EXIT_FAILURE;
+    }
+
     if (device_start(device) != ROM_LOAD_SUCCESS) {
         return EXIT_FAILURE;
     }
 
+    if (args.headless && device->playing) { // as fast as possible, then check the result
+        exec_res_t result = device->movie->frames ? device_run(device, device->movie->frames, 0) : EXEC_SUCCESS;
+        return (result == EXEC_SUCCESS && device_verify(device)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (args.headless) {
+        exec_res_t result = device_run(device, args.frames, args.instructions);
+        return (result == EXEC_SUCCESS) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    device_launch(device);
 #ifdef __EMSCRIPTEN__
     emscripten_set_main_loop_arg(device_iterate, device, 60, 0);
 #else
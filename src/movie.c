@@ -0,0 +1,267 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/movie.h"
+
+// flags of an event in the file: what changed
+#define MOVIE_KEYS 1
+#define MOVIE_IPF 2
+
+static const uint8_t movie_magic[4] = { 'C', 'H', '8', 'M' };
+
+movie_t *movie_create(uint64_t rom_hash, uint64_t seed, uint8_t profile)
+{
+    movie_t *movie = calloc(1, sizeof(movie_t));
+    if (movie == NULL) {
+        return NULL;
+    }
+    movie->rom_hash = rom_hash;
+    movie->seed = seed;
+    movie->profile = profile;
+    return movie;
+}
+
+void movie_destroy(movie_t **movie)
+{
+    free((*movie)->events);
+    free(*movie);
+    *movie = NULL;
+}
+
+static uint64_t movie_fnv(uint64_t hash, const uint8_t *bytes, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// little-endian, so that hashes are the same on every host
+static uint64_t movie_fnv_value(uint64_t hash, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++) {
+        hash ^= (value >> (8 * i)) & 0xFF;
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+uint64_t movie_rom_hash(chip8_t *c8)
+{
+    return movie_fnv(0xCBF29CE484222325ULL, &c8->RAM[START_ADDRESS], XO_RAM_SIZE - START_ADDRESS);
+}
+
+// everything a run decides, not the keys or the render flag the frontend plays with
+uint64_t movie_state_hash(chip8_t *c8)
+{
+    uint64_t hash = movie_fnv(0xCBF29CE484222325ULL, c8->RAM, XO_RAM_SIZE);
+    hash = movie_fnv(hash, c8->V, 16);
+    for (int i = 0; i < STACK_SIZE; i++) {
+        hash = movie_fnv_value(hash, c8->STACK[i], 2);
+    }
+    hash = movie_fnv_value(hash, c8->I, 2);
+    hash = movie_fnv_value(hash, c8->PC, 2);
+    hash = movie_fnv_value(hash, c8->SP, 1);
+    hash = movie_fnv_value(hash, c8->DT, 1);
+    hash = movie_fnv_value(hash, c8->ST, 1);
+    for (int p = 0; p < PLANES; p++) {
+        for (int y = 0; y < HIRES_HEIGHT; y++) {
+            hash = movie_fnv_value(hash, c8->SCREEN[p][y][0], 8);
+            hash = movie_fnv_value(hash, c8->SCREEN[p][y][1], 8);
+        }
+    }
+    hash = movie_fnv_value(hash, c8->HIRES, 1);
+    hash = movie_fnv(hash, c8->RPL, RPL_SIZE);
+    hash = movie_fnv_value(hash, c8->PLANE, 1);
+    hash = movie_fnv(hash, c8->PATTERN, PATTERN_SIZE);
+    hash = movie_fnv_value(hash, c8->PITCH, 1);
+    hash = movie_fnv_value(hash, c8->AUDIO, 1);
+    return movie_fnv_value(hash, c8->RNG, 8);
+}
+
+static uint16_t movie_keys(uint8_t *keyboard)
+{
+    uint16_t keys = 0;
+    for (int i = 0; i < 16; i++) {
+        keys |= (keyboard[i] != 0) << i;
+    }
+    return keys;
+}
+
+// called at the start of every frame, adds an event when the keys or the IPF changed
+void movie_record(movie_t *movie, uint32_t frame, uint64_t instructions, uint8_t *keyboard, uint16_t ipf)
+{
+    uint16_t keys = movie_keys(keyboard);
+    movie_event_t *last = movie->count ? &movie->events[movie->count - 1] : NULL;
+    if (last && last->keys == keys && last->ipf == ipf) {
+        return;
+    }
+    if (movie->count == movie->capacity) {
+        uint32_t capacity = movie->capacity ? movie->capacity * 2 : 256;
+        movie_event_t *events = realloc(movie->events, sizeof(movie_event_t) * capacity);
+        if (events == NULL) {
+            return;
+        }
+        movie->events = events;
+        movie->capacity = capacity;
+    }
+    movie->events[movie->count++] = (movie_event_t){ frame, instructions, keys, ipf };
+}
+
+void movie_finish(movie_t *movie, uint32_t frame, uint64_t instructions, chip8_t *c8)
+{
+    movie->frames = frame;
+    movie->instructions = instructions;
+    movie->state_hash = movie_state_hash(c8);
+}
+
+// called at the start of every frame, applies its event; returns 0 if the run got out of sync
+int movie_play(movie_t *movie, uint32_t frame, uint64_t instructions, uint8_t *keyboard, uint16_t *ipf)
+{
+    if (movie->next < movie->count && movie->events[movie->next].frame == frame) {
+        movie_event_t *event = &movie->events[movie->next++];
+        for (int i = 0; i < 16; i++) {
+            keyboard[i] = event->keys >> i & 1;
+        }
+        *ipf = event->ipf;
+        return event->instructions == instructions;
+    }
+    return 1;
+}
+
+// does a run end like the recorded one?
+int movie_verify(movie_t *movie, uint32_t frame, uint64_t instructions, chip8_t *c8)
+{
+    return frame == movie->frames && instructions == movie->instructions && movie_state_hash(c8) == movie->state_hash;
+}
+
+static void movie_put(FILE *f, uint64_t value)
+{
+    for (; value >= 0x80; value >>= 7) {
+        fputc((value & 0x7F) | 0x80, f);
+    }
+    fputc(value, f);
+}
+
+static void movie_put_fixed(FILE *f, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++) {
+        fputc((value >> (8 * i)) & 0xFF, f);
+    }
+}
+
+// returns 0 at the end of the file
+static int movie_get(FILE *f, uint64_t *value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = fgetc(f);
+        if (byte == EOF) return 0;
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if (byte < 0x80) return 1;
+    }
+    return 0;
+}
+
+static int movie_get_fixed(FILE *f, uint64_t *value, int bytes)
+{
+    *value = 0;
+    for (int i = 0; i < bytes; i++) {
+        int byte = fgetc(f);
+        if (byte == EOF) return 0;
+        *value |= (uint64_t)byte << (8 * i);
+    }
+    return 1;
+}
+
+/**
+ * header: magic "CH8M", version, profile, a reserved byte, ROM hash and seed
+ * events: varint count, then for each the frame and instruction deltas as varints,
+ * a byte of flags and the keys and the IPF if they changed
+ * end: frame and instruction deltas as varints, and the state hash
+ */
+movie_res_t movie_write(movie_t *movie, FILE *f)
+{
+    if (f == NULL) {
+        return MOVIE_NOT_EXISTS;
+    }
+    fwrite(movie_magic, sizeof(uint8_t), sizeof(movie_magic), f);
+    movie_put_fixed(f, MOVIE_VERSION, 2);
+    movie_put_fixed(f, movie->profile, 1);
+    movie_put_fixed(f, 0, 1);
+    movie_put_fixed(f, movie->rom_hash, 8);
+    movie_put_fixed(f, movie->seed, 8);
+    movie_put(f, movie->count);
+    movie_event_t previous = { 0 };
+    for (uint32_t i = 0; i < movie->count; i++) {
+        movie_event_t *event = &movie->events[i];
+        uint8_t flags = (i == 0 || event->keys != previous.keys) * MOVIE_KEYS
+            | (i == 0 || event->ipf != previous.ipf) * MOVIE_IPF;
+        movie_put(f, event->frame - previous.frame);
+        movie_put(f, event->instructions - previous.instructions);
+        fputc(flags, f);
+        if (flags & MOVIE_KEYS) movie_put_fixed(f, event->keys, 2);
+        if (flags & MOVIE_IPF) movie_put_fixed(f, event->ipf, 2);
+        previous = *event;
+    }
+    movie_put(f, movie->frames - previous.frame);
+    movie_put(f, movie->instructions - previous.instructions);
+    movie_put_fixed(f, movie->state_hash, 8);
+    return ferror(f) ? MOVIE_WRITE_FAILED : MOVIE_SUCCESS;
+}
+
+movie_res_t movie_read(movie_t **movie, FILE *f)
+{
+    *movie = NULL;
+    if (f == NULL) {
+        return MOVIE_NOT_EXISTS;
+    }
+    uint8_t magic[sizeof(movie_magic)];
+    uint64_t version, profile, reserved, rom_hash, seed, count;
+    if (fread(magic, sizeof(uint8_t), sizeof(magic), f) != sizeof(magic)) {
+        return MOVIE_TRUNCATED;
+    }
+    if (memcmp(magic, movie_magic, sizeof(magic)) != 0) {
+        return MOVIE_BAD_MAGIC;
+    }
+    if (!movie_get_fixed(f, &version, 2)) {
+        return MOVIE_TRUNCATED;
+    }
+    if (version != MOVIE_VERSION) {
+        return MOVIE_BAD_VERSION;
+    }
+    if (!movie_get_fixed(f, &profile, 1) || !movie_get_fixed(f, &reserved, 1) || !movie_get_fixed(f, &rom_hash, 8)
+        || !movie_get_fixed(f, &seed, 8) || !movie_get(f, &count)) {
+        return MOVIE_TRUNCATED;
+    }
+
+    movie_t *m = movie_create(rom_hash, seed, profile < PROFILE_COUNT ? profile : PROFILE_VIP);
+    movie_event_t event = { 0 };
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t frames, instructions, keys = event.keys, ipf = event.ipf;
+        int flags;
+        if (!movie_get(f, &frames) || !movie_get(f, &instructions) || (flags = fgetc(f)) == EOF
+            || ((flags & MOVIE_KEYS) && !movie_get_fixed(f, &keys, 2))
+            || ((flags & MOVIE_IPF) && !movie_get_fixed(f, &ipf, 2))) {
+            movie_destroy(&m);
+            return MOVIE_TRUNCATED;
+        }
+        uint8_t keyboard[16];
+        for (int k = 0; k < 16; k++) {
+            keyboard[k] = keys >> k & 1;
+        }
+        event = (movie_event_t){ event.frame + frames, event.instructions + instructions, keys, ipf };
+        movie_record(m, event.frame, event.instructions, keyboard, event.ipf);
+    }
+    uint64_t frames, instructions, state_hash;
+    if (!movie_get(f, &frames) || !movie_get(f, &instructions) || !movie_get_fixed(f, &state_hash, 8)) {
+        movie_destroy(&m);
+        return MOVIE_TRUNCATED;
+    }
+    m->frames = event.frame + frames;
+    m->instructions = event.instructions + instructions;
+    m->state_hash = state_hash;
+    *movie = m;
+    return MOVIE_SUCCESS;
+}
@@ -0,0 +1,150 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/profiler.h"
+
+static const char *const opclass_names[OC_COUNT] = {
+    [OC_UNKNOWN] = "UNKNOWN", [OC_NOP] = "NOP", [OC_CLS] = "CLS", [OC_RET] = "RET", [OC_JP] = "JP",
+    [OC_CALL] = "CALL", [OC_SE_VX_NN] = "SE_VX_NN", [OC_SNE_VX_NN] = "SNE_VX_NN", [OC_SE_VX_VY] = "SE_VX_VY",
+    [OC_LD_VX_NN] = "LD_VX_NN", [OC_ADD_VX_NN] = "ADD_VX_NN", [OC_LD_VX_VY] = "LD_VX_VY", [OC_OR] = "OR",
+    [OC_AND] = "AND", [OC_XOR] = "XOR", [OC_ADD_VX_VY] = "ADD_VX_VY", [OC_SUB] = "SUB", [OC_SHR] = "SHR",
+    [OC_SUBN] = "SUBN", [OC_SHL] = "SHL", [OC_SNE_VX_VY] = "SNE_VX_VY", [OC_LD_I] = "LD_I", [OC_JP_V0] = "JP_V0",
+    [OC_RND] = "RND", [OC_DRW] = "DRW", [OC_SKP] = "SKP", [OC_SKNP] = "SKNP", [OC_LD_VX_DT] = "LD_VX_DT",
+    [OC_LD_VX_K] = "LD_VX_K", [OC_LD_DT_VX] = "LD_DT_VX", [OC_LD_ST_VX] = "LD_ST_VX", [OC_ADD_I_VX] = "ADD_I_VX",
+    [OC_LD_F_VX] = "LD_F_VX", [OC_LD_B_VX] = "LD_B_VX", [OC_LD_I_VX] = "LD_I_VX", [OC_LD_VX_I] = "LD_VX_I",
+    [OC_SCD] = "SCD", [OC_SCR] = "SCR", [OC_SCL] = "SCL", [OC_LOW] = "LOW", [OC_HIGH] = "HIGH",
+    [OC_LD_HF_VX] = "LD_HF_VX", [OC_LD_R_VX] = "LD_R_VX", [OC_LD_VX_R] = "LD_VX_R",
+    [OC_SAVE] = "SAVE", [OC_LOAD] = "LOAD", [OC_LD_I_LONG] = "LD_I_LONG", [OC_PLANE] = "PLANE",
+    [OC_AUDIO] = "AUDIO", [OC_PITCH] = "PITCH",
+    [OC_OR_KEEP] = "OR_KEEP", [OC_AND_KEEP] = "AND_KEEP", [OC_XOR_KEEP] = "XOR_KEEP", [OC_SHR_VX] = "SHR_VX",
+    [OC_SHL_VX] = "SHL_VX", [OC_LD_VX_I_X] = "LD_VX_I_X", [OC_LD_VX_I_KEEP] = "LD_VX_I_KEEP", [OC_JP_VX] = "JP_VX",
+    [OC_SKIP_LONG] = "SKIP_LONG"
+};
+
+profiler_t *profiler_create()
+{
+    return calloc(1, sizeof(profiler_t));
+}
+
+void profiler_destroy(profiler_t **profiler)
+{
+    free(*profiler);
+    *profiler = NULL;
+}
+
+// called by chip8_execute before every instruction, with PC already past it
+void profiler_count(profiler_t *profiler, chip8_t *c8, instruction_t *inst)
+{
+    uint16_t address = (c8->PC - 2) & (RAM_SIZE - 1);
+    profiler->instructions++;
+    profiler->opclasses[inst->OC]++;
+    profiler->addresses[address]++;
+    if (inst->OC == OC_CALL && c8->SP < STACK_SIZE) {
+        profiler->calls[inst->NNN]++;
+        profiler->frames[c8->SP] = (profiler_frame_t){ inst->NNN, profiler->instructions, 1 };
+    } else if (inst->OC == OC_RET && c8->SP > 0 && profiler->frames[c8->SP - 1].valid) {
+        // the call, the body and this return
+        profiler_frame_t *frame = &profiler->frames[c8->SP - 1];
+        profiler->cycles[frame->address] += profiler->instructions - frame->start + 1;
+        frame->valid = 0;
+    }
+}
+
+// called by chip8_idle for the instructions of a loop of length instructions it skipped
+void profiler_idle(profiler_t *profiler, chip8_t *c8, uint16_t address, int length, uint32_t skipped)
+{
+    profiler->instructions += skipped;
+    for (int i = 0; i < length; i++) {
+        uint32_t count = skipped / length + (i < (int)(skipped % length));
+        uint16_t pc = address + 2 * i;
+        profiler->addresses[pc] += count;
+        profiler->opclasses[c8->DECODED_VALID[pc] ? c8->DECODED[pc].OC : OC_UNKNOWN] += count;
+    }
+}
+
+/**
+ * a row for every address that ran or was called: address, opcode, opclass, executions,
+ * calls of the subroutine there and the instructions run inside it
+ */
+profiler_res_t profiler_write_csv(profiler_t *profiler, chip8_t *c8, FILE *f)
+{
+    if (f == NULL) {
+        return PROFILER_NOT_EXISTS;
+    }
+    fprintf(f, "address,opcode,opclass,executions,calls,subroutine_instructions\n");
+    for (int address = 0; address < RAM_SIZE - 1; address++) {
+        if (profiler->addresses[address] == 0 && profiler->calls[address] == 0) {
+            continue;
+        }
+        instruction_t inst;
+        chip8_decode(c8->RAM[address] << 8 | c8->RAM[address + 1], &inst);
+        chip8_specialize(&inst, c8->PROFILE);
+        fprintf(f, "0x%03X,%04X,%s,%llu,%llu,%llu\n", address, inst.OP, opclass_names[inst.OC],
+            (unsigned long long)profiler->addresses[address], (unsigned long long)profiler->calls[address],
+            (unsigned long long)profiler->cycles[address]);
+    }
+    return ferror(f) ? PROFILER_WRITE_FAILED : PROFILER_SUCCESS;
+}
+
+// totals: instructions, executions of every opclass that ran, and the subroutines called
+profiler_res_t profiler_write_json(profiler_t *profiler, FILE *f)
+{
+    if (f == NULL) {
+        return PROFILER_NOT_EXISTS;
+    }
+    fprintf(f, "{\n  \"instructions\": %llu,\n  \"opclasses\": {", (unsigned long long)profiler->instructions);
+    const char *separator = "\n";
+    for (int oc = 0; oc < OC_COUNT; oc++) {
+        if (profiler->opclasses[oc] > 0) {
+            fprintf(f, "%s    \"%s\": %llu", separator, opclass_names[oc], (unsigned long long)profiler->opclasses[oc]);
+            separator = ",\n";
+        }
+    }
+    fprintf(f, "\n  },\n  \"subroutines\": [");
+    separator = "\n";
+    for (int address = 0; address < RAM_SIZE; address++) {
+        if (profiler->calls[address] > 0) {
+            fprintf(f, "%s    { \"address\": \"0x%03X\", \"calls\": %llu, \"instructions\": %llu }", separator, address,
+                (unsigned long long)profiler->calls[address], (unsigned long long)profiler->cycles[address]);
+            separator = ",\n";
+        }
+    }
+    fprintf(f, "\n  ]\n}\n");
+    return ferror(f) ? PROFILER_WRITE_FAILED : PROFILER_SUCCESS;
+}
+
+// log2 of count + 1 with 4 fraction bits, so that the heat map shows cold code next to hot loops
+static int profiler_level(uint64_t count)
+{
+    uint64_t value = count + 1;
+    int exponent = 0;
+    while (value >> (exponent + 1)) {
+        exponent++;
+    }
+    int fraction = exponent >= 4 ? (value >> (exponent - 4)) & 0xF : (value << (4 - exponent)) & 0xF;
+    return exponent * 16 + fraction;
+}
+
+// binary PPM, a pixel per address from black through red and yellow to white
+profiler_res_t profiler_write_heatmap(profiler_t *profiler, FILE *f)
+{
+    if (f == NULL) {
+        return PROFILER_NOT_EXISTS;
+    }
+    int hottest = 1;
+    for (int address = 0; address < RAM_SIZE; address++) {
+        int level = profiler_level(profiler->addresses[address]);
+        if (level > hottest) hottest = level;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", HEATMAP_SIDE, RAM_SIZE / HEATMAP_SIDE);
+    for (int address = 0; address < RAM_SIZE; address++) {
+        int heat = profiler_level(profiler->addresses[address]) * 765 / hottest;
+        uint8_t pixel[3] = {
+            heat > 255 ? 255 : heat,
+            heat > 510 ? 255 : (heat > 255 ? heat - 255 : 0),
+            heat > 510 ? heat - 510 : 0
+        };
+        fwrite(pixel, sizeof(uint8_t), sizeof(pixel), f);
+    }
+    return ferror(f) ? PROFILER_WRITE_FAILED : PROFILER_SUCCESS;
+}
@@ -0,0 +1,182 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/rewind.h"
+
+// longest delta: literal runs only end at REWIND_GAP equal bytes, which pays for the next run's lengths
+#define REWIND_DELTA_MAX (SNAPSHOT_SIZE + 16)
+#define REWIND_GAP 8
+
+rewind_t *rewind_create(uint32_t bytes, uint32_t frames)
+{
+    rewind_t *rw = malloc(sizeof(rewind_t));
+    if (rw == NULL) {
+        return NULL;
+    }
+    rw->size = (bytes > 2 * REWIND_DELTA_MAX) ? bytes : 2 * REWIND_DELTA_MAX;
+    rw->capacity = (frames > 1) ? frames : 1;
+    rw->ring = malloc(rw->size);
+    rw->entries = malloc(sizeof(rewind_entry_t) * rw->capacity);
+    if (rw->ring == NULL || rw->entries == NULL) {
+        free(rw->ring);
+        free(rw->entries);
+        free(rw);
+        return NULL;
+    }
+    rewind_clear(rw);
+    return rw;
+}
+
+void rewind_destroy(rewind_t **rw)
+{
+    free((*rw)->ring);
+    free((*rw)->entries);
+    free(*rw);
+    *rw = NULL;
+}
+
+void rewind_clear(rewind_t *rw)
+{
+    rw->tail = rw->first = rw->count = 0;
+    rw->newest = rw->has_newest = 0;
+    memset(rw->states, 0, sizeof(rw->states));
+    rw->sizes[0] = rw->sizes[1] = 0;
+}
+
+static uint8_t *rewind_put(uint8_t *p, uint32_t value)
+{
+    for (; value >= 0x80; value >>= 7) {
+        *p++ = value | 0x80;
+    }
+    *p++ = value;
+    return p;
+}
+
+static uint32_t rewind_get(const uint8_t **p)
+{
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t byte = *(*p)++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (byte < 0x80) return value;
+    }
+}
+
+static int rewind_same_word(const uint8_t *a, const uint8_t *b)
+{
+    uint64_t x, y;
+    memcpy(&x, a, sizeof(x));
+    memcpy(&y, b, sizeof(y));
+    return x == y;
+}
+
+/**
+ * XOR delta of the first size bytes of two states as runs: equal bytes to skip, then changed bytes to flip,
+ * each run length as a 7-bit varint
+ */
+static uint32_t rewind_encode(const uint8_t *older, const uint8_t *newer, uint32_t size, uint8_t *out)
+{
+    uint8_t *p = out;
+    uint32_t i = 0;
+    while (i < size) {
+        uint32_t start = i;
+        while (i + 64 <= size && memcmp(&older[i], &newer[i], 64) == 0) i += 64;
+        while (i + 8 <= size && rewind_same_word(&older[i], &newer[i])) i += 8;
+        while (i < size && older[i] == newer[i]) i++;
+        if (i == size) break;
+        uint32_t literal = i;
+        uint32_t same = 0;
+        while (i < size && same < REWIND_GAP) {
+            same = (older[i] == newer[i]) ? same + 1 : 0;
+            i++;
+        }
+        i -= same;
+        p = rewind_put(p, literal - start);
+        p = rewind_put(p, i - literal);
+        for (uint32_t j = literal; j < i; j++) {
+            *p++ = older[j] ^ newer[j];
+        }
+    }
+    if (p == out) { // an empty run keeps every delta at least one byte long, see rewind_push
+        p = rewind_put(rewind_put(p, 0), 0);
+    }
+    return p - out;
+}
+
+static void rewind_apply(uint8_t *state, const uint8_t *delta, uint32_t length)
+{
+    const uint8_t *p = delta;
+    uint32_t i = 0;
+    while (p < delta + length) {
+        i += rewind_get(&p);
+        uint32_t changed = rewind_get(&p);
+        for (uint32_t j = 0; j < changed; j++) {
+            state[i++] ^= *p++;
+        }
+    }
+}
+
+static rewind_entry_t *rewind_entry(rewind_t *rw, uint32_t index)
+{
+    return &rw->entries[(rw->first + index) % rw->capacity];
+}
+
+static void rewind_drop_oldest(rewind_t *rw)
+{
+    rw->first = (rw->first + 1) % rw->capacity;
+    rw->count--;
+}
+
+void rewind_push(rewind_t *rw, chip8_t *c8)
+{
+    uint8_t *newest = (uint8_t *)rw->states[rw->newest];
+    uint8_t *current = (uint8_t *)rw->states[!rw->newest];
+    uint32_t size = chip8_snapshot_save(c8, current);
+    if (size < rw->sizes[!rw->newest]) { // after a change of profile, the rest of a larger snapshot goes
+        memset(current + size, 0, rw->sizes[!rw->newest] - size);
+    }
+    rw->sizes[!rw->newest] = size;
+    if (rw->has_newest) {
+        if (rw->count == rw->capacity) {
+            rewind_drop_oldest(rw);
+        }
+        if (rw->tail + REWIND_DELTA_MAX > rw->size) {
+            rw->tail = 0;
+        }
+        // deltas since the last wrap end before the tail; older ones in the way of the longest delta go
+        while (rw->count > 0 && rewind_entry(rw, 0)->offset >= rw->tail
+            && rewind_entry(rw, 0)->offset < rw->tail + REWIND_DELTA_MAX) {
+            rewind_drop_oldest(rw);
+        }
+        rewind_entry_t *entry = rewind_entry(rw, rw->count++);
+        entry->offset = rw->tail;
+        entry->size = rw->sizes[rw->newest];
+        entry->length = rewind_encode(newest, current, size > entry->size ? size : entry->size, &rw->ring[rw->tail]);
+        rw->tail += entry->length;
+    }
+    rw->newest = !rw->newest;
+    rw->has_newest = 1;
+}
+
+int rewind_pop(rewind_t *rw, chip8_t *c8)
+{
+    if (rw->count == 0) {
+        return 0;
+    }
+    rewind_entry_t *entry = rewind_entry(rw, --rw->count);
+    uint8_t *newest = (uint8_t *)rw->states[rw->newest];
+    rewind_apply(newest, &rw->ring[entry->offset], entry->length);
+    rw->tail = entry->offset;
+    rw->sizes[rw->newest] = entry->size;
+    chip8_snapshot_load(c8, newest, entry->size);
+    return 1;
+}
+
+uint32_t rewind_bytes(rewind_t *rw)
+{
+    uint32_t bytes = 0;
+    for (uint32_t i = 0; i < rw->count; i++) {
+        bytes += rewind_entry(rw, i)->length;
+    }
+    return bytes;
+}
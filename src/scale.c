@@ -0,0 +1,111 @@
+#include <string.h>
+
+#include "include/scale.h"
+
+// GCC and Clang vector extensions, SSE2 or NEON by default and AVX2 with -mavx2;
+// anything else writes the pixels one by one
+#if defined(__GNUC__) || defined(__clang__)
+#define SCALE_SIMD
+#endif
+
+#ifdef SCALE_SIMD
+// bytes per host vector register, and pixels in one
+#ifdef __AVX2__
+#define SCALE_VECTOR 32
+#else
+#define SCALE_VECTOR 16
+#endif
+#define SCALE_LANES (SCALE_VECTOR / 4)
+
+typedef uint32_t pixels_t __attribute__((vector_size(SCALE_VECTOR), aligned(1)));
+typedef uint8_t glow_t __attribute__((vector_size(SCALE_VECTOR), aligned(1)));
+typedef uint16_t glow_words_t __attribute__((vector_size(SCALE_VECTOR * 2)));
+#endif
+
+// a row of the screen as 32-bit pixels, each one repeated scale times
+static void scale_row(uint32_t *line, const uint8_t *screen, int width, int scale, const uint32_t palette[SCALE_PALETTE])
+{
+    for (int x = 0; x < width; x++, line += scale) {
+        uint32_t color = palette[screen[x]];
+#ifdef SCALE_SIMD
+        if (scale >= SCALE_LANES) {
+            pixels_t run = (pixels_t){ 0 } + color;
+            for (int i = 0; i < scale - SCALE_LANES; i += SCALE_LANES) {
+                *(pixels_t *)(line + i) = run;
+            }
+            // the last vector overlaps the one before it instead of leaving a tail
+            *(pixels_t *)(line + scale - SCALE_LANES) = run;
+            continue;
+        }
+#endif
+        for (int i = 0; i < scale; i++) {
+            line[i] = color;
+        }
+    }
+}
+
+/**
+ * nearest-neighbour upscaling of rows of the screen, a palette index per byte, into 32-bit pixels
+ * pixels: where the first row goes, rows pitch bytes apart
+ * every screen row becomes scale lines of width * scale pixels: the first one is expanded, the others copied
+ */
+void scale_rows(uint8_t *pixels, size_t pitch, const uint8_t *screen, int width, int rows, int scale,
+    const uint32_t palette[SCALE_PALETTE])
+{
+    size_t bytes = (size_t)width * scale * sizeof(uint32_t);
+    for (int y = 0; y < rows; y++, screen += width) {
+        uint8_t *line = pixels + (size_t)y * scale * pitch;
+        scale_row((uint32_t *)line, screen, width, scale, palette);
+        for (int i = 1; i < scale; i++) {
+            memcpy(line + i * pitch, line, bytes);
+        }
+    }
+}
+
+// a lit pixel glows at full brightness in its color, an unlit one fades by decay / 256 of its brightness
+static uint8_t scale_glow(uint8_t glow, uint8_t pixel, uint8_t decay)
+{
+    if (pixel) {
+        return pixel << GLOW_SHIFT | GLOW_FULL;
+    }
+    uint8_t brightness = (glow & GLOW_FULL) * decay >> 8;
+    return brightness ? (glow & ~GLOW_FULL) | brightness : 0;
+}
+
+/**
+ * phosphor persistence: turns the glow of every pixel, a byte each, into the glow after a frame showing the screen,
+ * a color index per byte; returns the rows whose glow changed, a bit each
+ */
+uint64_t scale_phosphor(uint8_t *glow, const uint8_t *screen, int width, int height, uint8_t decay)
+{
+    uint64_t rows = 0;
+    for (int y = 0; y < height; y++, glow += width, screen += width) {
+        int x = 0;
+        uint8_t changed = 0;
+#ifdef SCALE_SIMD
+        const glow_words_t factor = (glow_words_t){ 0 } + decay;
+        glow_t any = { 0 };
+        for (; x + SCALE_VECTOR <= width; x += SCALE_VECTOR) {
+            glow_t old = *(glow_t *)(glow + x), pixel = *(glow_t *)(screen + x);
+            glow_t lit = (glow_t)(pixel != 0);
+            // brightness times decay in word lanes, back to bytes
+            glow_t brightness = __builtin_convertvector(
+                __builtin_convertvector(old & GLOW_FULL, glow_words_t) * factor >> 8, glow_t);
+            glow_t fading = (old & (uint8_t)~GLOW_FULL & (glow_t)(brightness != 0)) | brightness;
+            glow_t next = (lit & (pixel << GLOW_SHIFT | GLOW_FULL)) | (~lit & fading);
+            any |= next ^ old;
+            *(glow_t *)(glow + x) = next;
+        }
+        for (int i = 0; i < SCALE_VECTOR; i++) {
+            changed |= any[i];
+        }
+#endif
+        for (; x < width; x++) {
+            uint8_t next = scale_glow(glow[x], screen[x], decay);
+            changed |= next ^ glow[x];
+            glow[x] = next;
+        }
+        rows |= (uint64_t)(changed != 0) << y;
+    }
+    return rows;
+}
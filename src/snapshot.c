@@ -0,0 +1,200 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/snapshot.h"
+
+// RAM is restored in chunks, only the ones that differ invalidate the decoded and translated code
+#define SNAPSHOT_CHUNK 64
+// RAM a profile can address, the only part of it in its snapshots
+#define SNAPSHOT_RAM(profile) ((PROFILE_QUIRKS(profile) & QUIRK_LONG) ? XO_RAM_SIZE : RAM_SIZE)
+// offsets from the end of RAM of the bytes that could send the instance out of its arrays
+#define SNAPSHOT_SP (PLANES * HIRES_HEIGHT * 16 + 8 + 16 + STACK_SIZE * 2 + 2 + 2)
+#define SNAPSHOT_HIRES (SNAPSHOT_SP + 1 + 1 + 1 + 1 + 2)
+#define SNAPSHOT_PLANE (SNAPSHOT_HIRES + 1 + RPL_SIZE)
+
+static const uint8_t snapshot_magic[4] = { 'C', 'H', '8', 'S' };
+
+static uint8_t *snapshot_put16(uint8_t *p, uint16_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    return p + 2;
+}
+
+static uint8_t *snapshot_put64(uint8_t *p, uint64_t value)
+{
+    snapshot_put16(p, value);
+    snapshot_put16(p + 2, value >> 16);
+    snapshot_put16(p + 4, value >> 32);
+    snapshot_put16(p + 6, value >> 48);
+    return p + 8;
+}
+
+static uint16_t snapshot_get16(const uint8_t **p)
+{
+    uint16_t value = (*p)[0] | (*p)[1] << 8;
+    *p += 2;
+    return value;
+}
+
+// byte by byte in a single expression, which compilers turn into one load on little-endian hosts
+static inline uint64_t snapshot_get64(const uint8_t **p)
+{
+    const uint8_t *b = *p;
+    uint64_t value = (uint64_t)b[0] | (uint64_t)b[1] << 8 | (uint64_t)b[2] << 16 | (uint64_t)b[3] << 24
+        | (uint64_t)b[4] << 32 | (uint64_t)b[5] << 40 | (uint64_t)b[6] << 48 | (uint64_t)b[7] << 56;
+    *p += 8;
+    return value;
+}
+
+size_t chip8_snapshot_size(profile_t profile)
+{
+    return SNAPSHOT_HEADER + SNAPSHOT_RAM(profile) + SNAPSHOT_STATE;
+}
+
+size_t chip8_snapshot_save(chip8_t *c8, uint8_t *buffer)
+{
+    uint8_t *p = buffer;
+    memcpy(p, snapshot_magic, sizeof(snapshot_magic));
+    p = snapshot_put16(p + sizeof(snapshot_magic), SNAPSHOT_VERSION);
+    *p++ = c8->PROFILE;
+    *p++ = 0;
+    memcpy(p, c8->RAM, sizeof(uint8_t) * SNAPSHOT_RAM(c8->PROFILE));
+    p += SNAPSHOT_RAM(c8->PROFILE);
+    for (int plane = 0; plane < PLANES; plane++) {
+        for (int y = 0; y < HIRES_HEIGHT; y++) {
+            p = snapshot_put64(p, c8->SCREEN[plane][y][0]);
+            p = snapshot_put64(p, c8->SCREEN[plane][y][1]);
+        }
+    }
+    p = snapshot_put64(p, c8->RNG);
+    memcpy(p, c8->V, sizeof(uint8_t) * 16);
+    p += 16;
+    for (int i = 0; i < STACK_SIZE; i++) {
+        p = snapshot_put16(p, c8->STACK[i]);
+    }
+    p = snapshot_put16(p, c8->I);
+    p = snapshot_put16(p, c8->PC);
+    *p++ = c8->SP;
+    *p++ = c8->DT;
+    *p++ = c8->ST;
+    *p++ = c8->RF;
+    uint16_t keys = 0;
+    for (int i = 0; i < 16; i++) {
+        keys |= (c8->KEYBOARD[i] != 0) << i;
+    }
+    p = snapshot_put16(p, keys);
+    *p++ = c8->HIRES;
+    memcpy(p, c8->RPL, sizeof(uint8_t) * RPL_SIZE);
+    p += RPL_SIZE;
+    *p++ = c8->PLANE;
+    memcpy(p, c8->PATTERN, sizeof(uint8_t) * PATTERN_SIZE);
+    p += PATTERN_SIZE;
+    *p++ = c8->PITCH;
+    *p++ = c8->AUDIO;
+    return p - buffer;
+}
+
+snapshot_res_t chip8_snapshot_load(chip8_t *c8, const uint8_t *buffer, size_t size)
+{
+    // check everything before touching the instance
+    if (size < SNAPSHOT_HEADER) {
+        return SNAPSHOT_TRUNCATED;
+    }
+    if (memcmp(buffer, snapshot_magic, sizeof(snapshot_magic)) != 0) {
+        return SNAPSHOT_BAD_MAGIC;
+    }
+    const uint8_t *p = buffer + sizeof(snapshot_magic);
+    if (snapshot_get16(&p) != SNAPSHOT_VERSION) {
+        return SNAPSHOT_BAD_VERSION;
+    }
+    profile_t profile = *p;
+    if (profile >= PROFILE_COUNT) {
+        return SNAPSHOT_CORRUPT;
+    }
+    if (size < chip8_snapshot_size(profile)) {
+        return SNAPSHOT_TRUNCATED;
+    }
+    p += 2;
+    int ram = SNAPSHOT_RAM(profile);
+    const uint8_t *state = p + ram;
+    if (state[SNAPSHOT_SP] > STACK_SIZE || state[SNAPSHOT_HIRES] > 1 || state[SNAPSHOT_PLANE] >= 1 << PLANES) {
+        return SNAPSHOT_CORRUPT;
+    }
+
+    if (c8->PROFILE != profile) {
+        chip8_profile(c8, profile);
+    }
+    if (memcmp(c8->RAM, p, ram) != 0) {
+        for (int chunk = 0; chunk < ram; chunk += SNAPSHOT_CHUNK) {
+            if (memcmp(&c8->RAM[chunk], p + chunk, SNAPSHOT_CHUNK) != 0) {
+                memcpy(&c8->RAM[chunk], p + chunk, SNAPSHOT_CHUNK);
+                chip8_invalidate(c8, chunk, SNAPSHOT_CHUNK);
+            }
+        }
+    }
+    p += ram;
+    for (int plane = 0; plane < PLANES; plane++) {
+        for (int y = 0; y < HIRES_HEIGHT; y++) {
+            c8->SCREEN[plane][y][0] = snapshot_get64(&p);
+            c8->SCREEN[plane][y][1] = snapshot_get64(&p);
+        }
+    }
+    c8->RNG = snapshot_get64(&p);
+    memcpy(c8->V, p, sizeof(uint8_t) * 16);
+    p += 16;
+    for (int i = 0; i < STACK_SIZE; i++) {
+        c8->STACK[i] = snapshot_get16(&p);
+    }
+    c8->I = snapshot_get16(&p);
+    c8->PC = snapshot_get16(&p);
+    c8->SP = *p++;
+    c8->DT = *p++;
+    c8->ST = *p++;
+    c8->RF = *p++;
+    c8->DIRTY = ALL_ROWS;
+    uint16_t keys = snapshot_get16(&p);
+    for (int i = 0; i < 16; i++) {
+        c8->KEYBOARD[i] = keys >> i & 1;
+    }
+    c8->HIRES = *p++;
+    memcpy(c8->RPL, p, sizeof(uint8_t) * RPL_SIZE);
+    p += RPL_SIZE;
+    c8->PLANE = *p++;
+    memcpy(c8->PATTERN, p, sizeof(uint8_t) * PATTERN_SIZE);
+    p += PATTERN_SIZE;
+    c8->PITCH = *p++;
+    c8->AUDIO = *p++;
+    return SNAPSHOT_SUCCESS;
+}
+
+// the files go through a buffer on the heap, a snapshot is larger than some stacks (64 KB with emscripten)
+snapshot_res_t chip8_snapshot_write(chip8_t *c8, FILE *f)
+{
+    if (f == NULL) {
+        return SNAPSHOT_NOT_EXISTS;
+    }
+    uint8_t *buffer = malloc(SNAPSHOT_SIZE);
+    if (buffer == NULL) {
+        return SNAPSHOT_NO_MEMORY;
+    }
+    size_t size = chip8_snapshot_save(c8, buffer);
+    snapshot_res_t result = fwrite(buffer, sizeof(uint8_t), size, f) == size ? SNAPSHOT_SUCCESS : SNAPSHOT_WRITE_FAILED;
+    free(buffer);
+    return result;
+}
+
+snapshot_res_t chip8_snapshot_read(chip8_t *c8, FILE *f)
+{
+    if (f == NULL) {
+        return SNAPSHOT_NOT_EXISTS;
+    }
+    uint8_t *buffer = malloc(SNAPSHOT_SIZE);
+    if (buffer == NULL) {
+        return SNAPSHOT_NO_MEMORY;
+    }
+    size_t size = fread(buffer, sizeof(uint8_t), SNAPSHOT_SIZE, f);
+    snapshot_res_t result = chip8_snapshot_load(c8, buffer, size);
+    free(buffer);
+    return result;
+}
@@ -0,0 +1,321 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/chip8.h"
+#include "include/threaded.h"
+
+// GCC and Clang support labels as values, anything else falls back to a switch
+#if defined(__GNUC__) || defined(__clang__)
+#define THREADED_DISPATCH
+#endif
+
+#ifdef THREADED_DISPATCH
+#define TARGET(oc) target_##oc:
+#define DISPATCH() goto *targets[inst->OC]
+#else
+#define TARGET(oc) case oc:
+#define DISPATCH() goto dispatch
+#endif
+
+// fetch the next predecoded instruction, then jump straight to its handler
+#define NEXT() \
+    do { \
+        if (pc >= RAM_SIZE - 1) goto slow; \
+        if (n == count) goto done; \
+        inst = &c8->DECODED[pc]; \
+        if (!c8->DECODED_VALID[pc]) goto miss; \
+        pc += 2; \
+        n++; \
+        DISPATCH(); \
+    } while (0)
+
+// hand the instruction over to the reference interpreter
+#define GENERIC() \
+    do { \
+        c8->PC = pc; \
+        result = chip8_execute(c8, inst); \
+        pc = c8->PC; \
+        if (result != EXEC_SUCCESS) goto done; \
+        NEXT(); \
+    } while (0)
+
+exec_res_t chip8_threaded_run(chip8_t *c8, uint32_t count, uint32_t *executed)
+{
+#ifdef THREADED_DISPATCH
+    static const void *targets[OC_COUNT] = {
+        [OC_UNKNOWN] = &&target_OC_UNKNOWN, [OC_NOP] = &&target_OC_NOP, [OC_CLS] = &&target_OC_CLS,
+        [OC_RET] = &&target_OC_RET, [OC_JP] = &&target_OC_JP, [OC_CALL] = &&target_OC_CALL,
+        [OC_SE_VX_NN] = &&target_OC_SE_VX_NN, [OC_SNE_VX_NN] = &&target_OC_SNE_VX_NN,
+        [OC_SE_VX_VY] = &&target_OC_SE_VX_VY, [OC_LD_VX_NN] = &&target_OC_LD_VX_NN,
+        [OC_ADD_VX_NN] = &&target_OC_ADD_VX_NN, [OC_LD_VX_VY] = &&target_OC_LD_VX_VY, [OC_OR] = &&target_OC_OR,
+        [OC_AND] = &&target_OC_AND, [OC_XOR] = &&target_OC_XOR, [OC_ADD_VX_VY] = &&target_OC_ADD_VX_VY,
+        [OC_SUB] = &&target_OC_SUB, [OC_SHR] = &&target_OC_SHR, [OC_SUBN] = &&target_OC_SUBN,
+        [OC_SHL] = &&target_OC_SHL, [OC_SNE_VX_VY] = &&target_OC_SNE_VX_VY, [OC_LD_I] = &&target_OC_LD_I,
+        [OC_JP_V0] = &&target_OC_JP_V0, [OC_RND] = &&target_OC_RND, [OC_DRW] = &&target_OC_DRW,
+        [OC_SKP] = &&target_OC_SKP, [OC_SKNP] = &&target_OC_SKNP, [OC_LD_VX_DT] = &&target_OC_LD_VX_DT,
+        [OC_LD_VX_K] = &&target_OC_LD_VX_K, [OC_LD_DT_VX] = &&target_OC_LD_DT_VX,
+        [OC_LD_ST_VX] = &&target_OC_LD_ST_VX, [OC_ADD_I_VX] = &&target_OC_ADD_I_VX,
+        [OC_LD_F_VX] = &&target_OC_LD_F_VX, [OC_LD_B_VX] = &&target_OC_LD_B_VX,
+        [OC_LD_I_VX] = &&target_OC_LD_I_VX, [OC_LD_VX_I] = &&target_OC_LD_VX_I,
+        [OC_OR_KEEP] = &&target_OC_OR_KEEP, [OC_AND_KEEP] = &&target_OC_AND_KEEP,
+        [OC_XOR_KEEP] = &&target_OC_XOR_KEEP, [OC_SHR_VX] = &&target_OC_SHR_VX, [OC_SHL_VX] = &&target_OC_SHL_VX,
+        [OC_LD_VX_I_X] = &&target_OC_LD_VX_I_X, [OC_LD_VX_I_KEEP] = &&target_OC_LD_VX_I_KEEP,
+        [OC_JP_VX] = &&target_OC_JP_VX, [OC_SCD] = &&target_OC_SCD, [OC_SCR] = &&target_OC_SCR,
+        [OC_SCL] = &&target_OC_SCL, [OC_LOW] = &&target_OC_LOW, [OC_HIGH] = &&target_OC_HIGH,
+        [OC_LD_HF_VX] = &&target_OC_LD_HF_VX, [OC_LD_R_VX] = &&target_OC_LD_R_VX, [OC_LD_VX_R] = &&target_OC_LD_VX_R,
+        [OC_SAVE] = &&target_OC_SAVE, [OC_LOAD] = &&target_OC_LOAD, [OC_LD_I_LONG] = &&target_OC_LD_I_LONG,
+        [OC_PLANE] = &&target_OC_PLANE, [OC_AUDIO] = &&target_OC_AUDIO, [OC_PITCH] = &&target_OC_PITCH,
+        [OC_SKIP_LONG] = &&target_OC_SKIP_LONG,
+    };
+#endif
+    exec_res_t result = EXEC_SUCCESS;
+    uint8_t *V = c8->V;
+    uint16_t pc = c8->PC;
+    uint32_t n = 0;
+    instruction_t *inst;
+
+    NEXT();
+
+miss: // decode on the first visit of an address
+    chip8_decode(c8->RAM[pc] << 8 | c8->RAM[pc + 1], inst);
+    chip8_specialize(inst, c8->PROFILE);
+    c8->DECODED_VALID[pc] = 1;
+    pc += 2;
+    n++;
+    DISPATCH();
+
+slow: // PC left RAM or the opcode straddles its end
+    if (pc >= RAM_SIZE) {
+        pc = START_ADDRESS;
+        result = PC_OVERFLOW;
+        goto done;
+    }
+    if (n == count) goto done;
+    c8->PC = pc;
+    result = chip8_cycle(c8);
+    pc = c8->PC;
+    n++;
+    if (result != EXEC_SUCCESS) goto done;
+    NEXT();
+
+#ifndef THREADED_DISPATCH
+dispatch:
+    switch (inst->OC) {
+#endif
+    TARGET(OC_NOP) {
+        NEXT();
+    }
+    TARGET(OC_RET) {
+        if (c8->SP == 0) {
+            result = STACK_UNDERFLOW;
+            goto done;
+        }
+        c8->SP--;
+        pc = c8->STACK[c8->SP];
+        NEXT();
+    }
+    TARGET(OC_JP) {
+        pc = inst->NNN;
+        NEXT();
+    }
+    TARGET(OC_CALL) {
+        if (c8->SP == STACK_SIZE) {
+            result = STACK_OVERFLOW;
+            goto done;
+        }
+        c8->STACK[c8->SP] = pc;
+        c8->SP++;
+        pc = inst->NNN;
+        NEXT();
+    }
+    TARGET(OC_SE_VX_NN) {
+        if (V[inst->X] == inst->NN) pc += 2;
+        NEXT();
+    }
+    TARGET(OC_SNE_VX_NN) {
+        if (V[inst->X] != inst->NN) pc += 2;
+        NEXT();
+    }
+    TARGET(OC_SE_VX_VY) {
+        if (V[inst->X] == V[inst->Y]) pc += 2;
+        NEXT();
+    }
+    TARGET(OC_LD_VX_NN) {
+        V[inst->X] = inst->NN;
+        NEXT();
+    }
+    TARGET(OC_ADD_VX_NN) {
+        V[inst->X] += inst->NN;
+        NEXT();
+    }
+    TARGET(OC_LD_VX_VY) {
+        V[inst->X] = V[inst->Y];
+        NEXT();
+    }
+    TARGET(OC_OR) {
+        V[inst->X] |= V[inst->Y];
+        V[0xF] = 0;
+        NEXT();
+    }
+    TARGET(OC_AND) {
+        V[inst->X] &= V[inst->Y];
+        V[0xF] = 0;
+        NEXT();
+    }
+    TARGET(OC_XOR) {
+        V[inst->X] ^= V[inst->Y];
+        V[0xF] = 0;
+        NEXT();
+    }
+    TARGET(OC_OR_KEEP) {
+        V[inst->X] |= V[inst->Y];
+        NEXT();
+    }
+    TARGET(OC_AND_KEEP) {
+        V[inst->X] &= V[inst->Y];
+        NEXT();
+    }
+    TARGET(OC_XOR_KEEP) {
+        V[inst->X] ^= V[inst->Y];
+        NEXT();
+    }
+    TARGET(OC_ADD_VX_VY) {
+        int sum = V[inst->X] + V[inst->Y];
+        V[inst->X] = sum;
+        V[0xF] = sum > 255;
+        NEXT();
+    }
+    TARGET(OC_SUB) {
+        uint8_t flag = V[inst->X] >= V[inst->Y];
+        V[inst->X] -= V[inst->Y];
+        V[0xF] = flag;
+        NEXT();
+    }
+    TARGET(OC_SHR) {
+        uint8_t bit = V[inst->Y] & 1;
+        V[inst->X] = V[inst->Y] >> 1;
+        V[0xF] = bit;
+        NEXT();
+    }
+    TARGET(OC_SUBN) {
+        uint8_t flag = V[inst->Y] >= V[inst->X];
+        V[inst->X] = V[inst->Y] - V[inst->X];
+        V[0xF] = flag;
+        NEXT();
+    }
+    TARGET(OC_SHL) {
+        uint8_t bit = V[inst->Y] >> 7;
+        V[inst->X] = V[inst->Y] << 1;
+        V[0xF] = bit;
+        NEXT();
+    }
+    TARGET(OC_SHR_VX) {
+        uint8_t bit = V[inst->X] & 1;
+        V[inst->X] >>= 1;
+        V[0xF] = bit;
+        NEXT();
+    }
+    TARGET(OC_SHL_VX) {
+        uint8_t bit = V[inst->X] >> 7;
+        V[inst->X] <<= 1;
+        V[0xF] = bit;
+        NEXT();
+    }
+    TARGET(OC_SNE_VX_VY) {
+        if (V[inst->X] != V[inst->Y]) pc += 2;
+        NEXT();
+    }
+    TARGET(OC_LD_I) {
+        c8->I = inst->NNN;
+        NEXT();
+    }
+    TARGET(OC_JP_V0) {
+        pc = inst->NNN + V[0];
+        NEXT();
+    }
+    TARGET(OC_JP_VX) {
+        pc = inst->NNN + V[inst->X];
+        NEXT();
+    }
+    TARGET(OC_SKP) {
+        if (c8->KEYBOARD[V[inst->X]]) pc += 2;
+        NEXT();
+    }
+    TARGET(OC_SKNP) {
+        if (!c8->KEYBOARD[V[inst->X]]) pc += 2;
+        NEXT();
+    }
+    TARGET(OC_LD_VX_DT) {
+        V[inst->X] = c8->DT;
+        NEXT();
+    }
+    TARGET(OC_LD_DT_VX) {
+        c8->DT = V[inst->X];
+        NEXT();
+    }
+    TARGET(OC_LD_ST_VX) {
+        c8->ST = V[inst->X];
+        NEXT();
+    }
+    TARGET(OC_ADD_I_VX) {
+        c8->I += V[inst->X];
+        NEXT();
+    }
+    TARGET(OC_LD_F_VX) {
+        c8->I = FONTSET_ADDRESS + V[inst->X] * FONT_OFFSET;
+        NEXT();
+    }
+    TARGET(OC_LD_VX_I) {
+        for (int i = 0; i <= inst->X; i++) {
+            V[i] = c8->RAM[c8->I++ & c8->RAM_MASK];
+        }
+        NEXT();
+    }
+    TARGET(OC_LD_VX_I_X) {
+        for (int i = 0; i <= inst->X; i++) {
+            V[i] = c8->RAM[(c8->I + i) & c8->RAM_MASK];
+        }
+        c8->I += inst->X;
+        NEXT();
+    }
+    TARGET(OC_LD_VX_I_KEEP) {
+        for (int i = 0; i <= inst->X; i++) {
+            V[i] = c8->RAM[(c8->I + i) & c8->RAM_MASK];
+        }
+        NEXT();
+    }
+    // rare, heavy or RAM writing instructions
+    TARGET(OC_CLS)
+    TARGET(OC_RND)
+    TARGET(OC_DRW)
+    TARGET(OC_LD_VX_K)
+    TARGET(OC_LD_B_VX)
+    TARGET(OC_LD_I_VX)
+    TARGET(OC_SCD)
+    TARGET(OC_SCR)
+    TARGET(OC_SCL)
+    TARGET(OC_LOW)
+    TARGET(OC_HIGH)
+    TARGET(OC_LD_HF_VX)
+    TARGET(OC_LD_R_VX)
+    TARGET(OC_LD_VX_R)
+    TARGET(OC_SAVE)
+    TARGET(OC_LOAD)
+    TARGET(OC_LD_I_LONG)
+    TARGET(OC_PLANE)
+    TARGET(OC_AUDIO)
+    TARGET(OC_PITCH)
+    TARGET(OC_SKIP_LONG)
+    TARGET(OC_UNKNOWN) {
+        GENERIC();
+    }
+#ifndef THREADED_DISPATCH
+        default: GENERIC();
+    }
+#endif
+
+done:
+    c8->PC = pc;
+    if (executed) *executed = n;
+    return result;
+}
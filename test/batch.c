@@ -0,0 +1,128 @@
+/**
+ * Tests for the work-stealing pool and the runs of the batch runner.
+ */
+
+#define BATCH_NO_MAIN
+#include "../lib/acutest.h"
+#include "../src/chip8.c"
+#include "../src/threaded.c"
+#include "../src/block.c"
+#include "../src/jit.c"
+#include "../src/lockstep.c"
+#include "../tools/batch.c"
+
+#define POOL_JOBS 1000
+
+static void count_job(void *context, uint32_t job)
+{
+    uint32_t *counts = context;
+    __atomic_add_fetch(&counts[job], 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * every job runs exactly once, with more or fewer workers than jobs
+ */
+void test_pool_jobs(void)
+{
+    uint32_t job_counts[] = { 0, 1, 3, 17, POOL_JOBS };
+    uint32_t *counts = malloc(sizeof(uint32_t) * POOL_JOBS);
+    for (int j = 0; j < 5; j++) {
+        for (uint32_t workers = 1; workers <= 8; workers++) {
+            memset(counts, 0, sizeof(uint32_t) * POOL_JOBS);
+            pool_run(workers, job_counts[j], count_job, counts);
+            int once = 1;
+            for (uint32_t i = 0; i < POOL_JOBS; i++) {
+                once &= counts[i] == (i < job_counts[j]);
+            }
+            TEST_CHECK_(once, "%u jobs on %u workers", job_counts[j], workers);
+        }
+    }
+    free(counts);
+}
+
+/**
+ * the same ROMs and seeds give the same results on every engine and thread count
+ */
+void test_batch_engines(void)
+{
+    char *roms[] = { "rom/ibm.ch8", "rom/test/corax+.ch8", "rom/test/flags.ch8", "rom/test/keypad.ch8", "rom/outlaw.ch8" };
+    engine_t engines[] = { ENGINE_SWITCH, ENGINE_THREADED, ENGINE_BLOCK, ENGINE_JIT, ENGINE_SWITCH };
+    job_t expected[15];
+    for (int e = 0; e < 5; e++) {
+        // three runs of each ROM, the last configuration runs them in lockstep
+        batch_t b = { .frames = 120, .ipf = 30, .engine = engines[e], .lockstep = e == 4, .job_count = 15 };
+        b.jobs = calloc(b.job_count, sizeof(job_t));
+        for (uint32_t i = 0; i < b.job_count; i++) {
+            b.jobs[i].rom_path = roms[i / 3];
+            b.jobs[i].seed = i % 3;
+        }
+        batch_plan(&b);
+        TEST_CHECK(b.unit_count == (b.lockstep ? 5 : 15));
+        pool_run(e + 1, b.unit_count, batch_work, &b);
+        for (uint32_t i = 0; i < b.job_count; i++) {
+            job_t *job = &b.jobs[i];
+            char *rom = roms[i / 3];
+            TEST_CHECK_(job->load == ROM_LOAD_SUCCESS && job->result == EXEC_SUCCESS, "%s engine %d", rom, e);
+            TEST_CHECK_(job->frames == 120 && job->instructions == 120 * 30, "%s engine %d counts", rom, e);
+            if (e == 0) {
+                expected[i] = *job;
+            } else {
+                TEST_CHECK_(job->screen_hash == expected[i].screen_hash, "%s engine %d screen", rom, e);
+                TEST_CHECK_(job->pc == expected[i].pc, "%s engine %d PC", rom, e);
+            }
+        }
+        free(b.units);
+        free(b.jobs);
+    }
+    // outlaw draws random numbers, so every seed ends up differently
+    TEST_CHECK(expected[12].screen_hash != expected[13].screen_hash && expected[13].screen_hash != expected[14].screen_hash);
+}
+
+/**
+ * lockstep groups hold the runs of a single ROM, up to LOCKSTEP_LANES of them
+ */
+void test_batch_plan(void)
+{
+    job_t jobs[LOCKSTEP_LANES + 3];
+    for (int i = 0; i < LOCKSTEP_LANES + 3; i++) {
+        jobs[i].rom_path = (i < LOCKSTEP_LANES + 2) ? "a" : "b";
+    }
+    batch_t b = { .jobs = jobs, .job_count = LOCKSTEP_LANES + 3, .lockstep = 1 };
+    batch_plan(&b);
+    TEST_CHECK(b.unit_count == 3);
+    TEST_CHECK(b.units[0] == 0 && b.units[1] == LOCKSTEP_LANES && b.units[2] == LOCKSTEP_LANES + 2);
+    TEST_CHECK(b.units[3] == LOCKSTEP_LANES + 3);
+    free(b.units);
+}
+
+/**
+ * missing ROMs and execution errors end up in the results
+ */
+void test_batch_errors(void)
+{
+    FILE *f = fopen("bin/test/batch-error.ch8", "wb");
+    uint8_t program[] = { 0x00, 0xEE };
+    fwrite(program, sizeof(uint8_t), sizeof(program), f);
+    fclose(f);
+
+    for (int lockstep = 0; lockstep < 2; lockstep++) {
+        job_t jobs[2] = { { .rom_path = "bin/test/missing.ch8" }, { .rom_path = "bin/test/batch-error.ch8" } };
+        batch_t b = { .jobs = jobs, .job_count = 2, .frames = 10, .ipf = 9, .engine = ENGINE_SWITCH, .lockstep = lockstep };
+        batch_plan(&b);
+        pool_run(2, b.unit_count, batch_work, &b);
+        TEST_CHECK_(jobs[0].load == ROM_NOT_EXISTS && jobs[0].frames == 0, "lockstep %d", lockstep);
+        TEST_CHECK_(jobs[1].load == ROM_LOAD_SUCCESS, "lockstep %d", lockstep);
+        TEST_CHECK_(jobs[1].result == STACK_UNDERFLOW && jobs[1].frames == 1, "lockstep %d", lockstep);
+        TEST_CHECK_(jobs[1].instructions == 1 && jobs[1].pc == START_ADDRESS + 2, "lockstep %d", lockstep);
+        free(b.units);
+    }
+    remove("bin/test/batch-error.ch8");
+}
+
+TEST_LIST = {
+    { "work-stealing pool runs every job once", test_pool_jobs },
+    { "batch runs agree across engines", test_batch_engines },
+    { "lockstep groups", test_batch_plan },
+    { "batch errors", test_batch_errors },
+    { NULL, NULL }
+};
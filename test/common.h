@@ -0,0 +1,27 @@
+/**
+ * Helpers of the tests that run the bundled ROMs, included after acutest and the sources under test.
+ */
+
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+// a reset instance with the ROM loaded
+chip8_t *load(char *path)
+{
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    FILE *rom = fopen(path, "rb");
+    TEST_CHECK_(chip8_load_rom(c8, rom) == ROM_LOAD_SUCCESS, "%s", path);
+    if (rom) fclose(rom);
+    return c8;
+}
+
+// the same with the random numbers of CXNN from a seed, to reproduce a run
+chip8_t *load_seeded(char *path, uint64_t seed)
+{
+    chip8_t *c8 = load(path);
+    chip8_seed(c8, seed);
+    return c8;
+}
+
+#endif
@@ -0,0 +1,95 @@
+/**
+ * Tests for the predecoded instruction cache used by cycles.
+ */
+
+#include "../lib/acutest.h"
+#include "../src/chip8.c"
+
+/**
+ * cycle decodes once and reuses the cached instruction
+ */
+void test_cycle_cached(void)
+{
+    uint8_t data[] = { 0x70, 0x01, 0x12, 0x00 };
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_ramcpy(c8, data, 4);
+    TEST_CHECK(c8->DECODED_VALID[START_ADDRESS] == 0);
+    for (int i = 0; i < 10; i++) {
+        TEST_CHECK(chip8_cycle(c8) == EXEC_SUCCESS);
+    }
+    TEST_CHECK(c8->V[0] == 5);
+    TEST_CHECK(c8->PC == START_ADDRESS);
+    TEST_CHECK(c8->DECODED_VALID[START_ADDRESS] == 1);
+    TEST_CHECK(c8->DECODED_VALID[START_ADDRESS + 2] == 1);
+    TEST_CHECK(c8->DECODED[START_ADDRESS].OP == 0x7001);
+    TEST_CHECK(c8->DECODED[START_ADDRESS + 2].NNN == 0x200);
+    chip8_destroy(&c8);
+}
+
+/**
+ * copying bytes into RAM invalidates the cache
+ */
+void test_cycle_ramcpy(void)
+{
+    uint8_t data[] = { 0x60, 0x01 };
+    uint8_t patch[] = { 0x60, 0x02 };
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_ramcpy(c8, data, 2);
+    chip8_cycle(c8);
+    TEST_CHECK(c8->V[0] == 1);
+    chip8_ramcpy(c8, patch, 2);
+    TEST_CHECK(c8->DECODED_VALID[START_ADDRESS] == 0);
+    c8->PC = START_ADDRESS;
+    chip8_cycle(c8);
+    TEST_CHECK(c8->V[0] == 2);
+    chip8_destroy(&c8);
+}
+
+/**
+ * self-modifying code through FX33 and FX55
+ */
+void test_cycle_self_modifying(void)
+{
+    // V0 = 0x62, V1 = 0x2A, I = 0x208, store V0-V1 as 0x622A
+    uint8_t data[] = { 0x60, 0x62, 0x61, 0x2A, 0xA2, 0x08, 0xF1, 0x55, 0x00, 0x00, 0x12, 0x08 };
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_ramcpy(c8, data, 12);
+    c8->PC = START_ADDRESS + 8;
+    chip8_cycle(c8);
+    TEST_CHECK(c8->DECODED_VALID[START_ADDRESS + 8] == 1);
+    c8->PC = START_ADDRESS;
+    for (int i = 0; i < 4; i++) {
+        chip8_cycle(c8);
+    }
+    TEST_CHECK(c8->DECODED_VALID[START_ADDRESS + 7] == 0);
+    TEST_CHECK(c8->DECODED_VALID[START_ADDRESS + 8] == 0);
+    TEST_CHECK(c8->DECODED_VALID[START_ADDRESS + 9] == 0);
+    TEST_CHECK(c8->PC == START_ADDRESS + 8);
+    chip8_cycle(c8);
+    TEST_CHECK(c8->V[2] == 0x2A);
+    TEST_CHECK(c8->PC == START_ADDRESS + 10);
+
+    // BCD of 97 over the instruction at 0x20A
+    c8->I = START_ADDRESS + 9;
+    c8->V[2] = 97;
+    c8->PC = START_ADDRESS + 10;
+    chip8_cycle(c8);
+    TEST_CHECK(c8->PC == START_ADDRESS + 8);
+    instruction_t inst;
+    chip8_decode(0xF233, &inst);
+    chip8_execute(c8, &inst);
+    TEST_CHECK(c8->DECODED_VALID[START_ADDRESS + 10] == 0);
+    TEST_CHECK(c8->RAM[START_ADDRESS + 10] == 9);
+    TEST_CHECK(c8->RAM[START_ADDRESS + 11] == 7);
+    chip8_destroy(&c8);
+}
+
+TEST_LIST = {
+    { "cycle reuses predecoded instruction", test_cycle_cached },
+    { "copying bytes invalidates cache", test_cycle_ramcpy },
+    { "FX33 and FX55 invalidate cache", test_cycle_self_modifying },
+    { NULL, NULL }
+};
@@ -0,0 +1,413 @@
+/**
+ * Tests for the alternative execution engines against chip8_cycle.
+ */
+
+#include "../lib/acutest.h"
+#include "../src/chip8.c"
+#include "../src/threaded.c"
+#include "../src/block.c"
+#include "../src/jit.c"
+#include "common.h"
+
+#define FRAMES 600
+#define ENGINE_IPF 50
+#define RANDOM_PROGRAMS 200
+#define RANDOM_CYCLES 2000
+
+typedef exec_res_t (*engine_run_t)(chip8_t *c8, uint32_t count, uint32_t *executed);
+
+block_cache_t *cache;
+jit_t *jit;
+chip8_t *cache_owner;
+
+char *roms[] = {
+    "rom/animal-race.ch8", "rom/blitz.ch8", "rom/bowling.ch8", "rom/ibm.ch8", "rom/kaleidoscope.ch8",
+    "rom/lunar-lander.ch8", "rom/merlin.ch8", "rom/outlaw.ch8", "rom/slipperyslope.ch8",
+    "rom/test/beep.ch8", "rom/test/chip8-logo.ch8", "rom/test/corax+.ch8", "rom/test/flags.ch8",
+    "rom/test/keypad.ch8", "rom/test/quirks.ch8", NULL
+};
+
+void press(chip8_t *c8, int frame)
+{
+    memset(c8->KEYBOARD, 0, sizeof(uint8_t) * 16);
+    if (frame % 20 < 10) {
+        c8->KEYBOARD[(frame / 20) % 16] = 1;
+    }
+}
+
+int check_same(chip8_t *expected, chip8_t *actual, char *path, int frame)
+{
+    int same = 1;
+    same &= TEST_CHECK_(expected->PC == actual->PC, "%s frame %d: PC %X != %X", path, frame, expected->PC, actual->PC);
+    same &= TEST_CHECK_(expected->I == actual->I, "%s frame %d: I", path, frame);
+    same &= TEST_CHECK_(expected->SP == actual->SP, "%s frame %d: SP", path, frame);
+    same &= TEST_CHECK_(expected->DT == actual->DT && expected->ST == actual->ST, "%s frame %d: timers", path, frame);
+    same &= TEST_CHECK_(memcmp(expected->V, actual->V, sizeof(expected->V)) == 0, "%s frame %d: V", path, frame);
+    same &= TEST_CHECK_(memcmp(expected->STACK, actual->STACK, sizeof(expected->STACK)) == 0, "%s frame %d: stack", path, frame);
+    same &= TEST_CHECK_(memcmp(expected->RAM, actual->RAM, sizeof(expected->RAM)) == 0, "%s frame %d: RAM", path, frame);
+    same &= TEST_CHECK_(memcmp(expected->SCREEN, actual->SCREEN, sizeof(expected->SCREEN)) == 0, "%s frame %d: screen", path, frame);
+    return same;
+}
+
+/**
+ * run every ROM frame by frame on both interpreters and compare the state
+ */
+void compare_engine(engine_run_t run)
+{
+    for (int r = 0; roms[r] != NULL; r++) {
+        chip8_t *expected = load(roms[r]);
+        chip8_t *actual = load(roms[r]);
+        for (int frame = 0; frame < FRAMES; frame++) {
+            press(expected, frame);
+            press(actual, frame);
+            chip8_tick(expected);
+            chip8_tick(actual);
+            for (int i = 0; i < ENGINE_IPF; i++) {
+                chip8_cycle(expected);
+            }
+            uint32_t executed;
+            for (uint32_t i = 0; i < ENGINE_IPF; i += executed) {
+                run(actual, ENGINE_IPF - i, &executed);
+            }
+            if (!check_same(expected, actual, roms[r], frame)) break;
+        }
+        chip8_destroy(&expected);
+        chip8_destroy(&actual);
+        cache_owner = NULL; // the next instance may get the same address
+    }
+}
+
+/**
+ * random opcode from the ALU, skip, memory, timer, drawing and SUPER-CHIP instructions
+ */
+uint16_t random_opcode(void)
+{
+    static const uint16_t alu[] = { 0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0xE };
+    static const uint16_t fx[] = { 0x01, 0x07, 0x15, 0x18, 0x1E, 0x29, 0x30, 0x33, 0x3A, 0x55, 0x65, 0x75, 0x85 };
+    static const uint16_t xy[] = { 0x5000, 0x5002, 0x5003, 0x9000 };
+    static const uint16_t screen[] = { 0x00FB, 0x00FC, 0x00FE, 0x00FF, 0xF000, 0xF002 };
+    uint16_t x = rand() % 16 << 8, y = rand() % 16 << 4, nn = rand() % 256;
+    switch (rand() % 10) {
+        case 0: return 0x6000 | x | nn;
+        case 1: return 0x7000 | x | nn;
+        case 2:
+        case 3: return 0x8000 | x | y | alu[rand() % 9];
+        case 4: return (rand() % 2 ? 0x3000 : 0x4000) | x | nn;
+        case 5: return xy[rand() % 4] | x | y;
+        case 6: return 0xA300 | nn;
+        case 7: return (rand() % 2 ? 0xC000 : 0xD000) | x | (rand() % 2 ? nn : y | 5);
+        case 8: return rand() % 2 ? 0x00C0 | rand() % 16 : screen[rand() % 6];
+        default: return 0xF000 | x | fx[rand() % 13];
+    }
+}
+
+/**
+ * run random looping programs on both interpreters with the quirks of a profile and compare the state
+ */
+void compare_random(engine_run_t run, profile_t profile)
+{
+    uint8_t data[256];
+    for (int p = 0; p < RANDOM_PROGRAMS; p++) {
+        srand(p);
+        for (int i = 0; i < 254; i += 2) {
+            uint16_t op = random_opcode();
+            data[i] = op >> 8;
+            data[i + 1] = op & 0xFF;
+        }
+        data[254] = 0x12;
+        data[255] = 0x00;
+        chip8_t *expected = chip8_create();
+        chip8_t *actual = chip8_create();
+        chip8_reset(expected);
+        chip8_reset(actual);
+        chip8_profile(expected, profile);
+        chip8_profile(actual, profile);
+        chip8_ramcpy(expected, data, 255);
+        chip8_ramcpy(actual, data, 255);
+        expected->RAM[START_ADDRESS + 255] = actual->RAM[START_ADDRESS + 255] = data[255];
+        for (int i = 0; i < 16; i++) {
+            expected->V[i] = actual->V[i] = rand() % 256;
+        }
+
+        for (int i = 0; i < RANDOM_CYCLES; i++) {
+            chip8_cycle(expected);
+        }
+        uint32_t executed;
+        for (uint32_t i = 0; i < RANDOM_CYCLES; i += executed) {
+            run(actual, (RANDOM_CYCLES - i < 97) ? RANDOM_CYCLES - i : 97, &executed);
+        }
+        int same = check_same(expected, actual, "random program", p);
+        chip8_destroy(&expected);
+        chip8_destroy(&actual);
+        cache_owner = NULL; // the next instance may get the same address
+        if (!same) break;
+    }
+}
+
+exec_res_t block_engine(chip8_t *c8, uint32_t count, uint32_t *executed)
+{
+    if (cache_owner != c8) { // a translation cache belongs to a single interpreter
+        block_cache_flush(cache);
+        cache_owner = c8;
+    }
+    return block_run(cache, c8, count, executed);
+}
+
+exec_res_t jit_engine(chip8_t *c8, uint32_t count, uint32_t *executed)
+{
+    if (cache_owner != c8) {
+        if (jit) jit_flush(jit);
+        cache_owner = c8;
+    }
+    return jit_run(jit, c8, count, executed);
+}
+
+/**
+ * batch results
+ */
+void test_threaded_batch(void)
+{
+    // V0 += 1, jump back
+    uint8_t data[] = { 0x70, 0x01, 0x12, 0x00 };
+    uint32_t executed;
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_ramcpy(c8, data, 4);
+    TEST_CHECK(chip8_threaded_run(c8, 101, &executed) == EXEC_SUCCESS);
+    TEST_CHECK(executed == 101);
+    TEST_CHECK(c8->V[0] == 51);
+    TEST_CHECK(c8->PC == START_ADDRESS + 2);
+    chip8_destroy(&c8);
+}
+
+/**
+ * errors stop the batch
+ */
+void test_threaded_error(void)
+{
+    uint8_t data[] = { 0x70, 0x01, 0x00, 0xEE };
+    uint32_t executed;
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_ramcpy(c8, data, 4);
+    TEST_CHECK(chip8_threaded_run(c8, 10, &executed) == STACK_UNDERFLOW);
+    TEST_CHECK(executed == 2);
+    TEST_CHECK(c8->PC == START_ADDRESS + 4);
+    chip8_destroy(&c8);
+}
+
+/**
+ * threaded engine versus chip8_cycle
+ */
+void test_threaded_roms(void)
+{
+    compare_engine(chip8_threaded_run);
+}
+
+/**
+ * blocks end at jumps, calls, skips and FX0A
+ */
+void test_block_translate(void)
+{
+    // V0 = 1, V1 = 2, skip if V0 == 1, jump, wait for key, call
+    uint8_t data[] = { 0x60, 0x01, 0x61, 0x02, 0x30, 0x01, 0x12, 0x00, 0xF0, 0x0A, 0x22, 0x00 };
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_ramcpy(c8, data, 12);
+    cache = block_cache_create();
+    block_t *b = block_translate(cache, c8, START_ADDRESS);
+    TEST_CHECK(b->length == 3);
+    TEST_CHECK(b->end == START_ADDRESS + 6);
+    TEST_CHECK(b->exit[0] == START_ADDRESS + 6 && b->exit[1] == START_ADDRESS + 8);
+    b = block_translate(cache, c8, START_ADDRESS + 6);
+    TEST_CHECK(b->length == 1 && b->exit[0] == START_ADDRESS);
+    b = block_translate(cache, c8, START_ADDRESS + 8);
+    TEST_CHECK(b->length == 1 && b->end == START_ADDRESS + 10);
+    TEST_CHECK(c8->CODE[START_ADDRESS] && c8->CODE[START_ADDRESS + 9] && !c8->CODE[START_ADDRESS + 10]);
+    block_cache_destroy(&cache);
+    chip8_destroy(&c8);
+}
+
+/**
+ * chained blocks and invalidation of overwritten ones only
+ */
+void test_block_chain_invalidate(void)
+{
+    // 0x200: V0 += 1, skip if V0 != 3, jump 0x20A, jump 0x200
+    // 0x20A: I = 0x220, V0 = 0x12, V1 = 0x0A, store V0-V1, V2 += 1, jump 0x220
+    // 0x220: jump 0x212, rewritten to jump 0x20A by the store
+    uint8_t data[] = {
+        0x70, 0x01, 0x40, 0x03, 0x12, 0x0A, 0x12, 0x00, 0x00, 0x00,
+        0xA2, 0x20, 0x60, 0x12, 0x61, 0x0A, 0xF1, 0x55, 0x72, 0x01, 0x12, 0x20,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x12, 0x12
+    };
+    uint32_t executed;
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_ramcpy(c8, data, sizeof(data));
+    cache = block_cache_create();
+
+    c8->PC = START_ADDRESS + 0x20;
+    TEST_CHECK(block_run(cache, c8, 3, &executed) == EXEC_SUCCESS);
+    TEST_CHECK(c8->V[2] == 1 && c8->PC == START_ADDRESS + 0x20);
+    block_t *target = cache->map[START_ADDRESS + 0x20];
+    TEST_CHECK(target != NULL && target->valid);
+
+    c8->PC = START_ADDRESS;
+    TEST_CHECK(block_run(cache, c8, 9, &executed) == EXEC_SUCCESS);
+    TEST_CHECK(executed == 9);
+    TEST_CHECK(c8->V[0] == 3 && c8->PC == START_ADDRESS + 0x0A);
+    block_t *loop = cache->map[START_ADDRESS];
+    block_t *back = cache->map[START_ADDRESS + 6];
+    TEST_CHECK(loop->next[1] == back);
+    TEST_CHECK(back->next[0] == loop);
+
+    TEST_CHECK(block_run(cache, c8, 100, &executed) == EXEC_SUCCESS);
+    TEST_CHECK(c8->RAM[START_ADDRESS + 0x21] == 0x0A);
+    TEST_CHECK(c8->V[2] > 10);
+    TEST_CHECK(!target->valid);
+    TEST_CHECK(loop->valid && cache->map[START_ADDRESS] == loop);
+    TEST_CHECK(back->valid && loop->next[1] == back);
+    block_cache_destroy(&cache);
+    chip8_destroy(&c8);
+}
+
+/**
+ * block engine versus chip8_cycle
+ */
+void test_block_roms(void)
+{
+    cache = block_cache_create();
+    compare_engine(block_engine);
+    block_cache_destroy(&cache);
+}
+
+/**
+ * block engine versus chip8_cycle on random programs
+ */
+void test_block_random(void)
+{
+    cache = block_cache_create();
+    compare_random(block_engine, PROFILE_VIP);
+    block_cache_destroy(&cache);
+}
+
+/**
+ * hot blocks get compiled, overwritten ones go back to the interpreter
+ */
+void test_jit_compile(void)
+{
+    // 0x200: V0 += 1, skip if V0 != 0x20, jump 0x20A, jump 0x200
+    // 0x20A: I = 0x202, V0 = 0x40, V1 = 0x10, store V0-V1, jump 0x200
+    uint8_t data[] = {
+        0x70, 0x01, 0x40, 0x20, 0x12, 0x0A, 0x12, 0x00, 0x00, 0x00,
+        0xA2, 0x02, 0x60, 0x40, 0x61, 0x10, 0xF1, 0x55, 0x12, 0x00
+    };
+    uint32_t executed;
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_ramcpy(c8, data, sizeof(data));
+    jit = jit_create();
+#ifdef JIT_X64
+    TEST_ASSERT(jit != NULL);
+
+    TEST_CHECK(jit_run(jit, c8, 3 * 0x1F, &executed) == EXEC_SUCCESS);
+    TEST_CHECK(executed == 3 * 0x1F);
+    TEST_CHECK(c8->V[0] == 0x1F && c8->PC == START_ADDRESS);
+    block_t *loop = jit->blocks->map[START_ADDRESS];
+    TEST_CHECK(loop != NULL && loop->native != NULL);
+
+    // the store turns "skip if V0 != 0x20" into "skip if V0 != 0x10"
+    TEST_CHECK(jit_run(jit, c8, 8, &executed) == EXEC_SUCCESS);
+    TEST_CHECK(c8->RAM[START_ADDRESS + 3] == 0x10 && c8->PC == START_ADDRESS);
+    TEST_CHECK(jit->smc[START_ADDRESS + 2] && jit->smc[START_ADDRESS + 3]);
+    TEST_CHECK(jit_run(jit, c8, 200, &executed) == EXEC_SUCCESS);
+    TEST_CHECK(jit->blocks->map[START_ADDRESS]->native == NULL);
+    TEST_CHECK(c8->V[0] == 0x40 + (200 - 2) / 3 || c8->V[0] == 0x40 + (200 - 2) / 3 + 1);
+#endif
+    chip8_destroy(&c8);
+    if (jit) jit_destroy(&jit);
+}
+
+/**
+ * errors leave compiled blocks with the interpreter's state
+ */
+void test_jit_error(void)
+{
+    // V0 += 1, call 0x200 until the stack overflows
+    uint8_t data[] = { 0x70, 0x01, 0x22, 0x00 };
+    uint32_t executed;
+    chip8_t *expected = chip8_create();
+    chip8_t *actual = chip8_create();
+    chip8_reset(expected);
+    chip8_reset(actual);
+    chip8_ramcpy(expected, data, 4);
+    chip8_ramcpy(actual, data, 4);
+    jit = jit_create();
+    exec_res_t result;
+    do {
+        result = chip8_cycle(expected);
+    } while (result == EXEC_SUCCESS);
+    TEST_CHECK(jit_run(jit, actual, 1000, &executed) == STACK_OVERFLOW);
+    TEST_CHECK(executed == 2 * (STACK_SIZE + 1));
+    check_same(expected, actual, "call overflow", 0);
+    chip8_destroy(&expected);
+    chip8_destroy(&actual);
+    if (jit) jit_destroy(&jit);
+}
+
+/**
+ * JIT engine versus chip8_cycle on random programs
+ */
+void test_jit_random(void)
+{
+    jit = jit_create();
+    cache_owner = NULL;
+    compare_random(jit_engine, PROFILE_VIP);
+    if (jit) jit_destroy(&jit);
+}
+
+/**
+ * JIT engine versus chip8_cycle
+ */
+void test_jit_roms(void)
+{
+    jit = jit_create();
+    cache_owner = NULL;
+    compare_engine(jit_engine);
+    if (jit) jit_destroy(&jit);
+}
+
+/**
+ * every engine versus chip8_cycle on random programs with the quirks of the other profiles
+ */
+void test_profiles_random(void)
+{
+    cache = block_cache_create();
+    for (profile_t p = PROFILE_CHIP48; p < PROFILE_COUNT; p++) {
+        compare_random(chip8_threaded_run, p);
+        cache_owner = NULL;
+        compare_random(block_engine, p);
+        jit = jit_create();
+        cache_owner = NULL;
+        compare_random(jit_engine, p);
+        if (jit) jit_destroy(&jit);
+    }
+    block_cache_destroy(&cache);
+}
+
+TEST_LIST = {
+    { "threaded batch", test_threaded_batch },
+    { "threaded error", test_threaded_error },
+    { "threaded engine runs ROMs like chip8_cycle", test_threaded_roms },
+    { "block translation", test_block_translate },
+    { "block chaining and invalidation", test_block_chain_invalidate },
+    { "block engine runs ROMs like chip8_cycle", test_block_roms },
+    { "block engine runs random programs like chip8_cycle", test_block_random },
+    { "JIT compiles hot blocks and drops overwritten ones", test_jit_compile },
+    { "JIT errors", test_jit_error },
+    { "JIT engine runs random programs like chip8_cycle", test_jit_random },
+    { "JIT engine runs ROMs like chip8_cycle", test_jit_roms },
+    { "engines run random programs like chip8_cycle under every profile", test_profiles_random },
+    { NULL, NULL }
+};
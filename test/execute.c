@@ -86,7 +86,7 @@ void test_0x0000(void)
     TEST_CHECK(sum == 0);
     for (int i = 0; i < SCREEN_WIDTH; i++) {
         for (int j = 0; j < SCREEN_HEIGHT; j++) {
-            sum += c8->SCREEN[i][j];
+            sum += chip8_pixel(c8, i, j);
         }
     }
     TEST_CHECK(sum == 0);
@@ -109,16 +109,18 @@ void test_0x00E0(void)
     chip8_reset(c8);
     chip8_ramcpy(c8, data, 2);
 
-    memset(c8->SCREEN, 1, sizeof(uint8_t) * SCREEN_WIDTH * SCREEN_HEIGHT);
+    // every pixel of both planes and of the 128x64 mode lit, both planes selected
+    memset(c8->SCREEN, 0xFF, sizeof(c8->SCREEN));
+    c8->PLANE = (1 << PLANES) - 1;
 
     chip8_decode(chip8_fetch(c8), &inst);
     result = chip8_execute(c8, &inst);
     TEST_CHECK(result == EXEC_SUCCESS);
     TEST_CHECK(c8->RF == 1);
     int sum = 0;
-    for (int i = 0; i < SCREEN_WIDTH; i++) {
-        for (int j = 0; j < SCREEN_HEIGHT; j++) {
-            sum += c8->SCREEN[i][j];
+    for (int i = 0; i < HIRES_WIDTH; i++) {
+        for (int j = 0; j < HIRES_HEIGHT; j++) {
+            sum += chip8_pixel(c8, i, j);
         }
     }
     TEST_CHECK(sum == 0);
@@ -721,23 +723,62 @@ void test_0xBNNN(void)
  */
 void test_0xCXNN(void)
 {
-    srand(time(NULL));
     uint8_t data[] = { 0xCA, 0xC8, 0xCA, 0xC8 };
     instruction_t inst;
     exec_res_t result;
     chip8_t *c8 = chip8_create();
     chip8_reset(c8);
+    chip8_seed(c8, 42);
     chip8_ramcpy(c8, data, 4);
     TEST_CHECK(c8->V[0xA] == 0);
     chip8_decode(chip8_fetch(c8), &inst);
     result = chip8_execute(c8, &inst);
     TEST_CHECK(result == EXEC_SUCCESS);
-    TEST_CHECK(c8->V[0xA] >= 0 && c8->V[0xA] <= 255);
+    uint8_t first = c8->V[0xA];
+    TEST_CHECK((first & ~0xC8) == 0);
     chip8_decode(chip8_fetch(c8), &inst);
     result = chip8_execute(c8, &inst);
     TEST_CHECK(result == EXEC_SUCCESS);
-    TEST_CHECK(c8->V[0xA] >= 0 && c8->V[0xA] <= 255);
+    TEST_CHECK((c8->V[0xA] & ~0xC8) == 0);
+    uint8_t second = c8->V[0xA];
+
+    // the same seed gives the same numbers
+    chip8_seed(c8, 42);
+    c8->PC = START_ADDRESS;
+    chip8_decode(chip8_fetch(c8), &inst);
+    chip8_execute(c8, &inst);
+    TEST_CHECK(c8->V[0xA] == first);
+    chip8_decode(chip8_fetch(c8), &inst);
+    chip8_execute(c8, &inst);
+    TEST_CHECK(c8->V[0xA] == second);
+    chip8_destroy(&c8);
+}
+
+/**
+ * every seed, 0 too, gives its own evenly spread numbers
+ */
+void test_random_seed(void)
+{
+    chip8_t *c8 = chip8_create();
+    chip8_t *other = chip8_create();
+    chip8_reset(c8);
+    chip8_reset(other);
+    chip8_seed(other, 1);
+    uint32_t counts[256] = { 0 };
+    int same = 0;
+    for (int i = 0; i < 256 * 64; i++) {
+        uint8_t n = chip8_random(c8);
+        counts[n]++;
+        same += n == chip8_random(other);
+    }
+    int spread = 1;
+    for (int n = 0; n < 256; n++) {
+        spread &= counts[n] > 32 && counts[n] < 96;
+    }
+    TEST_CHECK(spread);
+    TEST_CHECK(same < 256);
     chip8_destroy(&c8);
+    chip8_destroy(&other);
 }
 
 /**
@@ -760,7 +801,7 @@ void test_0xDXYN_00(void)
     for (int row = 0; row < inst.N; row++) {
         int pattern = 0;
         for (int col = 0; col < 8; col++) {
-            pattern |= (c8->SCREEN[col][row] << (7 - col));
+            pattern |= (chip8_pixel(c8, col, row) << (7 - col));
         }
         TEST_CHECK(pattern == c8->RAM[(START_ADDRESS + 2) + row]);
     }
@@ -791,7 +832,7 @@ void test_0xDXYN_XY_erase(void)
     for (int row = 0; row < inst.N && row + Y < SCREEN_HEIGHT; row++) {
         int pattern = 0;
         for (int col = 0; col < 8 && col + X < SCREEN_WIDTH; col++) {
-            pattern |= (c8->SCREEN[col + X][row + Y] << (7 - col));
+            pattern |= (chip8_pixel(c8, col + X, row + Y) << (7 - col));
         }
         uint8_t original_pattern = c8->RAM[(START_ADDRESS + 2) + row];
         TEST_CHECK(pattern == original_pattern);
@@ -805,7 +846,7 @@ void test_0xDXYN_XY_erase(void)
     int sum = 0;
     for (int i = 0; i < SCREEN_WIDTH; i++) {
         for (int j = 0; j < SCREEN_HEIGHT; j++) {
-            sum += c8->SCREEN[i][j];
+            sum += chip8_pixel(c8, i, j);
         }
     }
     TEST_CHECK(sum == 0);
@@ -866,7 +907,7 @@ void test_0xDXYN_wrap_and_clip(void)
     for (int row = 0; row < inst.N && row + Y < SCREEN_HEIGHT; row++) {
         uint8_t pattern = 0;
         for (int col = 0; col < 8 && col + X < SCREEN_WIDTH; col++) {
-            pattern |= (c8->SCREEN[col + X][row + Y] << (7 - col));
+            pattern |= (chip8_pixel(c8, col + X, row + Y) << (7 - col));
         }
         uint8_t original_pattern = c8->RAM[(START_ADDRESS + 2) + row];
         uint8_t mask = 0xFF << (8 + X - SCREEN_WIDTH);
@@ -876,6 +917,85 @@ void test_0xDXYN_wrap_and_clip(void)
     chip8_destroy(&c8);
 }
 
+/**
+ * packed screen rows and their byte per pixel view
+ */
+void test_0xDXYN_packed_rows(void)
+{
+    uint8_t data[] = { 0xDA, 0xB1, 0xFF };
+    uint8_t bytes[SCREEN_HEIGHT][SCREEN_WIDTH];
+    instruction_t inst;
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_ramcpy(c8, data, 3);
+    c8->I = 0x202;
+    c8->V[0xA] = 60;
+    c8->V[0xB] = 3;
+    chip8_decode(chip8_fetch(c8), &inst);
+    TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    TEST_CHECK(c8->SCREEN[0][3][0] == 0xF);
+    TEST_CHECK(c8->SCREEN[0][2][0] == 0 && c8->SCREEN[0][4][0] == 0);
+    chip8_screen_bytes(c8, (uint8_t *)bytes);
+    TEST_CHECK(bytes[3][59] == 0 && bytes[3][60] == 1 && bytes[3][63] == 1);
+    TEST_CHECK(bytes[2][60] == 0 && bytes[3][0] == 0);
+    chip8_destroy(&c8);
+}
+
+/**
+ * drawing marks the rows it covers as dirty, clearing and resolution changes all of them
+ */
+void test_0xDXYN_dirty_rows(void)
+{
+    uint8_t data[] = { 0xDA, 0xB3, 0x00, 0xE0, 0x00, 0xFF, 0xDA, 0xB3, 0xFF, 0xFF, 0xFF };
+    uint8_t bytes[SCREEN_HEIGHT][SCREEN_WIDTH];
+    instruction_t inst;
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    TEST_CHECK(c8->DIRTY == ALL_ROWS);
+    chip8_ramcpy(c8, data, sizeof(data));
+    c8->I = 0x208;
+    c8->V[0xA] = 0;
+    c8->V[0xB] = 30;
+
+    // wrapping around the bottom with xochip, clipped with vip
+    c8->DIRTY = 0;
+    chip8_profile(c8, PROFILE_XOCHIP);
+    chip8_decode(chip8_fetch(c8), &inst);
+    chip8_specialize(&inst, c8->PROFILE);
+    TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    TEST_CHECK_(c8->DIRTY == (3ULL << 30 | 1ULL), "%016llx", (unsigned long long)c8->DIRTY);
+    c8->DIRTY = 0;
+    c8->PC = START_ADDRESS;
+    chip8_profile(c8, PROFILE_VIP);
+    chip8_decode(chip8_fetch(c8), &inst);
+    chip8_specialize(&inst, c8->PROFILE);
+    TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    TEST_CHECK(c8->DIRTY == 3ULL << 30);
+
+    // only the dirty rows are written
+    memset(bytes, 0xAA, sizeof(bytes));
+    chip8_screen_rows(c8, (uint8_t *)bytes, 1ULL << 0);
+    TEST_CHECK(bytes[0][0] == 1 && bytes[0][8] == 0);
+    TEST_CHECK(bytes[30][0] == 0xAA && bytes[1][0] == 0xAA);
+
+    c8->DIRTY = 0;
+    chip8_decode(chip8_fetch(c8), &inst);
+    TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    TEST_CHECK(c8->DIRTY == ALL_ROWS);
+
+    // rows of the 128x64 mode, wrapping around at 64
+    chip8_profile(c8, PROFILE_XOCHIP);
+    chip8_decode(chip8_fetch(c8), &inst);
+    TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    c8->DIRTY = 0;
+    c8->V[0xB] = 62;
+    chip8_decode(chip8_fetch(c8), &inst);
+    chip8_specialize(&inst, c8->PROFILE);
+    TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    TEST_CHECK(c8->DIRTY == (3ULL << 62 | 1ULL));
+    chip8_destroy(&c8);
+}
+
 /**
  * skip if VX key pressed
  */
@@ -1151,6 +1271,441 @@ void test_0xFX65(void)
     chip8_destroy(&c8);
 }
 
+/**
+ * 128x64 mode on and off, both clear the screen
+ */
+void test_0x00FF_0x00FE(void)
+{
+    uint8_t data[] = { 0x00, 0xFF, 0x00, 0xFE };
+    instruction_t inst;
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_profile(c8, PROFILE_SCHIP);
+    chip8_ramcpy(c8, data, 4);
+    TEST_CHECK(chip8_width(c8) == SCREEN_WIDTH && chip8_height(c8) == SCREEN_HEIGHT);
+    c8->SCREEN[0][0][0] = 1;
+    chip8_decode(chip8_fetch(c8), &inst);
+    TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    TEST_CHECK(c8->HIRES && chip8_width(c8) == HIRES_WIDTH && chip8_height(c8) == HIRES_HEIGHT);
+    TEST_CHECK(c8->SCREEN[0][0][0] == 0 && c8->RF == 1);
+    c8->SCREEN[0][63][1] = 1;
+    chip8_decode(chip8_fetch(c8), &inst);
+    TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    TEST_CHECK(!c8->HIRES && c8->SCREEN[0][63][1] == 0);
+    chip8_destroy(&c8);
+}
+
+/**
+ * 16x16 sprite across the words of a 128 pixel row, clipped or wrapped at the right edge
+ */
+void test_0xDXY0(void)
+{
+    uint8_t data[] = { 0xD0, 0x10 };
+    instruction_t inst;
+    chip8_t *c8 = chip8_create();
+    for (profile_t p = PROFILE_SCHIP; p <= PROFILE_XOCHIP; p++) {
+        chip8_reset(c8);
+        chip8_profile(c8, p);
+        chip8_ramcpy(c8, data, 2);
+        c8->HIRES = 1;
+        for (int i = 0; i < 32; i++) {
+            c8->RAM[0x300 + i] = (i % 2) ? 0x01 : 0x80; // a box edge on both sides
+        }
+        c8->I = 0x300;
+        c8->V[0] = 56;
+        c8->V[1] = 60;
+        chip8_decode(chip8_fetch(c8), &inst);
+        TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+        TEST_CHECK(chip8_pixel(c8, 56, 60) && chip8_pixel(c8, 71, 63) && !chip8_pixel(c8, 57, 60));
+        TEST_CHECK(c8->SCREEN[0][60][0] == 0x80 && c8->SCREEN[0][60][1] == 1ULL << 56);
+        int wrap = p == PROFILE_XOCHIP;
+        TEST_CHECK_(chip8_pixel(c8, 56, 0) == wrap && chip8_pixel(c8, 71, 11) == wrap, "%s", profile_names[p]);
+        TEST_CHECK(c8->V[0xF] == 0);
+
+        // the same sprite at the right edge
+        c8->PC = START_ADDRESS;
+        c8->V[0] = 120;
+        c8->V[1] = 0;
+        chip8_decode(chip8_fetch(c8), &inst);
+        TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+        TEST_CHECK(chip8_pixel(c8, 120, 0) && chip8_pixel(c8, 7, 1) == wrap);
+        TEST_CHECK_(c8->V[0xF] == 0, "%s", profile_names[p]);
+    }
+    chip8_destroy(&c8);
+}
+
+/**
+ * scroll down N rows in both resolutions
+ */
+void test_0x00CN(void)
+{
+    uint8_t data[] = { 0x00, 0xC3 };
+    instruction_t inst;
+    chip8_t *c8 = chip8_create();
+    for (int hires = 0; hires <= 1; hires++) {
+        chip8_reset(c8);
+        chip8_profile(c8, PROFILE_SCHIP);
+        chip8_ramcpy(c8, data, 2);
+        c8->HIRES = hires;
+        int height = chip8_height(c8);
+        c8->SCREEN[0][0][0] = 1;
+        c8->SCREEN[0][height - 4][0] = 2;
+        c8->SCREEN[0][height - 1][0] = 3;
+        chip8_decode(chip8_fetch(c8), &inst);
+        TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+        TEST_CHECK(c8->SCREEN[0][0][0] == 0 && c8->SCREEN[0][3][0] == 1 && c8->SCREEN[0][height - 1][0] == 2);
+        TEST_CHECK_(hires || c8->SCREEN[0][height][0] == 0, "%d rows", height);
+    }
+    chip8_destroy(&c8);
+}
+
+/**
+ * scroll right and left by 4 pixels in both resolutions
+ */
+void test_0x00FB_0x00FC(void)
+{
+    uint8_t data[] = { 0x00, 0xFB, 0x00, 0xFC, 0x00, 0xFC };
+    instruction_t inst;
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_profile(c8, PROFILE_SCHIP);
+    chip8_ramcpy(c8, data, 6);
+    c8->SCREEN[0][5][0] = 0xF00000000000000FULL;
+    chip8_decode(chip8_fetch(c8), &inst);
+    TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    TEST_CHECK(c8->SCREEN[0][5][0] == 0x0F00000000000000ULL && c8->SCREEN[0][5][1] == 0);
+
+    c8->HIRES = 1;
+    c8->SCREEN[0][5][0] = 0xF00000000000000FULL;
+    c8->SCREEN[0][63][1] = 0xF;
+    chip8_decode(chip8_fetch(c8), &inst);
+    TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    TEST_CHECK(c8->SCREEN[0][5][0] == 0xF0 && c8->SCREEN[0][63][1] == 0xF0);
+    c8->SCREEN[0][5][1] = 0xF000000000000000ULL;
+    chip8_decode(chip8_fetch(c8), &inst);
+    TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    TEST_CHECK(c8->SCREEN[0][5][0] == 0xF0F && c8->SCREEN[0][5][1] == 0 && c8->SCREEN[0][63][1] == 0xF00);
+    chip8_destroy(&c8);
+}
+
+/**
+ * set I to the big HEX char at VX
+ */
+void test_0xFX30(void)
+{
+    uint8_t data[] = { 0xF4, 0x30 };
+    instruction_t inst;
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_profile(c8, PROFILE_SCHIP);
+    chip8_ramcpy(c8, data, 2);
+    c8->V[4] = 8;
+    chip8_decode(chip8_fetch(c8), &inst);
+    TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    TEST_CHECK(c8->I == BIG_FONTSET_ADDRESS + 8 * BIG_FONT_OFFSET);
+    TEST_CHECK(c8->RAM[c8->I] == 0x3C && c8->RAM[c8->I + 4] == 0x7E);
+    TEST_CHECK(BIG_FONTSET_ADDRESS + 16 * BIG_FONT_OFFSET <= START_ADDRESS);
+    chip8_destroy(&c8);
+}
+
+/**
+ * store V0-VX in the user flags and load them back
+ */
+void test_0xFX75_0xFX85(void)
+{
+    uint8_t data[] = { 0xF2, 0x75, 0xF7, 0x85 };
+    instruction_t inst;
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_profile(c8, PROFILE_SCHIP);
+    chip8_ramcpy(c8, data, 4);
+    for (int i = 0; i < 16; i++) {
+        c8->V[i] = i + 1;
+    }
+    chip8_decode(chip8_fetch(c8), &inst);
+    TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    TEST_CHECK(c8->RPL[0] == 1 && c8->RPL[2] == 3 && c8->RPL[3] == 0);
+    memset(c8->V, 0xAA, sizeof(c8->V));
+    chip8_decode(chip8_fetch(c8), &inst);
+    TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    TEST_CHECK(c8->V[0] == 1 && c8->V[2] == 3 && c8->V[3] == 0 && c8->V[7] == 0 && c8->V[8] == 0xAA);
+    chip8_destroy(&c8);
+}
+
+/**
+ * without SUPER-CHIP DXY0 draws nothing and the other SUPER-CHIP opcodes are unknown
+ */
+void test_schip_opcodes(void)
+{
+    static const uint16_t opcodes[] = { 0x00C3, 0x00FB, 0x00FC, 0x00FE, 0x00FF, 0xF430, 0xF275, 0xF285 };
+    uint8_t data[] = { 0xD0, 0x10 };
+    instruction_t inst;
+    chip8_t *c8 = chip8_create();
+    for (profile_t p = PROFILE_VIP; p <= PROFILE_CHIP48; p++) {
+        chip8_reset(c8);
+        chip8_profile(c8, p);
+        chip8_ramcpy(c8, data, 2);
+        memset(&c8->RAM[0x300], 0xFF, 32);
+        c8->I = 0x300;
+        c8->V[0xF] = 1;
+        c8->RF = 0;
+        TEST_CHECK(chip8_cycle(c8) == EXEC_SUCCESS);
+        TEST_CHECK_(c8->V[0xF] == 0 && c8->RF == 1 && !chip8_pixel(c8, 0, 0), "%s", profile_names[p]);
+
+        for (size_t i = 0; i < sizeof(opcodes) / sizeof(opcodes[0]); i++) {
+            chip8_decode(opcodes[i], &inst);
+            TEST_CHECK_(chip8_execute(c8, &inst) == UNKNOWN_OPCODE, "%s: %04X", profile_names[p], opcodes[i]);
+            chip8_specialize(&inst, p);
+            TEST_CHECK_(inst.OC == OC_UNKNOWN, "%s: %04X", profile_names[p], opcodes[i]);
+        }
+        TEST_CHECK(!c8->HIRES && c8->I == 0x300);
+    }
+    chip8_destroy(&c8);
+}
+
+/**
+ * store and load a range of registers, in both directions, without touching I
+ */
+void test_0x5XY2_0x5XY3(void)
+{
+    uint8_t data[] = { 0x52, 0x42, 0x57, 0x52, 0x5A, 0xB3, 0x5F, 0xC3 };
+    instruction_t inst;
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_profile(c8, PROFILE_XOCHIP);
+    chip8_ramcpy(c8, data, 8);
+    for (int i = 0; i < 16; i++) {
+        c8->V[i] = i + 1;
+    }
+    c8->I = 0x300;
+    chip8_decode(chip8_fetch(c8), &inst);
+    TEST_CHECK(inst.OC == OC_SAVE && chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    TEST_CHECK(c8->RAM[0x300] == 3 && c8->RAM[0x302] == 5 && c8->RAM[0x303] == 0 && c8->I == 0x300);
+    c8->I = 0x310;
+    chip8_decode(chip8_fetch(c8), &inst);
+    TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    TEST_CHECK(c8->RAM[0x310] == 8 && c8->RAM[0x311] == 7 && c8->RAM[0x312] == 6 && c8->RAM[0x313] == 0);
+
+    c8->I = 0x300;
+    chip8_decode(chip8_fetch(c8), &inst);
+    TEST_CHECK(inst.OC == OC_LOAD && chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    TEST_CHECK(c8->V[0xA] == 3 && c8->V[0xB] == 4 && c8->V[9] == 10 && c8->V[0xC] == 13);
+    c8->I = 0x310;
+    chip8_decode(chip8_fetch(c8), &inst);
+    TEST_CHECK(chip8_execute(c8, &inst) == EXEC_SUCCESS);
+    TEST_CHECK(c8->V[0xF] == 8 && c8->V[0xE] == 7 && c8->V[0xD] == 6 && c8->V[0xC] == 0 && c8->I == 0x310);
+    chip8_destroy(&c8);
+}
+
+/**
+ * I = NNNN from the next opcode, which XO-CHIP skips over as a whole
+ */
+void test_0xF000_NNNN(void)
+{
+    // skip over F000 NNNN, then F000 NNNN
+    uint8_t data[] = { 0x30, 0x00, 0xF0, 0x00, 0xAB, 0xCD, 0xF0, 0x00, 0xE1, 0x23 };
+    static const uint16_t skipped[] = { 0x204, 0x204, 0x204, 0x206 };
+    chip8_t *c8 = chip8_create();
+    for (profile_t p = 0; p < PROFILE_COUNT; p++) {
+        chip8_reset(c8);
+        chip8_profile(c8, p);
+        chip8_ramcpy(c8, data, 10);
+        TEST_CHECK(chip8_cycle(c8) == EXEC_SUCCESS);
+        TEST_CHECK_(c8->PC == skipped[p], "%s: PC %X", profile_names[p], c8->PC);
+        c8->PC = 0x206;
+        if (p != PROFILE_XOCHIP) {
+            TEST_CHECK_(chip8_cycle(c8) == UNKNOWN_OPCODE, "%s", profile_names[p]);
+            continue;
+        }
+        TEST_CHECK(chip8_cycle(c8) == EXEC_SUCCESS);
+        TEST_CHECK(c8->I == 0xE123 && c8->PC == 0x20A);
+    }
+
+    // only F000 itself is a long load
+    instruction_t inst;
+    chip8_decode(0xF100, &inst);
+    TEST_CHECK(inst.OC == OC_UNKNOWN);
+    chip8_decode(0xF000, &inst);
+    TEST_CHECK(inst.OC == OC_LD_I_LONG);
+    chip8_destroy(&c8);
+}
+
+/**
+ * draw to the selected planes, with a sprite per plane, and clear them one by one
+ */
+void test_0xFN01(void)
+{
+    // select plane 2, draw, select both, draw, clear plane 1
+    uint8_t data[] = { 0xF2, 0x01, 0xD0, 0x11, 0xF3, 0x01, 0xD0, 0x11, 0xF1, 0x01, 0x00, 0xE0, 0xC0, 0xA0 };
+    uint8_t bytes[SCREEN_HEIGHT][SCREEN_WIDTH];
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_profile(c8, PROFILE_XOCHIP);
+    chip8_ramcpy(c8, data, 14);
+    c8->I = 0x20C; // C0 for plane 1, A0 for plane 2
+    TEST_CHECK(c8->PLANE == 1);
+    TEST_CHECK(chip8_cycle(c8) == EXEC_SUCCESS && c8->PLANE == 2);
+    TEST_CHECK(chip8_cycle(c8) == EXEC_SUCCESS);
+    TEST_CHECK(c8->SCREEN[0][0][0] == 0 && c8->SCREEN[1][0][0] == 0xC0ULL << 56);
+    TEST_CHECK(chip8_cycle(c8) == EXEC_SUCCESS && c8->PLANE == 3);
+    TEST_CHECK(chip8_cycle(c8) == EXEC_SUCCESS);
+    TEST_CHECK(c8->SCREEN[0][0][0] == 0xC0ULL << 56 && c8->SCREEN[1][0][0] == 0x60ULL << 56);
+    TEST_CHECK(c8->V[0xF] == 1);
+    TEST_CHECK(chip8_pixel(c8, 0, 0) == 1 && chip8_pixel(c8, 1, 0) == 3 && chip8_pixel(c8, 2, 0) == 2);
+    chip8_screen_bytes(c8, (uint8_t *)bytes);
+    TEST_CHECK(bytes[0][0] == 1 && bytes[0][1] == 3 && bytes[0][2] == 2 && bytes[0][3] == 0 && bytes[1][1] == 0);
+
+    TEST_CHECK(chip8_cycle(c8) == EXEC_SUCCESS && chip8_cycle(c8) == EXEC_SUCCESS);
+    TEST_CHECK(c8->SCREEN[0][0][0] == 0 && c8->SCREEN[1][0][0] == 0x60ULL << 56);
+    chip8_destroy(&c8);
+}
+
+/**
+ * load the audio pattern from I and set its pitch
+ */
+void test_0xF002_0xFX3A(void)
+{
+    uint8_t data[] = { 0xF0, 0x02, 0xF5, 0x3A };
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_profile(c8, PROFILE_XOCHIP);
+    chip8_ramcpy(c8, data, 4);
+    TEST_CHECK(c8->PITCH == 64 && !c8->AUDIO);
+    for (int i = 0; i < PATTERN_SIZE; i++) {
+        c8->RAM[0x300 + i] = i * 17;
+    }
+    c8->I = 0x300;
+    c8->V[5] = 112;
+    TEST_CHECK(chip8_cycle(c8) == EXEC_SUCCESS);
+    TEST_CHECK(c8->AUDIO && c8->PATTERN[0] == 0 && c8->PATTERN[15] == 0xFF && c8->I == 0x300);
+    TEST_CHECK(chip8_cycle(c8) == EXEC_SUCCESS);
+    TEST_CHECK(c8->PITCH == 112);
+    chip8_destroy(&c8);
+}
+
+/**
+ * the XO-CHIP opcodes are unknown to the other profiles
+ */
+void test_xochip_opcodes(void)
+{
+    static const uint16_t opcodes[] = { 0x5122, 0x5213, 0xF000, 0xF301, 0xF002, 0xF53A };
+    instruction_t inst;
+    chip8_t *c8 = chip8_create();
+    for (profile_t p = PROFILE_VIP; p < PROFILE_XOCHIP; p++) {
+        chip8_reset(c8);
+        chip8_profile(c8, p);
+        c8->I = 0x300;
+        for (size_t i = 0; i < sizeof(opcodes) / sizeof(opcodes[0]); i++) {
+            chip8_decode(opcodes[i], &inst);
+            TEST_CHECK_(chip8_execute(c8, &inst) == UNKNOWN_OPCODE, "%s: %04X", profile_names[p], opcodes[i]);
+            chip8_specialize(&inst, p);
+            TEST_CHECK_(inst.OC == OC_UNKNOWN, "%s: %04X", profile_names[p], opcodes[i]);
+        }
+        TEST_CHECK(c8->I == 0x300 && c8->PC == START_ADDRESS && c8->PLANE == 1 && !c8->AUDIO && c8->PITCH == 64);
+    }
+    chip8_destroy(&c8);
+}
+
+/**
+ * run a single opcode at START_ADDRESS under a profile
+ */
+exec_res_t run_profile(chip8_t *c8, profile_t profile, uint16_t opcode)
+{
+    instruction_t inst;
+    uint8_t data[] = { opcode >> 8, opcode & 0xFF };
+    chip8_profile(c8, profile);
+    chip8_ramcpy(c8, data, 2);
+    c8->PC = START_ADDRESS;
+    chip8_decode(chip8_fetch(c8), &inst);
+    chip8_specialize(&inst, profile);
+    return chip8_execute(c8, &inst);
+}
+
+/**
+ * quirks of the profiles
+ */
+void test_profiles(void)
+{
+    // VF after OR, VX after SHR, I after store, PC after BXNN
+    static const uint8_t vf[] = { 0, 7, 7, 7 };
+    static const uint8_t shr[] = { 0x20, 0x08, 0x08, 0x20 };
+    static const uint16_t index[] = { 0x404, 0x403, 0x400, 0x404 };
+    static const uint16_t jump[] = { 0x123 + 1, 0x123 + 2, 0x123 + 2, 0x123 + 1 };
+    chip8_t *c8 = chip8_create();
+    for (profile_t p = 0; p < PROFILE_COUNT; p++) {
+        chip8_reset(c8);
+        c8->V[0xF] = 7;
+        c8->V[1] = 0x10;
+        c8->V[2] = 0x40;
+        TEST_CHECK(run_profile(c8, p, 0x8121) == EXEC_SUCCESS);
+        TEST_CHECK_(c8->V[1] == 0x50 && c8->V[0xF] == vf[p], "%s: VF %d", profile_names[p], c8->V[0xF]);
+        c8->V[1] = 0x10;
+        TEST_CHECK(run_profile(c8, p, 0x8126) == EXEC_SUCCESS);
+        TEST_CHECK_(c8->V[1] == shr[p] && c8->V[0xF] == 0, "%s: V1 %X", profile_names[p], c8->V[1]);
+        c8->I = 0x400;
+        TEST_CHECK(run_profile(c8, p, 0xF355) == EXEC_SUCCESS);
+        TEST_CHECK_(c8->I == index[p], "%s: I %X", profile_names[p], c8->I);
+        c8->I = 0x400;
+        TEST_CHECK(run_profile(c8, p, 0xF365) == EXEC_SUCCESS);
+        TEST_CHECK_(c8->I == index[p] && c8->V[2] == 0x40, "%s: I %X", profile_names[p], c8->I);
+        c8->V[0] = 1;
+        c8->V[1] = 2;
+        TEST_CHECK(run_profile(c8, p, 0xB123) == EXEC_SUCCESS);
+        TEST_CHECK_(c8->PC == jump[p], "%s: PC %X", profile_names[p], c8->PC);
+
+        // a sprite over the bottom right corner is clipped or wraps around to the other corners
+        c8->I = FONTSET_ADDRESS; // "0": F0 90 90 90 F0
+        c8->V[3] = 62;
+        c8->V[4] = 30;
+        TEST_CHECK(run_profile(c8, p, 0xD345) == EXEC_SUCCESS);
+        int wrap = !(PROFILE_QUIRKS(p) & QUIRK_CLIP);
+        TEST_CHECK(chip8_pixel(c8, 62, 30) && chip8_pixel(c8, 62, 31));
+        TEST_CHECK_(chip8_pixel(c8, 0, 30) == wrap && chip8_pixel(c8, 62, 0) == wrap
+            && chip8_pixel(c8, 1, 2) == wrap, "%s: wrap", profile_names[p]);
+    }
+    chip8_destroy(&c8);
+}
+
+/**
+ * I reaches 64 KB with XO-CHIP and wraps at 4 KB otherwise
+ */
+void test_xochip_memory(void)
+{
+    chip8_t *c8 = chip8_create();
+    for (profile_t p = 0; p < PROFILE_COUNT; p++) {
+        int xo = p == PROFILE_XOCHIP;
+        chip8_reset(c8);
+        chip8_profile(c8, p);
+        c8->V[0] = 0x5A;
+        c8->V[1] = 0xA5;
+        c8->I = 0xFFFF;
+        TEST_CHECK(run_profile(c8, p, 0xF155) == EXEC_SUCCESS);
+        TEST_CHECK_(c8->RAM[xo ? 0xFFFF : 0xFFF] == 0x5A && c8->RAM[0] == 0xA5 && c8->RAM[0xFFFF] == xo * 0x5A,
+            "%s: store", profile_names[p]);
+        c8->V[0] = c8->V[1] = 0;
+        c8->I = 0xFFFF;
+        TEST_CHECK(run_profile(c8, p, 0xF165) == EXEC_SUCCESS);
+        TEST_CHECK_(c8->V[0] == 0x5A, "%s: load", profile_names[p]);
+        TEST_CHECK(c8->RAM_MASK == (xo ? XO_RAM_SIZE - 1 : RAM_SIZE - 1));
+    }
+
+    // a ROM may fill the whole 64 KB
+    FILE *rom = fopen("bin/test/big.ch8", "w+b");
+    for (int i = START_ADDRESS; i < XO_RAM_SIZE; i++) {
+        fputc(i >> 8, rom);
+    }
+    chip8_reset(c8);
+    rewind(rom);
+    TEST_CHECK(chip8_load_rom(c8, rom) == ROM_TOO_LARGE);
+    chip8_reset(c8);
+    chip8_profile(c8, PROFILE_XOCHIP);
+    rewind(rom);
+    TEST_CHECK(chip8_load_rom(c8, rom) == ROM_LOAD_SUCCESS && c8->RAM[0xFFFF] == 0xFF);
+    fclose(rom);
+    remove("bin/test/big.ch8");
+    chip8_destroy(&c8);
+}
+
 TEST_LIST = {
     { "PC overflow", test_PC_overflow },
     { "unknown opcode", test_unknown_opcode },
@@ -1180,10 +1735,13 @@ TEST_LIST = {
     { "0xANNN - I = NNN", test_0xANNN },
     { "0xBNNN - jump to address NNN + V0", test_0xBNNN },
     { "0xCXNN - VX = random NN", test_0xCXNN },
+    { "random numbers of a seed", test_random_seed },
     { "0xDXYN - draw to (0, 0)", test_0xDXYN_00 },
     { "0xDXYN - draw to (X, Y) and erase", test_0xDXYN_XY_erase },
     { "0xDXYN - collision detection", test_0xDXYN_collision_detection },
     { "0xDXYN - draw with wrap and clip", test_0xDXYN_wrap_and_clip },
+    { "0xDXYN - packed rows", test_0xDXYN_packed_rows },
+    { "0xDXYN - dirty rows", test_0xDXYN_dirty_rows },
     { "0xEX9E - skip if VX key pressed", test_0xEX9E },
     { "0xEXA1 - skip if VX key not pressed", test_0xEXA1 },
     { "0xFX07 - VX = DT", test_0xFX07 },
@@ -1195,5 +1753,19 @@ TEST_LIST = {
     { "0xFX33 - VX BCD", test_0xFX33 },
     { "0xFX55 - store V0-VX", test_0xFX55 },
     { "0xFX65 - load V0-VX", test_0xFX65 },
+    { "0x00FF/0x00FE - 128x64 mode on and off", test_0x00FF_0x00FE },
+    { "0xDXY0 - draw a 16x16 sprite", test_0xDXY0 },
+    { "0x00CN - scroll down N rows", test_0x00CN },
+    { "0x00FB/0x00FC - scroll right and left", test_0x00FB_0x00FC },
+    { "0xFX30 - set I to the big HEX char at VX", test_0xFX30 },
+    { "0xFX75/0xFX85 - store and load the user flags", test_0xFX75_0xFX85 },
+    { "SUPER-CHIP opcodes of other profiles", test_schip_opcodes },
+    { "0x5XY2/0x5XY3 - store and load VX-VY", test_0x5XY2_0x5XY3 },
+    { "0xF000 - I = NNNN", test_0xF000_NNNN },
+    { "0xFN01 - select the planes", test_0xFN01 },
+    { "0xF002/0xFX3A - audio pattern and pitch", test_0xF002_0xFX3A },
+    { "XO-CHIP opcodes of other profiles", test_xochip_opcodes },
+    { "quirks of the profiles", test_profiles },
+    { "64 KB of XO-CHIP memory", test_xochip_memory },
     { NULL, NULL }
 };
@@ -0,0 +1,240 @@
+/**
+ * Tests for the lockstep engine against running every instance with chip8_cycle.
+ */
+
+#include "../lib/acutest.h"
+#include "../src/chip8.c"
+#include "../src/lockstep.c"
+#include "common.h"
+
+#define FRAMES 300
+#define LOCKSTEP_IPF 50
+#define RANDOM_PROGRAMS 50
+#define RANDOM_CYCLES 2000
+
+char *roms[] = {
+    "rom/animal-race.ch8", "rom/blitz.ch8", "rom/bowling.ch8", "rom/ibm.ch8", "rom/kaleidoscope.ch8",
+    "rom/lunar-lander.ch8", "rom/merlin.ch8", "rom/outlaw.ch8", "rom/slipperyslope.ch8", "rom/test/beep.ch8",
+    "rom/test/chip8-logo.ch8", "rom/test/corax+.ch8", "rom/test/flags.ch8", "rom/test/keypad.ch8",
+    "rom/test/quirks.ch8", NULL
+};
+
+// lanes up to 7 press the same keys, the rest press their own
+void press(chip8_t *c8, int lane, int frame)
+{
+    int offset = (lane < 8) ? 0 : lane * 7;
+    memset(c8->KEYBOARD, 0, sizeof(uint8_t) * 16);
+    if ((frame + offset) % 20 < 10) {
+        c8->KEYBOARD[((frame + offset) / 20) % 16] = 1;
+    }
+}
+
+int check_same(chip8_t *expected, chip8_t *actual, char *path, int lane)
+{
+    int same = 1;
+    same &= TEST_CHECK_(expected->PC == actual->PC, "%s lane %d: PC %X != %X", path, lane, expected->PC, actual->PC);
+    same &= TEST_CHECK_(expected->I == actual->I, "%s lane %d: I", path, lane);
+    same &= TEST_CHECK_(expected->SP == actual->SP, "%s lane %d: SP", path, lane);
+    same &= TEST_CHECK_(expected->DT == actual->DT && expected->ST == actual->ST, "%s lane %d: timers", path, lane);
+    same &= TEST_CHECK_(memcmp(expected->V, actual->V, sizeof(expected->V)) == 0, "%s lane %d: V", path, lane);
+    same &= TEST_CHECK_(memcmp(expected->STACK, actual->STACK, sizeof(expected->STACK)) == 0, "%s lane %d: stack", path, lane);
+    same &= TEST_CHECK_(memcmp(expected->RAM, actual->RAM, sizeof(expected->RAM)) == 0, "%s lane %d: RAM", path, lane);
+    same &= TEST_CHECK_(memcmp(expected->SCREEN, actual->SCREEN, sizeof(expected->SCREEN)) == 0, "%s lane %d: screen", path, lane);
+    return same;
+}
+
+/**
+ * lanes with the same and with diverging inputs end up like separate instances
+ */
+void test_lockstep_roms(void)
+{
+    for (int r = 0; roms[r] != NULL; r++) {
+        lockstep_t *ls = lockstep_create();
+        chip8_t *expected[LOCKSTEP_LANES];
+        exec_res_t results[LOCKSTEP_LANES] = { EXEC_SUCCESS };
+        uint32_t executed[LOCKSTEP_LANES];
+        for (int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+            // lanes up to 7 draw the same random numbers too
+            expected[lane] = load(roms[r]);
+            chip8_seed(expected[lane], lane < 8 ? 0 : lane);
+            chip8_t *actual = load(roms[r]);
+            chip8_seed(actual, lane < 8 ? 0 : lane);
+            TEST_CHECK(lockstep_add(ls, actual) == lane);
+        }
+        int same = 1;
+        for (int frame = 0; frame < FRAMES && same; frame++) {
+            for (int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+                press(expected[lane], lane, frame);
+                press(ls->lanes[lane], lane, frame);
+                chip8_tick(expected[lane]);
+                chip8_tick(ls->lanes[lane]);
+                // a lane stops at its first error
+                for (executed[lane] = 0; executed[lane] < LOCKSTEP_IPF && results[lane] == EXEC_SUCCESS; executed[lane]++) {
+                    results[lane] = chip8_cycle(expected[lane]);
+                }
+            }
+            lockstep_run(ls, LOCKSTEP_IPF);
+            for (int lane = 0; lane < LOCKSTEP_LANES && same; lane++) {
+                same &= TEST_CHECK_(ls->executed[lane] == executed[lane], "%s lane %d executed", roms[r], lane);
+                same &= TEST_CHECK_(ls->result[lane] == results[lane], "%s lane %d result", roms[r], lane);
+                same &= check_same(expected[lane], ls->lanes[lane], roms[r], lane);
+            }
+        }
+        TEST_CHECK_(ls->vector_steps > 0, "%s vectorized", roms[r]);
+        for (int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+            chip8_destroy(&expected[lane]);
+            chip8_destroy(&ls->lanes[lane]);
+        }
+        lockstep_destroy(&ls);
+    }
+}
+
+/**
+ * random opcode from the ALU, skip, memory, timer and drawing instructions
+ */
+uint16_t random_opcode(void)
+{
+    static const uint16_t alu[] = { 0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0xE };
+    static const uint16_t fx[] = { 0x07, 0x15, 0x18, 0x1E, 0x29, 0x33, 0x55, 0x65 };
+    uint16_t x = rand() % 16 << 8, y = rand() % 16 << 4, nn = rand() % 256;
+    switch (rand() % 10) {
+        case 0: return 0x6000 | x | nn;
+        case 1: return 0x7000 | x | nn;
+        case 2:
+        case 3: return 0x8000 | x | y | alu[rand() % 9];
+        case 4: return (rand() % 2 ? 0x3000 : 0x4000) | x | nn;
+        case 5: return (rand() % 2 ? 0x5000 : 0x9000) | x | y;
+        case 6: return 0xA300 | nn;
+        case 7: return (rand() % 2 ? 0xC000 : 0xD000) | x | (rand() % 2 ? nn : y | 5);
+        default: return 0xF000 | x | fx[rand() % 8];
+    }
+}
+
+/**
+ * random looping programs from lane specific registers
+ */
+void test_lockstep_random(void)
+{
+    uint8_t data[256];
+    for (int p = 0; p < RANDOM_PROGRAMS; p++) {
+        srand(p);
+        for (int i = 0; i < 254; i += 2) {
+            uint16_t op = random_opcode();
+            data[i] = op >> 8;
+            data[i + 1] = op & 0xFF;
+        }
+        data[254] = 0x12;
+        data[255] = 0x00;
+        lockstep_t *ls = lockstep_create();
+        chip8_t *expected[LOCKSTEP_LANES];
+        for (int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+            chip8_t *actual = chip8_create();
+            expected[lane] = chip8_create();
+            chip8_reset(expected[lane]);
+            chip8_reset(actual);
+            chip8_ramcpy(expected[lane], data, 255);
+            chip8_ramcpy(actual, data, 255);
+            expected[lane]->RAM[START_ADDRESS + 255] = actual->RAM[START_ADDRESS + 255] = data[255];
+            srand(lane < 16 ? p : p * LOCKSTEP_LANES + lane);
+            for (int i = 0; i < 16; i++) {
+                expected[lane]->V[i] = actual->V[i] = rand() % 256;
+            }
+            expected[lane]->DT = actual->DT = lane;
+            chip8_seed(expected[lane], lane % 2);
+            chip8_seed(actual, lane % 2);
+            lockstep_add(ls, actual);
+        }
+
+        int same = 1;
+        for (int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+            for (int i = 0; i < RANDOM_CYCLES && chip8_cycle(expected[lane]) == EXEC_SUCCESS; i++);
+        }
+        for (uint32_t i = 0; i < RANDOM_CYCLES; i += 97) {
+            lockstep_run(ls, (RANDOM_CYCLES - i < 97) ? RANDOM_CYCLES - i : 97);
+        }
+        for (int lane = 0; lane < LOCKSTEP_LANES && same; lane++) {
+            same &= check_same(expected[lane], ls->lanes[lane], "random program", p * 100 + lane);
+        }
+        for (int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+            chip8_destroy(&expected[lane]);
+            chip8_destroy(&ls->lanes[lane]);
+        }
+        lockstep_destroy(&ls);
+        if (!same) break;
+    }
+}
+
+/**
+ * BNNN jumps every lane of a group to its own target, past the end of RAM too
+ */
+void test_lockstep_jump(void)
+{
+    uint8_t program[] = { 0xBF, 0xF0 };
+    uint8_t v0[] = { 0x00, 0x01, 0x0F, 0x10 };
+    lockstep_t *ls = lockstep_create();
+    chip8_t *expected[4];
+    exec_res_t results[4];
+    for (int lane = 0; lane < 4; lane++) {
+        chip8_t *actual = chip8_create();
+        expected[lane] = chip8_create();
+        chip8_reset(expected[lane]);
+        chip8_reset(actual);
+        chip8_ramcpy(expected[lane], program, sizeof(program));
+        chip8_ramcpy(actual, program, sizeof(program));
+        expected[lane]->V[0] = actual->V[0] = v0[lane];
+        results[lane] = chip8_cycle(expected[lane]);
+        lockstep_add(ls, actual);
+    }
+    lockstep_run(ls, 1);
+    TEST_CHECK(ls->vector_steps == 1 && ls->scalar_steps == 0);
+    for (int lane = 0; lane < 4; lane++) {
+        TEST_CHECK_(ls->result[lane] == results[lane], "lane %d result", lane);
+        TEST_CHECK_(ls->lanes[lane]->PC == expected[lane]->PC, "lane %d PC %X", lane, ls->lanes[lane]->PC);
+        chip8_destroy(&expected[lane]);
+        chip8_destroy(&ls->lanes[lane]);
+    }
+    TEST_CHECK(results[3] == PC_OVERFLOW);
+    lockstep_destroy(&ls);
+}
+
+/**
+ * a lane stops at its first error while the others run on
+ */
+void test_lockstep_error(void)
+{
+    uint8_t program[] = { 0x60, 0x01, 0x30, 0x01, 0x00, 0xEE, 0x12, 0x02 };
+    lockstep_t *ls = lockstep_create();
+    for (int lane = 0; lane < 3; lane++) {
+        chip8_t *c8 = chip8_create();
+        chip8_reset(c8);
+        chip8_ramcpy(c8, program, sizeof(program));
+        lockstep_add(ls, c8);
+    }
+    ls->lanes[1]->PC = START_ADDRESS + 2; // V0 stays 0, so it does not skip the return
+    lockstep_run(ls, 10);
+    TEST_CHECK(ls->result[0] == EXEC_SUCCESS && ls->executed[0] == 10);
+    TEST_CHECK(ls->result[1] == STACK_UNDERFLOW && ls->executed[1] == 2);
+    TEST_CHECK(ls->result[2] == EXEC_SUCCESS && ls->executed[2] == 10);
+    TEST_CHECK(ls->lanes[1]->PC == START_ADDRESS + 6);
+    lockstep_run(ls, 5);
+    TEST_CHECK(ls->executed[1] == 0 && ls->executed[0] == 5);
+
+    chip8_t *extra = chip8_create();
+    for (int lane = 3; lane < LOCKSTEP_LANES; lane++) {
+        lockstep_add(ls, extra);
+    }
+    TEST_CHECK(lockstep_add(ls, extra) == -1);
+    chip8_destroy(&extra);
+    for (int lane = 0; lane < 3; lane++) {
+        chip8_destroy(&ls->lanes[lane]);
+    }
+    lockstep_destroy(&ls);
+}
+
+TEST_LIST = {
+    { "lockstep engine runs ROMs like chip8_cycle", test_lockstep_roms },
+    { "lockstep engine runs random programs like chip8_cycle", test_lockstep_random },
+    { "lockstep jumps", test_lockstep_jump },
+    { "lockstep errors", test_lockstep_error },
+    { NULL, NULL }
+};
@@ -0,0 +1,165 @@
+/**
+ * Tests for recording and playing the input of runs.
+ */
+
+#include "../lib/acutest.h"
+#include "../src/chip8.c"
+#include "../src/movie.c"
+#include "common.h"
+
+#define MOVIE_TEST_FRAMES 900
+
+// run frames like the device does; without a movie to play, keys and IPF follow a pattern and get recorded
+int run_movie(chip8_t *c8, movie_t *movie, int playing, uint64_t *instructions)
+{
+    uint16_t ipf = 10;
+    int synced = 1;
+    *instructions = 0;
+    for (uint32_t frame = 0; frame < MOVIE_TEST_FRAMES; frame++) {
+        if (playing) { // keys and IPF stay until the next event
+            synced &= movie_play(movie, frame, *instructions, c8->KEYBOARD, &ipf);
+        } else {
+            memset(c8->KEYBOARD, 0, sizeof(uint8_t) * 16);
+            c8->KEYBOARD[(frame / 20) % 16] = frame % 20 < 12;
+            ipf = (frame < 300) ? 10 : 15;
+            movie_record(movie, frame, *instructions, c8->KEYBOARD, ipf);
+        }
+        chip8_tick(c8);
+        for (uint16_t i = 0; i < ipf; i++) {
+            chip8_cycle(c8);
+        }
+        *instructions += ipf;
+    }
+    return synced;
+}
+
+/**
+ * a played movie ends in the recorded state, also after a round trip through a file
+ */
+void test_movie_play(void)
+{
+    char *roms[] = { "rom/outlaw.ch8", "rom/blitz.ch8", "rom/test/corax+.ch8", NULL };
+    for (int r = 0; roms[r] != NULL; r++) {
+        uint64_t instructions;
+        chip8_t *c8 = load_seeded(roms[r], 7);
+        movie_t *recorded = movie_create(movie_rom_hash(c8), 7, PROFILE_VIP);
+        run_movie(c8, recorded, 0, &instructions);
+        movie_finish(recorded, MOVIE_TEST_FRAMES, instructions, c8);
+        // an event per change only
+        TEST_CHECK_(recorded->count <= MOVIE_TEST_FRAMES / 10 + 1, "%s: %u events", roms[r], recorded->count);
+
+        FILE *f = fopen("bin/test/movie.ch8m", "wb");
+        TEST_CHECK(movie_write(recorded, f) == MOVIE_SUCCESS);
+        fclose(f);
+        movie_t *played;
+        f = fopen("bin/test/movie.ch8m", "rb");
+        TEST_CHECK(movie_read(&played, f) == MOVIE_SUCCESS);
+        TEST_CHECK_(ftell(f) < 8 * recorded->count + 64, "%s: %ld bytes", roms[r], ftell(f));
+        fclose(f);
+        remove("bin/test/movie.ch8m");
+        TEST_ASSERT(played != NULL);
+        TEST_CHECK(played->rom_hash == recorded->rom_hash && played->seed == 7);
+        TEST_CHECK(played->count == recorded->count);
+        for (uint32_t i = 0; i < played->count && i < recorded->count; i++) {
+            movie_event_t *a = &played->events[i], *b = &recorded->events[i];
+            TEST_CHECK_(a->frame == b->frame && a->instructions == b->instructions && a->keys == b->keys
+                && a->ipf == b->ipf, "event %u", i);
+        }
+
+        chip8_t *replay = load_seeded(roms[r], played->seed);
+        TEST_CHECK(movie_rom_hash(replay) == played->rom_hash);
+        TEST_CHECK_(run_movie(replay, played, 1, &instructions), "%s", roms[r]);
+        TEST_CHECK_(movie_verify(played, MOVIE_TEST_FRAMES, instructions, replay), "%s", roms[r]);
+        TEST_CHECK(!movie_verify(played, MOVIE_TEST_FRAMES - 1, instructions, replay));
+        movie_destroy(&played);
+        movie_destroy(&recorded);
+        chip8_destroy(&replay);
+        chip8_destroy(&c8);
+    }
+}
+
+/**
+ * a movie played with another seed ends in another state
+ */
+void test_movie_desync(void)
+{
+    uint64_t instructions;
+    chip8_t *c8 = load_seeded("rom/outlaw.ch8", 7);
+    movie_t *movie = movie_create(movie_rom_hash(c8), 7, PROFILE_VIP);
+    run_movie(c8, movie, 0, &instructions);
+    movie_finish(movie, MOVIE_TEST_FRAMES, instructions, c8);
+    chip8_t *replay = load_seeded("rom/outlaw.ch8", 8);
+    run_movie(replay, movie, 1, &instructions);
+    TEST_CHECK(!movie_verify(movie, MOVIE_TEST_FRAMES, instructions, replay));
+
+    // the keys and the render flag are not part of the state
+    movie->next = 0;
+    chip8_destroy(&replay);
+    replay = load_seeded("rom/outlaw.ch8", 7);
+    run_movie(replay, movie, 1, &instructions);
+    memset(replay->KEYBOARD, 1, sizeof(uint8_t) * 16);
+    replay->RF = !replay->RF;
+    TEST_CHECK(movie_verify(movie, MOVIE_TEST_FRAMES, instructions, replay));
+    replay->V[3]++;
+    TEST_CHECK(!movie_verify(movie, MOVIE_TEST_FRAMES, instructions, replay));
+    movie_destroy(&movie);
+    chip8_destroy(&replay);
+    chip8_destroy(&c8);
+}
+
+/**
+ * broken movie files are refused
+ */
+void test_movie_errors(void)
+{
+    uint64_t instructions;
+    chip8_t *c8 = load_seeded("rom/blitz.ch8", 1);
+    movie_t *movie = movie_create(movie_rom_hash(c8), 1, PROFILE_VIP);
+    run_movie(c8, movie, 0, &instructions);
+    movie_finish(movie, MOVIE_TEST_FRAMES, instructions, c8);
+    FILE *f = fopen("bin/test/movie.ch8m", "w+b");
+    TEST_CHECK(movie_write(movie, f) == MOVIE_SUCCESS);
+    long size = ftell(f);
+    uint8_t *bytes = malloc(size);
+    rewind(f);
+    TEST_CHECK(fread(bytes, 1, size, f) == (size_t)size);
+    fclose(f);
+
+    // every cut is noticed
+    movie_t *read;
+    for (long cut = 0; cut < size; cut++) {
+        f = fopen("bin/test/movie.ch8m", "wb");
+        fwrite(bytes, 1, cut, f);
+        fclose(f);
+        f = fopen("bin/test/movie.ch8m", "rb");
+        TEST_CHECK_(movie_read(&read, f) == MOVIE_TRUNCATED && read == NULL, "cut at %ld", cut);
+        fclose(f);
+    }
+
+    uint8_t bad[][2] = { { 0, 'X' }, { 4, MOVIE_VERSION + 1 } };
+    movie_res_t results[] = { MOVIE_BAD_MAGIC, MOVIE_BAD_VERSION };
+    for (int b = 0; b < 2; b++) {
+        uint8_t byte = bytes[bad[b][0]];
+        bytes[bad[b][0]] = bad[b][1];
+        f = fopen("bin/test/movie.ch8m", "wb");
+        fwrite(bytes, 1, size, f);
+        fclose(f);
+        f = fopen("bin/test/movie.ch8m", "rb");
+        TEST_CHECK_(movie_read(&read, f) == results[b] && read == NULL, "result %d", b);
+        fclose(f);
+        bytes[bad[b][0]] = byte;
+    }
+    remove("bin/test/movie.ch8m");
+    TEST_CHECK(movie_read(&read, NULL) == MOVIE_NOT_EXISTS);
+    TEST_CHECK(movie_write(movie, NULL) == MOVIE_NOT_EXISTS);
+    free(bytes);
+    movie_destroy(&movie);
+    chip8_destroy(&c8);
+}
+
+TEST_LIST = {
+    { "movie playing", test_movie_play },
+    { "movie out of sync", test_movie_desync },
+    { "movie errors", test_movie_errors },
+    { NULL, NULL }
+};
@@ -0,0 +1,127 @@
+/**
+ * Tests for the guest profiler.
+ */
+
+#define CHIP8_PROFILER
+
+#include "../lib/acutest.h"
+#include "../src/chip8.c"
+#include "../src/profiler.c"
+
+// a subroutine called 3 times from a loop, then a jump to itself
+uint8_t program[] = {
+    0x60, 0x03, // 200: V0 = 3
+    0x22, 0x0C, // 202: call 20C
+    0x70, 0xFF, // 204: V0 -= 1
+    0x30, 0x00, // 206: skip if V0 == 0
+    0x12, 0x02, // 208: jump to 202
+    0x12, 0x0A, // 20A: jump to itself
+    0x61, 0x01, // 20C: V1 = 1
+    0x00, 0xEE  // 20E: return
+};
+
+chip8_t *profiled(profiler_t *profiler)
+{
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_ramcpy(c8, program, sizeof(program));
+    c8->PROFILER = profiler;
+    run_result_t run;
+    chip8_run(c8, 100, &run);
+    TEST_CHECK(run.executed == 100 && run.stop == RUN_IDLE);
+    return c8;
+}
+
+/**
+ * every instruction is counted at its address and in its opclass, the skipped ones of an idle loop too
+ */
+void test_profiler_count(void)
+{
+    profiler_t *profiler = profiler_create();
+    chip8_t *c8 = profiled(profiler);
+    TEST_CHECK(profiler->instructions == 100);
+    uint64_t expected[] = { 1, 3, 3, 3, 2, 82, 3, 3 };
+    for (int i = 0; i < 8; i++) {
+        TEST_CHECK_(profiler->addresses[0x200 + 2 * i] == expected[i], "%03X: %llu", 0x200 + 2 * i,
+            (unsigned long long)profiler->addresses[0x200 + 2 * i]);
+    }
+    TEST_CHECK(profiler->opclasses[OC_JP] == 84);
+    TEST_CHECK(profiler->opclasses[OC_CALL] == 3 && profiler->opclasses[OC_RET] == 3);
+    TEST_CHECK(profiler->opclasses[OC_LD_VX_NN] == 4);
+    // the call, the body and the return
+    TEST_CHECK(profiler->calls[0x20C] == 3 && profiler->cycles[0x20C] == 9);
+
+    // without a profiler attached nothing is counted
+    c8->PROFILER = NULL;
+    chip8_reset(c8);
+    chip8_ramcpy(c8, program, sizeof(program));
+    run_result_t run;
+    chip8_run(c8, 100, &run);
+    TEST_CHECK(profiler->instructions == 100);
+    profiler_destroy(&profiler);
+    TEST_CHECK(profiler == NULL);
+    chip8_destroy(&c8);
+}
+
+/**
+ * the reports: a CSV row per address that ran, JSON totals and a 64x64 heat map
+ */
+void test_profiler_write(void)
+{
+    profiler_t *profiler = profiler_create();
+    chip8_t *c8 = profiled(profiler);
+    char line[256];
+    int found = 0, rows = 0;
+
+    FILE *f = fopen("bin/test/profile.csv", "w");
+    TEST_CHECK(profiler_write_csv(profiler, c8, f) == PROFILER_SUCCESS);
+    fclose(f);
+    f = fopen("bin/test/profile.csv", "r");
+    while (fgets(line, sizeof(line), f)) {
+        found |= strcmp(line, "0x20C,6101,LD_VX_NN,3,3,9\n") == 0;
+        rows++;
+    }
+    fclose(f);
+    TEST_CHECK(found);
+    TEST_CHECK_(rows == 9, "%d rows", rows);
+
+    f = fopen("bin/test/profile.json", "w");
+    TEST_CHECK(profiler_write_json(profiler, f) == PROFILER_SUCCESS);
+    fclose(f);
+    f = fopen("bin/test/profile.json", "r");
+    size_t size = fread(line, sizeof(char), sizeof(line) - 1, f);
+    line[size] = '\0';
+    fclose(f);
+    TEST_CHECK(strstr(line, "\"instructions\": 100,") != NULL);
+    TEST_CHECK(strstr(line, "\"CALL\": 3") != NULL && strstr(line, "\"JP\": 84") != NULL);
+    TEST_CHECK(strstr(line, "{ \"address\": \"0x20C\", \"calls\": 3, \"instructions\": 9 }") != NULL);
+
+    f = fopen("bin/test/profile.ppm", "wb");
+    TEST_CHECK(profiler_write_heatmap(profiler, f) == PROFILER_SUCCESS);
+    fclose(f);
+    f = fopen("bin/test/profile.ppm", "rb");
+    TEST_CHECK(fgets(line, sizeof(line), f) && strcmp(line, "P6\n") == 0);
+    TEST_CHECK(fgets(line, sizeof(line), f) && strcmp(line, "64 64\n") == 0);
+    TEST_CHECK(fgets(line, sizeof(line), f) && strcmp(line, "255\n") == 0);
+    uint8_t *pixels = malloc(RAM_SIZE * 3 + 1);
+    TEST_CHECK(fread(pixels, sizeof(uint8_t), RAM_SIZE * 3 + 1, f) == RAM_SIZE * 3);
+    fclose(f);
+    // the hottest address is white, the ones that never ran black, the others in between
+    TEST_CHECK(pixels[0x20A * 3] == 255 && pixels[0x20A * 3 + 1] == 255 && pixels[0x20A * 3 + 2] == 255);
+    TEST_CHECK(pixels[0] == 0 && pixels[1] == 0 && pixels[2] == 0);
+    TEST_CHECK(pixels[0x208 * 3] > 0 && pixels[0x208 * 3 + 2] < 255);
+    free(pixels);
+
+    remove("bin/test/profile.csv");
+    remove("bin/test/profile.json");
+    remove("bin/test/profile.ppm");
+    TEST_CHECK(profiler_write_csv(profiler, c8, NULL) == PROFILER_NOT_EXISTS);
+    profiler_destroy(&profiler);
+    chip8_destroy(&c8);
+}
+
+TEST_LIST = {
+    { "profiler counts", test_profiler_count },
+    { "profiler reports", test_profiler_write },
+    { NULL, NULL }
+};
@@ -0,0 +1,162 @@
+/**
+ * Tests for the control flow analysis and code generation of the static recompiler.
+ */
+
+#define RECOMPILE_NO_MAIN
+#include <dlfcn.h>
+#include "../lib/acutest.h"
+#include "../src/chip8.c"
+#include "../tools/recompile.c"
+#include "common.h"
+
+#define AOT_FRAMES 600
+#define AOT_IPF 50
+
+typedef exec_res_t (*aot_run_t)(chip8_t *c8, uint32_t count, uint32_t *executed);
+
+// 0x200: call 0x20A, skip if V0 == 1, jump to itself, jump 0x210 + V0, data
+// 0x20A: V0 = 1, return, data
+// 0x210: jump table of 0x200 and 0x20A, data
+uint8_t program[] = {
+    0x22, 0x0A, 0x30, 0x01, 0x12, 0x04, 0xB2, 0x10, 0x12, 0x34,
+    0x60, 0x01, 0x00, 0xEE, 0xFF, 0xFF,
+    0x12, 0x00, 0x12, 0x0A, 0xAB, 0xCD
+};
+
+program_t *load_program(void)
+{
+    program_t *p = malloc(sizeof(program_t));
+    FILE *f = tmpfile();
+    fwrite(program, sizeof(uint8_t), sizeof(program), f);
+    rewind(f);
+    TEST_CHECK(program_load(p, f));
+    fclose(f);
+    TEST_CHECK(p->END == START_ADDRESS + sizeof(program));
+    return p;
+}
+
+/**
+ * code is followed through calls, returns, skips and jump tables
+ */
+void test_recompile_analyze(void)
+{
+    program_t *p = load_program();
+    TEST_CHECK(program_analyze(p) == 8);
+    uint16_t reached[] = { 0x200, 0x202, 0x204, 0x206, 0x20A, 0x20C, 0x210, 0x212 };
+    for (int i = 0; i < 8; i++) {
+        TEST_CHECK_(p->CODE[reached[i]], "0x%03X reached", reached[i]);
+    }
+    TEST_CHECK(!p->CODE[0x208] && !p->CODE[0x20E] && !p->CODE[0x214]);
+    free(p);
+}
+
+/**
+ * every reachable instruction gets a label, data does not
+ */
+void test_recompile_emit(void)
+{
+    char source[16384] = { 0 };
+    program_t *p = load_program();
+    program_analyze(p);
+    FILE *f = tmpfile();
+    program_emit(p, f, "program.ch8");
+    rewind(f);
+    fread(source, sizeof(char), sizeof(source) - 1, f);
+    fclose(f);
+    TEST_CHECK(strstr(source, "const char *aot_rom = \"program.ch8\";") != NULL);
+    TEST_CHECK(strstr(source, "AT(0x20A)") != NULL && strstr(source, "AT(0x212)") != NULL);
+    TEST_CHECK(strstr(source, "AT(0x208)") == NULL && strstr(source, "AT(0x20E)") == NULL);
+    TEST_CHECK(strstr(source, "c8->STACK[c8->SP] = 0x202;") != NULL);
+    TEST_CHECK(strstr(source, "goto L_0x20A;") != NULL);
+    TEST_CHECK(strstr(source, "pc = 0x210 + V[0];") != NULL);
+    free(p);
+}
+
+// translate a ROM and build it like `make recompile` does, as a library of its own with the interpreter it falls back to
+void *build(char *path, int index)
+{
+    char source[FILENAME_MAX], library[FILENAME_MAX], command[3 * FILENAME_MAX];
+    snprintf(source, sizeof(source), "bin/test/aot-%d.c", index);
+    snprintf(library, sizeof(library), "bin/test/aot-%d.so", index);
+    program_t *p = malloc(sizeof(program_t));
+    FILE *rom = fopen(path, "rb");
+    int loaded = program_load(p, rom);
+    if (rom) fclose(rom);
+    FILE *out = fopen(source, "w");
+    if (!TEST_CHECK_(loaded && out != NULL, "%s", path)) {
+        if (out) fclose(out);
+        free(p);
+        return NULL;
+    }
+    program_analyze(p);
+    program_emit(p, out, path);
+    fclose(out);
+    free(p);
+    snprintf(command, sizeof(command), "gcc -shared -fPIC -Isrc -o %s %s src/chip8.c", library, source);
+    if (!TEST_CHECK_(system(command) == 0, "%s: %s", path, command)) {
+        return NULL;
+    }
+    void *handle = dlopen(library, RTLD_NOW | RTLD_LOCAL);
+    TEST_CHECK_(handle != NULL, "%s: %s", path, dlerror());
+    remove(source);
+    remove(library);
+    return handle;
+}
+
+int check_same(chip8_t *expected, chip8_t *actual, char *path, int frame)
+{
+    int same = 1;
+    same &= TEST_CHECK_(expected->PC == actual->PC, "%s frame %d: PC %X != %X", path, frame, expected->PC, actual->PC);
+    same &= TEST_CHECK_(expected->I == actual->I, "%s frame %d: I", path, frame);
+    same &= TEST_CHECK_(expected->SP == actual->SP, "%s frame %d: SP", path, frame);
+    same &= TEST_CHECK_(memcmp(expected->V, actual->V, sizeof(expected->V)) == 0, "%s frame %d: V", path, frame);
+    same &= TEST_CHECK_(memcmp(expected->STACK, actual->STACK, sizeof(expected->STACK)) == 0, "%s frame %d: stack", path, frame);
+    same &= TEST_CHECK_(memcmp(expected->RAM, actual->RAM, sizeof(expected->RAM)) == 0, "%s frame %d: RAM", path, frame);
+    same &= TEST_CHECK_(memcmp(expected->SCREEN, actual->SCREEN, sizeof(expected->SCREEN)) == 0, "%s frame %d: screen", path, frame);
+    return same;
+}
+
+/**
+ * recompiled ROMs, compiled by gcc, run frame by frame like chip8_cycle
+ */
+void test_recompile_run(void)
+{
+    char *roms[] = {
+        "rom/blitz.ch8", "rom/kaleidoscope.ch8", "rom/outlaw.ch8", "rom/test/corax+.ch8", "rom/test/flags.ch8",
+        "rom/test/quirks.ch8", NULL
+    };
+    for (int r = 0; roms[r] != NULL; r++) {
+        void *handle = build(roms[r], r);
+        aot_run_t run = handle ? (aot_run_t)dlsym(handle, "aot_run") : NULL;
+        if (!TEST_CHECK_(run != NULL, "%s: aot_run", roms[r])) {
+            if (handle) dlclose(handle);
+            continue;
+        }
+        chip8_t *expected = load(roms[r]);
+        chip8_t *actual = load(roms[r]);
+        for (int frame = 0; frame < AOT_FRAMES; frame++) {
+            memset(expected->KEYBOARD, 0, sizeof(uint8_t) * 16);
+            expected->KEYBOARD[frame / 20 % 16] = frame % 20 < 10;
+            memcpy(actual->KEYBOARD, expected->KEYBOARD, sizeof(uint8_t) * 16);
+            chip8_tick(expected);
+            chip8_tick(actual);
+            exec_res_t result = EXEC_SUCCESS;
+            for (int i = 0; i < AOT_IPF && result == EXEC_SUCCESS; i++) {
+                result = chip8_cycle(expected);
+            }
+            uint32_t executed;
+            TEST_CHECK_(run(actual, AOT_IPF, &executed) == result, "%s frame %d: result", roms[r], frame);
+            if (!check_same(expected, actual, roms[r], frame) || result != EXEC_SUCCESS) break;
+        }
+        chip8_destroy(&expected);
+        chip8_destroy(&actual);
+        dlclose(handle);
+    }
+}
+
+TEST_LIST = {
+    { "control flow analysis", test_recompile_analyze },
+    { "code generation", test_recompile_emit },
+    { "recompiled ROMs against the interpreter", test_recompile_run },
+    { NULL, NULL }
+};
@@ -0,0 +1,185 @@
+/**
+ * Tests for the rewind history of delta-compressed frames.
+ */
+
+#include "../lib/acutest.h"
+#include "../src/chip8.c"
+#include "../src/snapshot.c"
+#include "../src/rewind.c"
+#include "common.h"
+
+#define REWIND_TEST_FRAMES 600
+
+// run one frame, pressing the keys of the given pattern, and keep the state it ends in
+void run_frame(chip8_t *c8, int frame, int pattern, uint8_t *states)
+{
+    memset(c8->KEYBOARD, 0, sizeof(uint8_t) * 16);
+    c8->KEYBOARD[(frame / 15 + pattern) % 16] = frame % 15 < 8;
+    chip8_tick(c8);
+    for (int i = 0; i < 30; i++) {
+        chip8_cycle(c8);
+    }
+    chip8_snapshot_save(c8, &states[frame * SNAPSHOT_SIZE]);
+}
+
+// pop frames down to the given one, each one has to be the state saved for it
+int pop_until(rewind_t *rw, chip8_t *c8, int frame, int last, uint8_t *states)
+{
+    uint8_t state[SNAPSHOT_SIZE];
+    int same = 1;
+    for (frame--; frame >= last && same; frame--) {
+        same &= TEST_CHECK_(rewind_pop(rw, c8), "frame %d", frame);
+        size_t size = chip8_snapshot_save(c8, state);
+        same &= TEST_CHECK_(memcmp(state, &states[frame * SNAPSHOT_SIZE], size) == 0, "frame %d", frame);
+    }
+    return same;
+}
+
+/**
+ * every captured frame comes back, newest first, down to the oldest one
+ */
+void test_rewind_frames(void)
+{
+    char *roms[] = { "rom/outlaw.ch8", "rom/blitz.ch8", "rom/test/corax+.ch8", NULL };
+    uint8_t *states = malloc(SNAPSHOT_SIZE * REWIND_TEST_FRAMES);
+    for (int r = 0; roms[r] != NULL; r++) {
+        chip8_t *c8 = load(roms[r]);
+        rewind_t *rw = rewind_create(REWIND_BYTES, REWIND_FRAMES);
+        for (int frame = 0; frame < REWIND_TEST_FRAMES; frame++) {
+            run_frame(c8, frame, 0, states);
+            rewind_push(rw, c8);
+        }
+        // a delta per frame but the newest, far below a snapshot each
+        TEST_CHECK(rw->count == REWIND_TEST_FRAMES - 1);
+        TEST_CHECK_(rewind_bytes(rw) < REWIND_TEST_FRAMES * SNAPSHOT_SIZE / 20, "%s: %u bytes", roms[r], rewind_bytes(rw));
+        pop_until(rw, c8, REWIND_TEST_FRAMES - 1, 0, states);
+        TEST_CHECK(!rewind_pop(rw, c8));
+        rewind_destroy(&rw);
+        chip8_destroy(&c8);
+    }
+    free(states);
+}
+
+/**
+ * after rewinding, the frames run from there on replace the rewound ones
+ */
+void test_rewind_branch(void)
+{
+    uint8_t *states = malloc(SNAPSHOT_SIZE * REWIND_TEST_FRAMES);
+    chip8_t *c8 = load("rom/outlaw.ch8");
+    rewind_t *rw = rewind_create(REWIND_BYTES, REWIND_FRAMES);
+    for (int frame = 0; frame < 300; frame++) {
+        run_frame(c8, frame, 0, states);
+        rewind_push(rw, c8);
+    }
+    pop_until(rw, c8, 299, 100, states);
+    for (int frame = 101; frame < REWIND_TEST_FRAMES; frame++) {
+        run_frame(c8, frame, 5, states);
+        rewind_push(rw, c8);
+    }
+    pop_until(rw, c8, REWIND_TEST_FRAMES - 1, 0, states);
+    TEST_CHECK(!rewind_pop(rw, c8));
+
+    // nothing to go back to after clearing
+    rewind_push(rw, c8);
+    rewind_clear(rw);
+    rewind_push(rw, c8);
+    TEST_CHECK(!rewind_pop(rw, c8));
+    rewind_destroy(&rw);
+    chip8_destroy(&c8);
+    free(states);
+}
+
+/**
+ * a full ring drops the oldest frames and keeps the newest ones intact
+ */
+void test_rewind_limits(void)
+{
+    uint8_t *states = malloc(SNAPSHOT_SIZE * REWIND_TEST_FRAMES);
+    uint32_t limits[][2] = { { 0, 50 }, { 0, REWIND_FRAMES }, { REWIND_BYTES, 100 } };
+    for (int l = 0; l < 3; l++) {
+        chip8_t *c8 = load("rom/outlaw.ch8");
+        rewind_t *rw = rewind_create(limits[l][0], limits[l][1]);
+        if (l == 1) chip8_profile(c8, PROFILE_XOCHIP);
+        for (int frame = 0; frame < REWIND_TEST_FRAMES; frame++) {
+            if (l == 1) { // XO-CHIP data changing every frame, so that the deltas outgrow the smallest ring
+                memset(&c8->RAM[RAM_SIZE + frame % 200 * 256], frame, 256);
+            }
+            run_frame(c8, frame, 0, states);
+            rewind_push(rw, c8);
+            TEST_CHECK_(rewind_bytes(rw) <= rw->size && rw->count <= limits[l][1], "limit %d frame %d", l, frame);
+        }
+        uint32_t kept = rw->count;
+        TEST_CHECK_(kept > 0 && kept < REWIND_TEST_FRAMES - 1, "limit %d: %u frames", l, kept);
+        pop_until(rw, c8, REWIND_TEST_FRAMES - 1, REWIND_TEST_FRAMES - 1 - kept, states);
+        TEST_CHECK(!rewind_pop(rw, c8));
+        rewind_destroy(&rw);
+        chip8_destroy(&c8);
+    }
+    free(states);
+}
+
+/**
+ * frames before and after restoring snapshots of other profiles, which are of other sizes, come back too
+ */
+void test_rewind_profiles(void)
+{
+    uint8_t *states = malloc(SNAPSHOT_SIZE * REWIND_TEST_FRAMES);
+    chip8_t *c8 = load("rom/test/corax+.ch8");
+    rewind_t *rw = rewind_create(REWIND_BYTES, REWIND_FRAMES);
+    for (int frame = 0; frame < REWIND_TEST_FRAMES; frame++) {
+        if (frame % 100 == 50) {
+            chip8_profile(c8, frame % 200 == 50 ? PROFILE_XOCHIP : PROFILE_SCHIP);
+        }
+        // data only in the larger snapshots, different in every one
+        c8->RAM[XO_RAM_SIZE - 1 - frame] = frame;
+        run_frame(c8, frame, 0, states);
+        rewind_push(rw, c8);
+    }
+    pop_until(rw, c8, REWIND_TEST_FRAMES - 1, 0, states);
+    TEST_CHECK(c8->PROFILE == PROFILE_VIP);
+    rewind_destroy(&rw);
+    chip8_destroy(&c8);
+    free(states);
+}
+
+/**
+ * deltas of very different sizes wrap around the ring without overwriting kept ones
+ */
+void test_rewind_wrap(void)
+{
+    int frames = 2000;
+    uint8_t *states = malloc(SNAPSHOT_SIZE * frames);
+    uint8_t state[SNAPSHOT_SIZE];
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    rewind_t *rw = rewind_create(0, REWIND_FRAMES);
+    srand(1);
+    for (int frame = 0; frame < frames; frame++) {
+        int changes = (rand() % 4 == 0) ? rand() % 2000 : rand() % 20;
+        for (int i = 0; i < changes; i++) {
+            c8->RAM[rand() % RAM_SIZE] = rand();
+        }
+        chip8_snapshot_save(c8, &states[frame * SNAPSHOT_SIZE]);
+        rewind_push(rw, c8);
+    }
+    int frame = frames - 1;
+    while (rewind_pop(rw, c8)) {
+        size_t size = chip8_snapshot_save(c8, state);
+        frame--;
+        if (!TEST_CHECK_(memcmp(state, &states[frame * SNAPSHOT_SIZE], size) == 0, "frame %d", frame)) break;
+    }
+    TEST_CHECK(frame < frames - 1);
+    rewind_destroy(&rw);
+    chip8_destroy(&c8);
+    free(states);
+}
+
+TEST_LIST = {
+    { "rewind frames", test_rewind_frames },
+    { "rewind and run on", test_rewind_branch },
+    { "rewind limits", test_rewind_limits },
+    { "rewind across profiles", test_rewind_profiles },
+    { "rewind ring wrapping", test_rewind_wrap },
+    { NULL, NULL }
+};
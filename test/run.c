@@ -0,0 +1,208 @@
+/**
+ * Tests for running instruction batches with chip8_run.
+ */
+
+#include "../lib/acutest.h"
+#include "../src/chip8.c"
+
+chip8_t *setup(uint8_t *data, uint8_t size)
+{
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_ramcpy(c8, data, size);
+    return c8;
+}
+
+/**
+ * the whole budget runs without stop conditions
+ */
+void test_run_budget(void)
+{
+    // V0 += 1, jump back
+    uint8_t data[] = { 0x70, 0x01, 0x12, 0x00 };
+    run_result_t run;
+    chip8_t *c8 = setup(data, 4);
+    chip8_run(c8, 101, &run);
+    TEST_CHECK(run.stop == RUN_BUDGET);
+    TEST_CHECK(run.result == EXEC_SUCCESS);
+    TEST_CHECK(run.executed == 101);
+    TEST_CHECK(c8->V[0] == 51);
+    TEST_CHECK(c8->PC == START_ADDRESS + 2);
+    chip8_destroy(&c8);
+}
+
+/**
+ * errors stop the run after the faulting instruction
+ */
+void test_run_error(void)
+{
+    uint8_t data[] = { 0x70, 0x01, 0x00, 0xEE, 0x70, 0x01 };
+    run_result_t run;
+    chip8_t *c8 = setup(data, 6);
+    chip8_run(c8, 10, &run);
+    TEST_CHECK(run.stop == RUN_ERROR);
+    TEST_CHECK(run.result == STACK_UNDERFLOW);
+    TEST_CHECK(run.executed == 2);
+    TEST_CHECK(c8->V[0] == 1);
+    chip8_destroy(&c8);
+}
+
+/**
+ * DXYN stops the run only if asked to
+ */
+void test_run_draw(void)
+{
+    // draw, V0 += 1, jump back
+    uint8_t data[] = { 0xD0, 0x01, 0x70, 0x01, 0x12, 0x00 };
+    run_result_t run;
+    chip8_t *c8 = setup(data, 6);
+    chip8_run(c8, 10, &run);
+    TEST_CHECK(run.stop == RUN_BUDGET && run.executed == 10);
+    c8->PC = START_ADDRESS;
+    c8->STOP_ON_DRAW = 1;
+    chip8_run(c8, 10, &run);
+    TEST_CHECK(run.stop == RUN_DRAW);
+    TEST_CHECK(run.executed == 1);
+    TEST_CHECK(c8->PC == START_ADDRESS + 2);
+    chip8_destroy(&c8);
+}
+
+/**
+ * FX0A stops the run while no key is pressed
+ */
+void test_run_wait(void)
+{
+    // V0 += 1, wait for key into V1, jump back
+    uint8_t data[] = { 0x70, 0x01, 0xF1, 0x0A, 0x12, 0x00 };
+    run_result_t run;
+    chip8_t *c8 = setup(data, 6);
+    chip8_run(c8, 10, &run);
+    TEST_CHECK(run.stop == RUN_WAIT);
+    TEST_CHECK(run.executed == 2);
+    TEST_CHECK(c8->PC == START_ADDRESS + 2);
+    c8->KEYBOARD[7] = 1;
+    chip8_run(c8, 2, &run);
+    TEST_CHECK(run.stop == RUN_BUDGET && run.executed == 2);
+    TEST_CHECK(c8->V[1] == 7);
+    TEST_CHECK(c8->PC == START_ADDRESS);
+    chip8_destroy(&c8);
+}
+
+/**
+ * breakpoints stop before their instruction and can be resumed
+ */
+void test_run_breakpoint(void)
+{
+    // V0 += 1, V1 += 1, jump back
+    uint8_t data[] = { 0x70, 0x01, 0x71, 0x01, 0x12, 0x00 };
+    run_result_t run;
+    chip8_t *c8 = setup(data, 6);
+    c8->BREAKPOINTS[START_ADDRESS + 2] = 1;
+    chip8_run(c8, 100, &run);
+    TEST_CHECK(run.stop == RUN_BREAKPOINT);
+    TEST_CHECK(run.executed == 1);
+    TEST_CHECK(c8->PC == START_ADDRESS + 2 && c8->V[1] == 0);
+    chip8_run(c8, 100, &run);
+    TEST_CHECK(run.stop == RUN_BREAKPOINT);
+    TEST_CHECK(run.executed == 3);
+    TEST_CHECK(c8->V[0] == 2 && c8->V[1] == 1);
+    chip8_destroy(&c8);
+}
+
+/**
+ * a jump to itself uses up the budget at once
+ */
+void test_run_idle_jump(void)
+{
+    // V0 += 1, jump to itself
+    uint8_t data[] = { 0x70, 0x01, 0x12, 0x02 };
+    run_result_t run;
+    chip8_t *c8 = setup(data, 4);
+    chip8_run(c8, 1000, &run);
+    TEST_CHECK(run.stop == RUN_IDLE);
+    TEST_CHECK(run.executed == 1000);
+    TEST_CHECK(c8->V[0] == 1 && c8->PC == START_ADDRESS + 2);
+    chip8_destroy(&c8);
+}
+
+/**
+ * spinning on the delay timer ends where the interpreter would have
+ */
+void test_run_idle_timer(void)
+{
+    // V3 = DT, skip if V3 == 0, jump back, V4 = 1
+    uint8_t data[] = { 0xF3, 0x07, 0x33, 0x00, 0x12, 0x00, 0x64, 0x01 };
+    run_result_t run;
+    chip8_t *c8 = setup(data, 8);
+    chip8_t *expected = setup(data, 8);
+    for (uint32_t budget = 4; budget < 10; budget++) {
+        c8->DT = expected->DT = 5;
+        c8->PC = expected->PC = START_ADDRESS;
+        chip8_run(c8, budget, &run);
+        for (uint32_t i = 0; i < budget; i++) {
+            chip8_cycle(expected);
+        }
+        TEST_CHECK(run.stop == RUN_IDLE && run.executed == budget);
+        TEST_CHECK_(c8->PC == expected->PC, "budget %d: PC %X != %X", budget, c8->PC, expected->PC);
+        TEST_CHECK(c8->V[3] == expected->V[3]);
+    }
+
+    // the timer running out ends the loop
+    c8->DT = 0;
+    c8->PC = START_ADDRESS;
+    chip8_run(c8, 100, &run);
+    TEST_CHECK(run.stop == RUN_BUDGET);
+    TEST_CHECK(c8->V[4] == 1);
+    chip8_destroy(&c8);
+    chip8_destroy(&expected);
+}
+
+/**
+ * idle skipping leaves ROMs in the same state as single cycles
+ */
+void test_run_idle_roms(void)
+{
+    char *roms[] = { "rom/outlaw.ch8", "rom/test/corax+.ch8", "rom/merlin.ch8", NULL };
+    for (int r = 0; roms[r] != NULL; r++) {
+        chip8_t *expected = chip8_create();
+        chip8_t *actual = chip8_create();
+        chip8_reset(expected);
+        chip8_reset(actual);
+        FILE *rom = fopen(roms[r], "rb");
+        TEST_ASSERT(rom != NULL);
+        chip8_load_rom(expected, rom);
+        rewind(rom);
+        chip8_load_rom(actual, rom);
+        fclose(rom);
+        uint32_t idle = 0;
+        for (int frame = 0; frame < 600; frame++) {
+            chip8_tick(expected);
+            chip8_tick(actual);
+            for (int i = 0; i < 200; i++) {
+                chip8_cycle(expected);
+            }
+            run_result_t run;
+            chip8_run(actual, 200, &run);
+            idle += run.stop == RUN_IDLE;
+            if (!TEST_CHECK_(expected->PC == actual->PC && memcmp(expected->V, actual->V, 16) == 0
+                && memcmp(expected->SCREEN, actual->SCREEN, sizeof(expected->SCREEN)) == 0, "%s frame %d", roms[r], frame)) {
+                break;
+            }
+        }
+        TEST_CHECK_(idle > 0, "%s idles", roms[r]);
+        chip8_destroy(&expected);
+        chip8_destroy(&actual);
+    }
+}
+
+TEST_LIST = {
+    { "run budget", test_run_budget },
+    { "run stops on errors", test_run_error },
+    { "run stops on draw", test_run_draw },
+    { "run stops on FX0A wait", test_run_wait },
+    { "run stops on breakpoints", test_run_breakpoint },
+    { "run skips jumps to itself", test_run_idle_jump },
+    { "run skips delay timer spins", test_run_idle_timer },
+    { "run skips idle loops of ROMs", test_run_idle_roms },
+    { NULL, NULL }
+};
@@ -0,0 +1,95 @@
+/**
+ * Tests for the nearest-neighbour upscaler of the window surface.
+ */
+
+#include "../lib/acutest.h"
+#include "../src/scale.c"
+
+#define SCALE_WIDTH 128
+#define SCALE_HEIGHT 64
+#define SCALE_CANARY 0xDEADBEEF
+
+uint32_t scale_palette[SCALE_PALETTE];
+
+/**
+ * every pixel becomes a square of scale pixels of its color, the pixels outside the rows stay untouched
+ */
+void test_scale_rows(void)
+{
+    // row by row, as wide as the resolution
+    uint8_t screen[SCALE_HEIGHT * SCALE_WIDTH];
+    for (int i = 0; i < SCALE_HEIGHT * SCALE_WIDTH; i++) {
+        screen[i] = (i * 7 + i / 5) & 0xFF;
+    }
+    for (int i = 0; i < SCALE_PALETTE; i++) {
+        scale_palette[i] = 0xFF000000 | i * 0x010203;
+    }
+    int scales[] = { 1, 2, 3, 4, 5, 7, 8, 10, 13, 16, 0 };
+    for (int s = 0; scales[s] != 0; s++) {
+        int scale = scales[s], width = SCALE_WIDTH / (scale > 5 ? 2 : 1), rows = 5, first = 3;
+        // a border of canaries right of and below the scaled rows
+        size_t pitch = (width * scale + 3) * sizeof(uint32_t);
+        size_t count = pitch / sizeof(uint32_t) * (rows * scale + 1);
+        uint32_t *pixels = malloc(pitch * (rows * scale + 1));
+        for (size_t i = 0; i < count; i++) {
+            pixels[i] = SCALE_CANARY;
+        }
+        scale_rows((uint8_t *)pixels, pitch, &screen[first * width], width, rows, scale, scale_palette);
+        int wrong = 0;
+        for (int y = 0; y <= rows * scale; y++) {
+            uint32_t *line = pixels + y * pitch / sizeof(uint32_t);
+            for (size_t x = 0; x < pitch / sizeof(uint32_t); x++) {
+                uint32_t expected = (y < rows * scale && (int)x < width * scale)
+                    ? scale_palette[screen[(first + y / scale) * width + x / scale]] : SCALE_CANARY;
+                wrong += line[x] != expected;
+            }
+        }
+        TEST_CHECK_(wrong == 0, "scale %d: %d wrong pixels", scale, wrong);
+        free(pixels);
+    }
+}
+
+/**
+ * lit pixels glow at full brightness in their color, unlit ones fade by the decay until they are off, and only the
+ * rows that changed are reported
+ */
+void test_scale_phosphor(void)
+{
+    // wide enough for vectors, and narrow enough for only the pixels after the last one
+    int widths[] = { SCALE_WIDTH, SCALE_WIDTH / 2, 13, 0 };
+    for (int w = 0; widths[w] != 0; w++) {
+        int width = widths[w], height = SCALE_HEIGHT / 2;
+        uint8_t glow[SCALE_HEIGHT * SCALE_WIDTH] = { 0 }, screen[SCALE_HEIGHT * SCALE_WIDTH] = { 0 };
+        screen[3 * width + width - 1] = 2;
+        screen[20 * width] = 1;
+        uint64_t rows = scale_phosphor(glow, screen, width, height, 128);
+        TEST_CHECK_(rows == (1ULL << 3 | 1ULL << 20), "width %d: rows %llx", width, (unsigned long long)rows);
+        TEST_CHECK(glow[3 * width + width - 1] == (2 << GLOW_SHIFT | GLOW_FULL));
+        TEST_CHECK(glow[20 * width] == (1 << GLOW_SHIFT | GLOW_FULL));
+
+        // the sprite moves on: the old pixel fades in its color, the held one stays at full brightness
+        screen[3 * width + width - 1] = 0;
+        rows = scale_phosphor(glow, screen, width, height, 128);
+        TEST_CHECK_(rows == 1ULL << 3, "width %d: rows %llx", width, (unsigned long long)rows);
+        TEST_CHECK(glow[3 * width + width - 1] == (2 << GLOW_SHIFT | GLOW_FULL / 2));
+        TEST_CHECK(glow[20 * width] == (1 << GLOW_SHIFT | GLOW_FULL));
+
+        int frames = 1;
+        while (scale_phosphor(glow, screen, width, height, 128) != 0) {
+            frames++;
+        }
+        // 31, 15, 7, 3, 1 and 0
+        TEST_CHECK_(frames == 6, "width %d: faded in %d frames", width, frames);
+        int wrong = 0;
+        for (int i = 0; i < width * height; i++) {
+            wrong += glow[i] != (i == 20 * width ? (1 << GLOW_SHIFT | GLOW_FULL) : 0);
+        }
+        TEST_CHECK_(wrong == 0, "width %d: %d wrong pixels", width, wrong);
+    }
+}
+
+TEST_LIST = {
+    { "scale rows", test_scale_rows },
+    { "scale phosphor", test_scale_phosphor },
+    { NULL, NULL }
+};
@@ -38,7 +38,7 @@ void test_reset(void)
     TEST_CHECK(sum == 0);
     for (int i = 0; i < SCREEN_WIDTH; i++) {
         for (int j = 0; j < SCREEN_HEIGHT; j++) {
-            sum += c8->SCREEN[i][j];
+            sum += chip8_pixel(c8, i, j);
         }
     }
     TEST_CHECK(sum == 0);
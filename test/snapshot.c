@@ -0,0 +1,238 @@
+/**
+ * Tests for saving and restoring snapshots of an instance.
+ */
+
+#include "../lib/acutest.h"
+#include "../src/chip8.c"
+#include "../src/block.c"
+#include "../src/snapshot.c"
+#include "common.h"
+
+void run_frames(chip8_t *c8, int frames)
+{
+    for (int frame = 0; frame < frames; frame++) {
+        c8->KEYBOARD[frame / 20 % 16] = frame % 20 < 10;
+        chip8_tick(c8);
+        for (int i = 0; i < 30; i++) {
+            chip8_cycle(c8);
+        }
+    }
+}
+
+int check_same(chip8_t *expected, chip8_t *actual)
+{
+    int same = 1;
+    same &= TEST_CHECK(expected->PC == actual->PC && expected->I == actual->I && expected->SP == actual->SP);
+    same &= TEST_CHECK(expected->DT == actual->DT && expected->ST == actual->ST && expected->RNG == actual->RNG);
+    same &= TEST_CHECK(memcmp(expected->V, actual->V, sizeof(expected->V)) == 0);
+    same &= TEST_CHECK(memcmp(expected->STACK, actual->STACK, sizeof(expected->STACK)) == 0);
+    same &= TEST_CHECK(memcmp(expected->RAM, actual->RAM, sizeof(expected->RAM)) == 0);
+    same &= TEST_CHECK(memcmp(expected->SCREEN, actual->SCREEN, sizeof(expected->SCREEN)) == 0);
+    same &= TEST_CHECK(expected->HIRES == actual->HIRES);
+    same &= TEST_CHECK(memcmp(expected->RPL, actual->RPL, sizeof(expected->RPL)) == 0);
+    same &= TEST_CHECK(memcmp(expected->KEYBOARD, actual->KEYBOARD, sizeof(expected->KEYBOARD)) == 0);
+    return same;
+}
+
+/**
+ * a restored instance, fresh or with other contents, goes on like the saved one
+ */
+void test_snapshot_restore(void)
+{
+    uint8_t buffer[SNAPSHOT_SIZE];
+    chip8_t *expected = load_seeded("rom/outlaw.ch8", 7);
+    run_frames(expected, 100);
+    TEST_CHECK(chip8_snapshot_save(expected, buffer) == chip8_snapshot_size(PROFILE_VIP));
+
+    chip8_t *fresh = chip8_create();
+    chip8_reset(fresh);
+    chip8_t *other = load_seeded("rom/test/corax+.ch8", 0);
+    run_frames(other, 50);
+    TEST_CHECK(chip8_snapshot_load(fresh, buffer, sizeof(buffer)) == SNAPSHOT_SUCCESS);
+    TEST_CHECK(chip8_snapshot_load(other, buffer, sizeof(buffer)) == SNAPSHOT_SUCCESS);
+    check_same(expected, fresh);
+    check_same(expected, other);
+
+    run_frames(expected, 200);
+    run_frames(fresh, 200);
+    run_frames(other, 200);
+    check_same(expected, fresh);
+    check_same(expected, other);
+    chip8_destroy(&expected);
+    chip8_destroy(&fresh);
+    chip8_destroy(&other);
+}
+
+/**
+ * a snapshot brings its profile along, with its quirks and its RAM
+ */
+void test_snapshot_profile(void)
+{
+    uint8_t buffer[SNAPSHOT_SIZE];
+    chip8_t *expected = load_seeded("rom/test/corax+.ch8", 5);
+    chip8_profile(expected, PROFILE_XOCHIP);
+    run_frames(expected, 40);
+    expected->RAM[XO_RAM_SIZE - 2] = 0x77;
+    expected->I = 0xFFF0;
+    chip8_snapshot_save(expected, buffer);
+
+    chip8_t *actual = load_seeded("rom/outlaw.ch8", 1);
+    run_frames(actual, 40);
+    TEST_CHECK(chip8_snapshot_load(actual, buffer, sizeof(buffer)) == SNAPSHOT_SUCCESS);
+    TEST_CHECK(actual->PROFILE == PROFILE_XOCHIP && actual->RAM_MASK == XO_RAM_SIZE - 1);
+    check_same(expected, actual);
+
+    // and back: the XO-CHIP instance takes the quirks of the original
+    chip8_profile(expected, PROFILE_VIP);
+    chip8_snapshot_save(expected, buffer);
+    TEST_CHECK(chip8_snapshot_load(actual, buffer, sizeof(buffer)) == SNAPSHOT_SUCCESS);
+    TEST_CHECK(actual->PROFILE == PROFILE_VIP && actual->RAM_MASK == RAM_SIZE - 1);
+    run_frames(expected, 100);
+    run_frames(actual, 100);
+    check_same(expected, actual);
+    chip8_destroy(&expected);
+    chip8_destroy(&actual);
+}
+
+/**
+ * translated code of the replaced program is not run after a restore
+ */
+void test_snapshot_code(void)
+{
+    uint8_t first[] = { 0x60, 0x01, 0x12, 0x00 };  // V0 = 1, loop
+    uint8_t second[] = { 0x60, 0x02, 0x12, 0x00 }; // V0 = 2, loop
+    uint8_t buffer[SNAPSHOT_SIZE];
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_ramcpy(c8, second, sizeof(second));
+    chip8_snapshot_save(c8, buffer);
+    chip8_ramcpy(c8, first, sizeof(first));
+
+    block_cache_t *bc = block_cache_create();
+    uint32_t executed;
+    block_run(bc, c8, 10, &executed);
+    TEST_CHECK(c8->V[0] == 1);
+    TEST_CHECK(chip8_snapshot_load(c8, buffer, sizeof(buffer)) == SNAPSHOT_SUCCESS);
+    block_run(bc, c8, 10, &executed);
+    TEST_CHECK(c8->V[0] == 2);
+    block_cache_destroy(&bc);
+    chip8_destroy(&c8);
+}
+
+/**
+ * the format is little-endian whatever the host is
+ */
+void test_snapshot_format(void)
+{
+    uint8_t buffer[SNAPSHOT_SIZE];
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    c8->PC = 0x0345;
+    c8->I = 0x0ABC;
+    c8->SCREEN[0][0][0] = 0x8000000000000001ULL;
+    c8->SCREEN[0][0][1] = 0x4000000000000002ULL;
+    c8->SCREEN[1][HIRES_HEIGHT - 1][1] = 0x03;
+    c8->RAM[RAM_SIZE - 1] = 0x5A;
+    c8->PATTERN[0] = 0xF0;
+    c8->PITCH = 100;
+    c8->HIRES = 1;
+    c8->RPL[RPL_SIZE - 1] = 0x7F;
+    c8->KEYBOARD[0] = c8->KEYBOARD[9] = 1;
+    size_t size = chip8_snapshot_save(c8, buffer);
+
+    TEST_CHECK(memcmp(buffer, "CH8S", 4) == 0 && buffer[4] == SNAPSHOT_VERSION && buffer[5] == 0);
+    TEST_CHECK(buffer[6] == PROFILE_VIP && buffer[7] == 0);
+    uint8_t *p = buffer + SNAPSHOT_HEADER + RAM_SIZE;
+    TEST_CHECK(p[-1] == 0x5A);
+    TEST_CHECK(p[0] == 0x01 && p[7] == 0x80 && p[8] == 0x02 && p[15] == 0x40);
+    TEST_CHECK(p[PLANES * HIRES_HEIGHT * 16 - 8] == 0x03);
+    p += PLANES * HIRES_HEIGHT * 16 + 8 + 16 + STACK_SIZE * 2;
+    TEST_CHECK(p[0] == 0xBC && p[1] == 0x0A);
+    TEST_CHECK(p[2] == 0x45 && p[3] == 0x03);
+    p += 4 + 4;
+    TEST_CHECK(p[0] == 0x01 && p[1] == 0x02);
+    TEST_CHECK(p[2] == 1 && p[2 + RPL_SIZE] == 0x7F);
+    p += 3 + RPL_SIZE;
+    TEST_CHECK(p[0] == 1 && p[1] == 0xF0 && p[1 + PATTERN_SIZE] == 100 && p[2 + PATTERN_SIZE] == 0);
+    TEST_CHECK(p + 3 + PATTERN_SIZE == buffer + size);
+    TEST_CHECK(size == SNAPSHOT_HEADER + RAM_SIZE + SNAPSHOT_STATE);
+
+    // only XO-CHIP has all of its RAM in snapshots
+    chip8_profile(c8, PROFILE_XOCHIP);
+    c8->RAM[XO_RAM_SIZE - 1] = 0xA5;
+    TEST_CHECK(chip8_snapshot_save(c8, buffer) == SNAPSHOT_SIZE);
+    TEST_CHECK(buffer[6] == PROFILE_XOCHIP && buffer[SNAPSHOT_HEADER + XO_RAM_SIZE - 1] == 0xA5);
+    chip8_destroy(&c8);
+}
+
+/**
+ * broken snapshots are refused and leave the instance alone
+ */
+void test_snapshot_errors(void)
+{
+    uint8_t buffer[SNAPSHOT_SIZE];
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    size_t size = chip8_snapshot_save(c8, buffer);
+    c8->PC = 0x300;
+
+    TEST_CHECK(chip8_snapshot_load(c8, buffer, size - 1) == SNAPSHOT_TRUNCATED);
+    TEST_CHECK(chip8_snapshot_load(c8, buffer, 3) == SNAPSHOT_TRUNCATED);
+    buffer[4]++;
+    TEST_CHECK(chip8_snapshot_load(c8, buffer, SNAPSHOT_SIZE) == SNAPSHOT_BAD_VERSION);
+    buffer[4]--;
+    buffer[0] = 'X';
+    TEST_CHECK(chip8_snapshot_load(c8, buffer, SNAPSHOT_SIZE) == SNAPSHOT_BAD_MAGIC);
+    buffer[0] = 'C';
+    // a stack pointer past the stack, a third resolution and planes that do not exist
+    uint8_t *state = buffer + SNAPSHOT_HEADER + RAM_SIZE;
+    state[SNAPSHOT_SP] = 0x40;
+    TEST_CHECK(chip8_snapshot_load(c8, buffer, SNAPSHOT_SIZE) == SNAPSHOT_CORRUPT);
+    state[SNAPSHOT_SP] = STACK_SIZE;
+    state[SNAPSHOT_HIRES] = 2;
+    TEST_CHECK(chip8_snapshot_load(c8, buffer, SNAPSHOT_SIZE) == SNAPSHOT_CORRUPT);
+    state[SNAPSHOT_HIRES] = 1;
+    state[SNAPSHOT_PLANE] = 4;
+    TEST_CHECK(chip8_snapshot_load(c8, buffer, SNAPSHOT_SIZE) == SNAPSHOT_CORRUPT);
+    TEST_CHECK(c8->PC == 0x300 && c8->SP == 0);
+    state[SNAPSHOT_PLANE] = 3;
+    TEST_CHECK(chip8_snapshot_load(c8, buffer, SNAPSHOT_SIZE) == SNAPSHOT_SUCCESS);
+    TEST_CHECK(c8->SP == STACK_SIZE && c8->HIRES == 1 && c8->PLANE == 3);
+    buffer[6] = PROFILE_COUNT;
+    TEST_CHECK(chip8_snapshot_load(c8, buffer, SNAPSHOT_SIZE) == SNAPSHOT_CORRUPT);
+    buffer[6] = PROFILE_XOCHIP;
+    TEST_CHECK(chip8_snapshot_load(c8, buffer, size) == SNAPSHOT_TRUNCATED);
+    TEST_CHECK(chip8_snapshot_read(c8, NULL) == SNAPSHOT_NOT_EXISTS);
+    chip8_destroy(&c8);
+}
+
+/**
+ * snapshot files hold the same as the buffers
+ */
+void test_snapshot_file(void)
+{
+    chip8_t *expected = load_seeded("rom/test/corax+.ch8", 3);
+    chip8_t *actual = chip8_create();
+    chip8_reset(actual);
+    run_frames(expected, 30);
+    FILE *f = fopen("bin/test/snapshot.state", "wb");
+    TEST_CHECK(chip8_snapshot_write(expected, f) == SNAPSHOT_SUCCESS);
+    fclose(f);
+    f = fopen("bin/test/snapshot.state", "rb");
+    TEST_CHECK(chip8_snapshot_read(actual, f) == SNAPSHOT_SUCCESS);
+    fclose(f);
+    check_same(expected, actual);
+    remove("bin/test/snapshot.state");
+    chip8_destroy(&expected);
+    chip8_destroy(&actual);
+}
+
+TEST_LIST = {
+    { "snapshot restore", test_snapshot_restore },
+    { "snapshot profiles", test_snapshot_profile },
+    { "snapshot restore and translated code", test_snapshot_code },
+    { "snapshot format", test_snapshot_format },
+    { "snapshot errors", test_snapshot_errors },
+    { "snapshot files", test_snapshot_file },
+    { NULL, NULL }
+};
@@ -0,0 +1,409 @@
+/**
+ * Batch runner: runs many independent CHIP-8 instances headless across all
+ * cores on a work-stealing thread pool, and prints one result line per run.
+ *
+ * usage: chip8-batch [--frames N] [--ipf N] [--runs N] [--threads N] [--engine E] [--seed N]
+ *                    [--profile P] <ROM file>...
+ *
+ * The lockstep engine runs up to LOCKSTEP_LANES runs of the same ROM side by side.
+ * Run r of every ROM draws its random numbers from seed + r, so results are the
+ * same for every engine and thread count.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "../src/include/chip8.h"
+#include "../src/include/threaded.h"
+#include "../src/include/block.h"
+#include "../src/include/jit.h"
+#include "../src/include/lockstep.h"
+#include "../src/include/args.h"
+
+#define BATCH_FRAMES 600
+
+typedef struct job_t {
+    // ROM file path
+    const char *rom_path;
+    // index among the runs of the same ROM
+    uint32_t run;
+    // seed of the random numbers
+    uint64_t seed;
+    // outcome of loading the ROM
+    rom_ld_t load;
+    // error that stopped the run, and where
+    exec_res_t result;
+    uint16_t pc;
+    // frames and instructions run
+    uint32_t frames;
+    uint64_t instructions;
+    // FNV-1a hash of the final screen
+    uint64_t screen_hash;
+} job_t;
+
+typedef struct batch_t {
+    // jobs, in output order
+    job_t *jobs;
+    uint32_t job_count;
+    // frames per run
+    uint32_t frames;
+    // instructions per frame
+    uint16_t ipf;
+    // execution engine
+    engine_t engine;
+    // profile of the quirks
+    uint8_t profile;
+    // run the runs of a ROM in lockstep groups?
+    uint8_t lockstep;
+    // first job of every unit of work handed to the pool
+    uint32_t *units;
+    uint32_t unit_count;
+} batch_t;
+
+typedef struct worker_t {
+    // guards the job range below
+    pthread_mutex_t lock;
+    // jobs still owned by this worker: next up to end
+    uint32_t next;
+    uint32_t end;
+    pthread_t thread;
+    // was thread created? the jobs of a worker without one are stolen by the others
+    uint8_t started;
+    struct pool_t *pool;
+} worker_t;
+
+typedef struct pool_t {
+    worker_t *workers;
+    uint32_t worker_count;
+    // called once for every job index
+    void (*work)(void *context, uint32_t job);
+    void *context;
+} pool_t;
+
+uint64_t screen_hash(chip8_t *c8)
+{
+    // the words of the current resolution only, the second plane only once something is drawn to it
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (int plane = 0; plane < PLANES; plane++) {
+        uint64_t used = 0;
+        for (int y = 0; y < HIRES_HEIGHT; y++) {
+            used |= c8->SCREEN[plane][y][0] | c8->SCREEN[plane][y][1];
+        }
+        if (plane > 0 && !used) {
+            break;
+        }
+        for (int y = 0; y < chip8_height(c8); y++) {
+            for (int word = 0; word < chip8_width(c8) / 64; word++) {
+                for (int shift = 56; shift >= 0; shift -= 8) {
+                    hash ^= (c8->SCREEN[plane][y][word] >> shift) & 0xFF;
+                    hash *= 0x100000001B3ULL;
+                }
+            }
+        }
+    }
+    return hash;
+}
+
+void batch_run(batch_t *b, job_t *job)
+{
+    chip8_t *c8 = chip8_create();
+    chip8_reset(c8);
+    chip8_seed(c8, job->seed);
+    chip8_profile(c8, b->profile);
+    FILE *rom = fopen(job->rom_path, "rb");
+    job->load = chip8_load_rom(c8, rom);
+    if (rom) fclose(rom);
+    job->result = EXEC_SUCCESS;
+    job->frames = 0;
+    job->instructions = 0;
+
+    block_cache_t *blocks = (b->engine == ENGINE_BLOCK) ? block_cache_create() : NULL;
+    jit_t *jit = (b->engine == ENGINE_JIT) ? jit_create() : NULL;
+    engine_t engine = b->engine;
+    if ((engine == ENGINE_BLOCK && blocks == NULL) || (engine == ENGINE_JIT && jit == NULL)) {
+        engine = ENGINE_SWITCH;
+    }
+
+    while (job->load == ROM_LOAD_SUCCESS && job->result == EXEC_SUCCESS && job->frames < b->frames) {
+        chip8_tick(c8);
+        job->frames++;
+        uint32_t executed;
+        for (uint32_t i = 0; i < b->ipf && job->result == EXEC_SUCCESS; i += executed) {
+            switch (engine) {
+                case ENGINE_THREADED: {
+                    job->result = chip8_threaded_run(c8, b->ipf - i, &executed);
+                    break;
+                }
+                case ENGINE_BLOCK: {
+                    job->result = block_run(blocks, c8, b->ipf - i, &executed);
+                    break;
+                }
+                case ENGINE_JIT: {
+                    job->result = jit_run(jit, c8, b->ipf - i, &executed);
+                    break;
+                }
+                default: {
+                    run_result_t run;
+                    chip8_run(c8, b->ipf - i, &run);
+                    job->result = run.result;
+                    // a key wait uses up the rest of the frame
+                    executed = (run.stop == RUN_WAIT) ? b->ipf - i : run.executed;
+                }
+            }
+            job->instructions += executed;
+        }
+    }
+    job->pc = c8->PC;
+    job->screen_hash = screen_hash(c8);
+
+    if (blocks) block_cache_destroy(&blocks);
+    if (jit) jit_destroy(&jit);
+    chip8_destroy(&c8);
+}
+
+// take the next job of the worker's own range
+static int pool_take(worker_t *w, uint32_t *job)
+{
+    pthread_mutex_lock(&w->lock);
+    int found = w->next < w->end;
+    if (found) *job = w->next++;
+    pthread_mutex_unlock(&w->lock);
+    return found;
+}
+
+// move the upper half of another worker's remaining range into our own
+static int pool_steal(worker_t *w)
+{
+    pool_t *pool = w->pool;
+    uint32_t self = w - pool->workers;
+    for (uint32_t k = 1; k < pool->worker_count; k++) {
+        worker_t *victim = &pool->workers[(self + k) % pool->worker_count];
+        pthread_mutex_lock(&victim->lock);
+        uint32_t left = victim->end - victim->next;
+        uint32_t from = victim->end - (left + 1) / 2;
+        uint32_t to = victim->end;
+        victim->end = from;
+        pthread_mutex_unlock(&victim->lock);
+        if (left > 0) {
+            pthread_mutex_lock(&w->lock);
+            w->next = from;
+            w->end = to;
+            pthread_mutex_unlock(&w->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void *pool_worker(void *arg)
+{
+    worker_t *w = arg;
+    uint32_t job;
+    do {
+        while (pool_take(w, &job)) {
+            w->pool->work(w->pool->context, job);
+        }
+    } while (pool_steal(w));
+    return NULL;
+}
+
+// run work() for every job index 0 to job_count - 1 on worker_count threads
+void pool_run(uint32_t worker_count, uint32_t job_count, void (*work)(void *, uint32_t), void *context)
+{
+    pool_t pool = { .worker_count = worker_count, .work = work, .context = context };
+    pool.workers = calloc(worker_count, sizeof(worker_t));
+    for (uint32_t i = 0; i < worker_count; i++) { // equal ranges up front, stealing evens out the rest
+        worker_t *w = &pool.workers[i];
+        pthread_mutex_init(&w->lock, NULL);
+        w->next = (uint64_t)job_count * i / worker_count;
+        w->end = (uint64_t)job_count * (i + 1) / worker_count;
+        w->pool = &pool;
+    }
+    for (uint32_t i = 1; i < worker_count; i++) {
+        pool.workers[i].started = pthread_create(&pool.workers[i].thread, NULL, pool_worker, &pool.workers[i]) == 0;
+    }
+    pool_worker(&pool.workers[0]);
+    for (uint32_t i = 1; i < worker_count; i++) {
+        if (pool.workers[i].started) pthread_join(pool.workers[i].thread, NULL);
+    }
+    for (uint32_t i = 0; i < worker_count; i++) {
+        pthread_mutex_destroy(&pool.workers[i].lock);
+    }
+    free(pool.workers);
+}
+
+void batch_run_lockstep(batch_t *b, job_t *jobs, uint32_t count)
+{
+    lockstep_t *ls = lockstep_create();
+    job_t *lane_jobs[LOCKSTEP_LANES];
+    for (uint32_t i = 0; i < count; i++) {
+        chip8_t *c8 = chip8_create();
+        chip8_reset(c8);
+        chip8_seed(c8, jobs[i].seed);
+        chip8_profile(c8, b->profile);
+        FILE *rom = fopen(jobs[i].rom_path, "rb");
+        jobs[i].load = chip8_load_rom(c8, rom);
+        if (rom) fclose(rom);
+        jobs[i].result = EXEC_SUCCESS;
+        jobs[i].frames = 0;
+        jobs[i].instructions = 0;
+        if (jobs[i].load == ROM_LOAD_SUCCESS) {
+            lane_jobs[lockstep_add(ls, c8)] = &jobs[i];
+        } else {
+            jobs[i].pc = c8->PC;
+            jobs[i].screen_hash = screen_hash(c8);
+            chip8_destroy(&c8);
+        }
+    }
+
+    for (uint32_t frame = 0; frame < b->frames; frame++) {
+        for (int lane = 0; lane < ls->count; lane++) {
+            if (ls->result[lane] != EXEC_SUCCESS) continue;
+            chip8_tick(ls->lanes[lane]);
+            lane_jobs[lane]->frames++;
+        }
+        lockstep_run(ls, b->ipf);
+        for (int lane = 0; lane < ls->count; lane++) {
+            lane_jobs[lane]->instructions += ls->executed[lane];
+            lane_jobs[lane]->result = ls->result[lane];
+        }
+    }
+    for (int lane = 0; lane < ls->count; lane++) {
+        lane_jobs[lane]->pc = ls->lanes[lane]->PC;
+        lane_jobs[lane]->screen_hash = screen_hash(ls->lanes[lane]);
+        chip8_destroy(&ls->lanes[lane]);
+    }
+    lockstep_destroy(&ls);
+}
+
+// split the jobs into units of work: single runs, or lockstep groups of runs of the same ROM
+void batch_plan(batch_t *b)
+{
+    uint32_t group = b->lockstep ? LOCKSTEP_LANES : 1;
+    b->units = malloc(sizeof(uint32_t) * (b->job_count + 1));
+    b->unit_count = 0;
+    for (uint32_t i = 0; i < b->job_count; i++) {
+        uint32_t first = b->unit_count ? b->units[b->unit_count - 1] : 0;
+        if (i == 0 || i - first == group || b->jobs[i].rom_path != b->jobs[first].rom_path) {
+            b->units[b->unit_count++] = i;
+        }
+    }
+    b->units[b->unit_count] = b->job_count;
+}
+
+static void batch_work(void *context, uint32_t unit)
+{
+    batch_t *b = context;
+    uint32_t first = b->units[unit];
+    if (b->lockstep) {
+        batch_run_lockstep(b, &b->jobs[first], b->units[unit + 1] - first);
+    } else {
+        batch_run(b, &b->jobs[first]);
+    }
+}
+
+static const char *results[] = {
+    [EXEC_SUCCESS] = "success",
+    [UNKNOWN_OPCODE] = "unknown opcode",
+    [STACK_OVERFLOW] = "stack overflow",
+    [STACK_UNDERFLOW] = "stack underflow",
+    [PC_OVERFLOW] = "program counter overflow"
+};
+
+static const char *loads[] = {
+    [ROM_LOAD_SUCCESS] = "success",
+    [ROM_NOT_EXISTS] = "ROM not found",
+    [ROM_TOO_LARGE] = "ROM too large"
+};
+
+void batch_print(batch_t *b, FILE *out)
+{
+    fprintf(out, "rom\trun\tframes\tinstructions\tscreen\tresult\n");
+    for (uint32_t i = 0; i < b->job_count; i++) {
+        job_t *job = &b->jobs[i];
+        fprintf(out, "%s\t%u\t%u\t%llu\t%016llx\t", job->rom_path, job->run, job->frames,
+            (unsigned long long)job->instructions, (unsigned long long)job->screen_hash);
+        if (job->load != ROM_LOAD_SUCCESS) {
+            fprintf(out, "%s\n", loads[job->load]);
+        } else if (job->result != EXEC_SUCCESS) {
+            fprintf(out, "%s at %03X\n", results[job->result], job->pc);
+        } else {
+            fprintf(out, "%s\n", results[job->result]);
+        }
+    }
+}
+
+#ifndef BATCH_NO_MAIN
+int main(int argc, char *argv[])
+{
+    batch_t b = { .frames = BATCH_FRAMES, .ipf = IPF, .engine = ENGINE_SWITCH };
+    uint32_t runs = 1;
+    uint64_t seed = 0;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int first = 1;
+    for (; first + 1 < argc && strncmp(argv[first], "--", 2) == 0; first += 2) {
+        if (strcmp("--frames", argv[first]) == 0) {
+            b.frames = strtoul(argv[first + 1], NULL, 10);
+        } else if (strcmp("--ipf", argv[first]) == 0) {
+            b.ipf = strtoul(argv[first + 1], NULL, 10);
+        } else if (strcmp("--runs", argv[first]) == 0) {
+            runs = strtoul(argv[first + 1], NULL, 10);
+        } else if (strcmp("--threads", argv[first]) == 0) {
+            threads = strtol(argv[first + 1], NULL, 10);
+        } else if (strcmp("--seed", argv[first]) == 0) {
+            seed = strtoull(argv[first + 1], NULL, 10);
+        } else if (strcmp("--engine", argv[first]) == 0) {
+            if (strcmp("switch", argv[first + 1]) == 0) {
+                b.engine = ENGINE_SWITCH;
+            } else if (strcmp("threaded", argv[first + 1]) == 0) {
+                b.engine = ENGINE_THREADED;
+            } else if (strcmp("block", argv[first + 1]) == 0) {
+                b.engine = ENGINE_BLOCK;
+            } else if (strcmp("jit", argv[first + 1]) == 0) {
+                b.engine = ENGINE_JIT;
+            } else if (strcmp("lockstep", argv[first + 1]) == 0) {
+                b.lockstep = 1;
+            }
+        } else if (strcmp("--profile", argv[first]) == 0) {
+            for (int i = 0; i < PROFILE_COUNT; i++) {
+                if (strcmp(profile_names[i], argv[first + 1]) == 0) b.profile = i;
+            }
+        }
+    }
+    if (first == argc || runs == 0) {
+        fprintf(stderr, "usage: %s [--frames N] [--ipf N] [--runs N] [--threads N] [--engine E] [--seed N] [--profile P] <ROM file>...\n",
+            argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (threads < 1) threads = 1;
+
+    b.job_count = (argc - first) * runs;
+    b.jobs = calloc(b.job_count, sizeof(job_t));
+    for (uint32_t i = 0; i < b.job_count; i++) {
+        b.jobs[i].rom_path = argv[first + i / runs];
+        b.jobs[i].run = i % runs;
+        b.jobs[i].seed = seed + b.jobs[i].run;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    batch_plan(&b);
+    pool_run(threads, b.unit_count, batch_work, &b);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    batch_print(&b, stdout);
+    int failed = 0;
+    for (uint32_t i = 0; i < b.job_count; i++) {
+        failed += b.jobs[i].load != ROM_LOAD_SUCCESS || b.jobs[i].result != EXEC_SUCCESS;
+    }
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "%u runs, %d failed, on %ld threads in %.3f s\n", b.job_count, failed, threads, seconds);
+    free(b.units);
+    free(b.jobs);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+#endif
@@ -0,0 +1,439 @@
+/**
+ * Static recompiler: translates the code reachable from START_ADDRESS in a
+ * ROM into a C translation unit implementing aot_run() for the frontend.
+ *
+ * usage: recompile <ROM file> <output C file> [vip|chip48|schip|xochip]
+ *
+ * The code is specialized for the quirks of one profile, instances running
+ * under another profile are left to the interpreter.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/include/chip8.h"
+
+typedef struct program_t {
+    // ROM loaded at START_ADDRESS
+    uint8_t RAM[RAM_SIZE];
+    // address after the last ROM byte
+    uint16_t END;
+    // addresses reached as instructions
+    uint8_t CODE[RAM_SIZE];
+    // profile the code is specialized for
+    uint8_t PROFILE;
+} program_t;
+
+int program_load(program_t *p, FILE *f)
+{
+    memset(p, 0, sizeof(program_t));
+    if (f == NULL) {
+        return 0;
+    }
+    size_t size = fread(&p->RAM[START_ADDRESS], sizeof(uint8_t), RAM_SIZE - START_ADDRESS, f);
+    p->END = START_ADDRESS + size;
+    return size > 0;
+}
+
+static uint16_t program_opcode(program_t *p, uint16_t address)
+{
+    return p->RAM[address] << 8 | p->RAM[address + 1];
+}
+
+static void program_decode(program_t *p, uint16_t address, instruction_t *inst)
+{
+    chip8_decode(program_opcode(p, address), inst);
+    chip8_specialize(inst, p->PROFILE);
+}
+
+static int program_inside(program_t *p, uint16_t address)
+{
+    return address >= START_ADDRESS && address + 1 < p->END;
+}
+
+static void program_push(program_t *p, uint16_t *stack, int *top, uint16_t address)
+{
+    if (program_inside(p, address) && !p->CODE[address]) {
+        p->CODE[address] = 1;
+        stack[(*top)++] = address;
+    }
+}
+
+/**
+ * follow the control flow from START_ADDRESS through jumps, calls, skips and
+ * BNNN jump tables. Returns the number of reachable instructions.
+ */
+int program_analyze(program_t *p)
+{
+    uint16_t stack[RAM_SIZE];
+    int top = 0, count = 0;
+    instruction_t inst;
+
+    program_push(p, stack, &top, START_ADDRESS);
+    while (top > 0) {
+        uint16_t address = stack[--top];
+        uint16_t next = address + 2;
+        count++;
+        program_decode(p, address, &inst);
+        switch (inst.OC) {
+            case OC_JP: {
+                program_push(p, stack, &top, inst.NNN);
+                break;
+            }
+            case OC_CALL: {
+                program_push(p, stack, &top, inst.NNN);
+                program_push(p, stack, &top, next);
+                break;
+            }
+            case OC_SE_VX_NN: case OC_SNE_VX_NN: case OC_SE_VX_VY: case OC_SNE_VX_VY: case OC_SKP: case OC_SKNP: {
+                program_push(p, stack, &top, next);
+                program_push(p, stack, &top, next + 2);
+                break;
+            }
+            case OC_SKIP_LONG: { // the skipped instruction may be F000 NNNN
+                program_push(p, stack, &top, next);
+                program_push(p, stack, &top, next + 2);
+                program_push(p, stack, &top, next + 4);
+                break;
+            }
+            case OC_LD_I_LONG: {
+                program_push(p, stack, &top, next + 2);
+                break;
+            }
+            case OC_JP_V0: case OC_JP_VX: { // a table of jumps at NNN is the usual target
+                program_push(p, stack, &top, inst.NNN);
+                for (uint16_t a = inst.NNN; program_inside(p, a) && (p->RAM[a] >> 4 == 0x1 || p->RAM[a] >> 4 == 0x2); a += 2) {
+                    program_push(p, stack, &top, a);
+                }
+                break;
+            }
+            case OC_RET: case OC_UNKNOWN: {
+                break;
+            }
+            default: {
+                program_push(p, stack, &top, next);
+            }
+        }
+    }
+    return count;
+}
+
+// transfer control to a static address, directly if it was translated
+static void emit_jump(program_t *p, FILE *out, uint16_t address)
+{
+    if (program_inside(p, address) && p->CODE[address]) {
+        fprintf(out, "goto L_0x%03X;\n", address);
+    } else {
+        fprintf(out, "{ pc = 0x%03X; continue; }\n", address);
+    }
+}
+
+static void emit_skip(program_t *p, FILE *out, const char *condition, uint16_t next)
+{
+    fprintf(out, "            if (%s) ", condition);
+    emit_jump(p, out, next + 2);
+    fprintf(out, "            ");
+    emit_jump(p, out, next);
+}
+
+static void emit_instruction(program_t *p, FILE *out, uint16_t address)
+{
+    uint16_t next = address + 2;
+    char condition[64];
+    instruction_t inst;
+    program_decode(p, address, &inst);
+    int x = inst.X, y = inst.Y;
+
+    fprintf(out, "        AT(0x%03X) // %04X\n", address, inst.OP);
+    switch (inst.OC) {
+        case OC_NOP: {
+            break;
+        }
+        case OC_RET: {
+            fprintf(out, "            if (c8->SP == 0) { pc = 0x%03X; result = STACK_UNDERFLOW; goto done; }\n", next);
+            fprintf(out, "            c8->SP--;\n");
+            fprintf(out, "            pc = c8->STACK[c8->SP];\n");
+            fprintf(out, "            continue;\n");
+            return;
+        }
+        case OC_JP: {
+            fprintf(out, "            ");
+            emit_jump(p, out, inst.NNN);
+            return;
+        }
+        case OC_CALL: {
+            fprintf(out, "            if (c8->SP == STACK_SIZE) { pc = 0x%03X; result = STACK_OVERFLOW; goto done; }\n", next);
+            fprintf(out, "            c8->STACK[c8->SP] = 0x%03X;\n", next);
+            fprintf(out, "            c8->SP++;\n");
+            fprintf(out, "            ");
+            emit_jump(p, out, inst.NNN);
+            return;
+        }
+        case OC_SE_VX_NN:
+        case OC_SNE_VX_NN: {
+            sprintf(condition, "V[0x%X] %s 0x%02X", x, inst.OC == OC_SE_VX_NN ? "==" : "!=", inst.NN);
+            emit_skip(p, out, condition, next);
+            return;
+        }
+        case OC_SE_VX_VY:
+        case OC_SNE_VX_VY: {
+            sprintf(condition, "V[0x%X] %s V[0x%X]", x, inst.OC == OC_SE_VX_VY ? "==" : "!=", y);
+            emit_skip(p, out, condition, next);
+            return;
+        }
+        case OC_SKP:
+        case OC_SKNP: {
+            sprintf(condition, "%sc8->KEYBOARD[V[0x%X]]", inst.OC == OC_SKP ? "" : "!", x);
+            emit_skip(p, out, condition, next);
+            return;
+        }
+        case OC_JP_V0: {
+            fprintf(out, "            pc = 0x%03X + V[0];\n", inst.NNN);
+            fprintf(out, "            continue;\n");
+            return;
+        }
+        case OC_JP_VX: {
+            fprintf(out, "            pc = 0x%03X + V[0x%X];\n", inst.NNN, x);
+            fprintf(out, "            continue;\n");
+            return;
+        }
+        case OC_LD_VX_NN: {
+            fprintf(out, "            V[0x%X] = 0x%02X;\n", x, inst.NN);
+            break;
+        }
+        case OC_ADD_VX_NN: {
+            fprintf(out, "            V[0x%X] += 0x%02X;\n", x, inst.NN);
+            break;
+        }
+        case OC_LD_VX_VY: {
+            fprintf(out, "            V[0x%X] = V[0x%X];\n", x, y);
+            break;
+        }
+        case OC_OR:
+        case OC_AND:
+        case OC_XOR: {
+            fprintf(out, "            V[0x%X] %s= V[0x%X];\n", x, inst.OC == OC_OR ? "|" : inst.OC == OC_AND ? "&" : "^", y);
+            fprintf(out, "            V[0xF] = 0;\n");
+            break;
+        }
+        case OC_OR_KEEP:
+        case OC_AND_KEEP:
+        case OC_XOR_KEEP: {
+            fprintf(out, "            V[0x%X] %s= V[0x%X];\n", x,
+                inst.OC == OC_OR_KEEP ? "|" : inst.OC == OC_AND_KEEP ? "&" : "^", y);
+            break;
+        }
+        case OC_ADD_VX_VY: {
+            fprintf(out, "            { int sum = V[0x%X] + V[0x%X]; V[0x%X] = sum; V[0xF] = sum > 255; }\n", x, y, x);
+            break;
+        }
+        case OC_SUB: {
+            fprintf(out, "            { uint8_t flag = V[0x%X] >= V[0x%X]; V[0x%X] -= V[0x%X]; V[0xF] = flag; }\n", x, y, x, y);
+            break;
+        }
+        case OC_SUBN: {
+            fprintf(out, "            { uint8_t flag = V[0x%X] >= V[0x%X]; V[0x%X] = V[0x%X] - V[0x%X]; V[0xF] = flag; }\n",
+                y, x, x, y, x);
+            break;
+        }
+        case OC_SHR:
+        case OC_SHR_VX: {
+            int source = inst.OC == OC_SHR ? y : x;
+            fprintf(out, "            { uint8_t bit = V[0x%X] & 1; V[0x%X] = V[0x%X] >> 1; V[0xF] = bit; }\n", source, x, source);
+            break;
+        }
+        case OC_SHL:
+        case OC_SHL_VX: {
+            int source = inst.OC == OC_SHL ? y : x;
+            fprintf(out, "            { uint8_t bit = V[0x%X] >> 7; V[0x%X] = V[0x%X] << 1; V[0xF] = bit; }\n", source, x, source);
+            break;
+        }
+        case OC_LD_I: {
+            fprintf(out, "            c8->I = 0x%03X;\n", inst.NNN);
+            break;
+        }
+        case OC_LD_VX_DT: {
+            fprintf(out, "            V[0x%X] = c8->DT;\n", x);
+            break;
+        }
+        case OC_LD_DT_VX: {
+            fprintf(out, "            c8->DT = V[0x%X];\n", x);
+            break;
+        }
+        case OC_LD_ST_VX: {
+            fprintf(out, "            c8->ST = V[0x%X];\n", x);
+            break;
+        }
+        case OC_ADD_I_VX: {
+            fprintf(out, "            c8->I += V[0x%X];\n", x);
+            break;
+        }
+        case OC_LD_F_VX: {
+            fprintf(out, "            c8->I = FONTSET_ADDRESS + V[0x%X] * FONT_OFFSET;\n", x);
+            break;
+        }
+        case OC_LD_VX_I:
+        case OC_LD_VX_I_X:
+        case OC_LD_VX_I_KEEP: {
+            for (int i = 0; i <= x; i++) {
+                fprintf(out, "            V[0x%X] = c8->RAM[(c8->I + %d) & c8->RAM_MASK];\n", i, i);
+            }
+            if (inst.OC != OC_LD_VX_I_KEEP) {
+                fprintf(out, "            c8->I += %d;\n", inst.OC == OC_LD_VX_I ? x + 1 : x);
+            }
+            break;
+        }
+        default: { // CLS, RND, DRW, FX0A, FX33, FX55, SUPER-CHIP, XO-CHIP and unknown opcodes
+            fprintf(out, "            c8->PC = 0x%03X;\n", next);
+            fprintf(out, "            if ((result = aot_execute(c8, 0x%04X)) != EXEC_SUCCESS) { pc = c8->PC; goto done; }\n",
+                inst.OP);
+            if (inst.OC == OC_LD_VX_K || inst.OC == OC_UNKNOWN || inst.OC == OC_LD_I_LONG || inst.OC == OC_SKIP_LONG) {
+                fprintf(out, "            pc = c8->PC;\n");
+                fprintf(out, "            continue;\n");
+                return;
+            }
+            if (inst.OC == OC_LD_B_VX || inst.OC == OC_LD_I_VX || inst.OC == OC_SAVE) {
+                fprintf(out, "            if (c8->CODE_GEN != aot_gen) { pc = 0x%03X; continue; }\n", next);
+            }
+        }
+    }
+    // fall through unless the next instruction is emitted somewhere else
+    if (!(program_inside(p, next) && p->CODE[next] && !p->CODE[address + 1])) {
+        fprintf(out, "            ");
+        emit_jump(p, out, next);
+    }
+}
+
+void program_emit(program_t *p, FILE *out, const char *name)
+{
+    fprintf(out, "/**\n * Generated by tools/recompile.c from %s, do not edit.\n */\n\n", name);
+    fprintf(out, "#include <string.h>\n\n#include \"include/chip8.h\"\n#include \"include/aot.h\"\n\n");
+    fputs(
+        "// instructions fall through into the next case, and not every label is a jump target\n"
+        "#if defined(__GNUC__) || defined(__clang__)\n"
+        "#pragma GCC diagnostic ignored \"-Wimplicit-fallthrough\"\n"
+        "#pragma GCC diagnostic ignored \"-Wunused-label\"\n"
+        "#endif\n\n", out);
+    fprintf(out, "const char *aot_rom = \"%s\";\n\n", name);
+    fprintf(out, "// profile the code was specialized for\n#define AOT_PROFILE %d\n\n", p->PROFILE);
+
+    fprintf(out, "// ROM the code was translated from\nstatic const uint8_t aot_image[] = {");
+    for (int a = START_ADDRESS; a < p->END; a++) {
+        fprintf(out, "%s0x%02X,", (a - START_ADDRESS) % 16 == 0 ? "\n    " : " ", p->RAM[a]);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "// translated instruction addresses\nstatic const uint16_t aot_code[] = {");
+    int count = 0;
+    for (int a = START_ADDRESS; a < p->END; a++) {
+        if (p->CODE[a]) {
+            fprintf(out, "%s0x%03X,", count++ % 12 == 0 ? "\n    " : " ", a);
+        }
+    }
+    fprintf(out, "\n};\n\n");
+
+    fputs(
+        "// does RAM still hold the translated instruction?\n"
+        "static uint8_t aot_valid[RAM_SIZE];\n"
+        "static chip8_t *aot_owner;\n"
+        "static uint32_t aot_gen;\n"
+        "\n"
+        "static void aot_sync(chip8_t *c8)\n"
+        "{\n"
+        "    int all = c8 != aot_owner || (c8->CODE_LO == 0 && c8->CODE_HI == RAM_SIZE - 1);\n"
+        "    for (size_t i = 0; i < sizeof(aot_code) / sizeof(aot_code[0]); i++) {\n"
+        "        uint16_t a = aot_code[i];\n"
+        "        if (all || (a + 1 >= c8->CODE_LO && a <= c8->CODE_HI)) {\n"
+        "            aot_valid[a] = c8->PROFILE == AOT_PROFILE && memcmp(&c8->RAM[a], &aot_image[a - START_ADDRESS], 2) == 0;\n"
+        "            c8->CODE[a] = c8->CODE[a + 1] = 1;\n"
+        "        }\n"
+        "    }\n"
+        "    aot_owner = c8;\n"
+        "    c8->CODE_LO = RAM_SIZE;\n"
+        "    c8->CODE_HI = 0;\n"
+        "    aot_gen = c8->CODE_GEN;\n"
+        "}\n"
+        "\n"
+        "static exec_res_t aot_execute(chip8_t *c8, uint16_t opcode)\n"
+        "{\n"
+        "    instruction_t inst;\n"
+        "    chip8_decode(opcode, &inst);\n"
+        "    return chip8_execute(c8, &inst);\n"
+        "}\n"
+        "\n"
+        "// entry of a translated instruction, left for the interpreter if overwritten or out of budget\n"
+        "#define AT(a) case a: L_##a: if (n == count || !aot_valid[a]) { pc = a; break; } n++;\n"
+        "\n"
+        "exec_res_t aot_run(chip8_t *c8, uint32_t count, uint32_t *executed)\n"
+        "{\n"
+        "    exec_res_t result = EXEC_SUCCESS;\n"
+        "    uint8_t *V = c8->V;\n"
+        "    uint16_t pc = c8->PC;\n"
+        "    uint32_t n = 0;\n"
+        "\n"
+        "    while (n < count) {\n"
+        "        if (c8 != aot_owner || c8->CODE_GEN != aot_gen) {\n"
+        "            aot_sync(c8);\n"
+        "        }\n"
+        "        if (pc >= RAM_SIZE) {\n"
+        "            pc = START_ADDRESS;\n"
+        "            result = PC_OVERFLOW;\n"
+        "            break;\n"
+        "        }\n"
+        "        switch (pc) {\n", out);
+    for (int a = START_ADDRESS; a < p->END; a++) {
+        if (p->CODE[a]) emit_instruction(p, out, a);
+    }
+    fputs(
+        "        }\n"
+        "        // untranslated or overwritten code: one step of the reference interpreter\n"
+        "        if (n == count) break;\n"
+        "        c8->PC = pc;\n"
+        "        result = chip8_cycle(c8);\n"
+        "        pc = c8->PC;\n"
+        "        n++;\n"
+        "        if (result != EXEC_SUCCESS) break;\n"
+        "    }\n"
+        "\n"
+        "done:\n"
+        "    c8->PC = pc;\n"
+        "    if (executed) *executed = n;\n"
+        "    return result;\n"
+        "}\n", out);
+}
+
+#ifndef RECOMPILE_NO_MAIN
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <ROM file> <output C file> [vip|chip48|schip|xochip]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    program_t *p = malloc(sizeof(program_t));
+    FILE *rom = fopen(argv[1], "rb");
+    int loaded = p != NULL && program_load(p, rom);
+    if (rom) fclose(rom);
+    if (!loaded) {
+        fprintf(stderr, "cannot load %s\n", argv[1]);
+        free(p);
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; argc > 3 && i < PROFILE_COUNT; i++) {
+        if (strcmp(profile_names[i], argv[3]) == 0) p->PROFILE = i;
+    }
+    int count = program_analyze(p);
+
+    FILE *out = fopen(argv[2], "w");
+    if (out == NULL) {
+        fprintf(stderr, "cannot write %s\n", argv[2]);
+        free(p);
+        return EXIT_FAILURE;
+    }
+    program_emit(p, out, argv[1]);
+    fclose(out);
+    printf("%s: %d instructions translated into %s\n", argv[1], count, argv[2]);
+    free(p);
+    return EXIT_SUCCESS;
+}
+#endif